@@ -0,0 +1,256 @@
+// Autotuning of the spreader's sort bin sizes and max subproblem size, and the
+// per-host profile file storing the results, consulted at runtime by
+// common.cpp:set_spread_tuning().
+//
+// Profile file format: one entry per line, with fields
+//   dim ns log2nf log2M bin_size_x bin_size_y bin_size_z max_subproblem_size t
+// where nf is the total fine grid size and t the best spread+interp time (s).
+// Lines starting with # are ignored.
+
+#include "autotune.h"
+#include "common.h"
+#include "utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+struct tune_entry {
+  int dim, ns;
+  double l2nf, l2M;
+  int binx, biny, binz;
+  BIGINT maxsub;
+  double t;
+};
+
+static std::vector<tune_entry> profile;    // in-memory copy of profile file
+static int profile_loaded = 0;
+
+void profile_filename(char *fname, int len)
+// Name of the per-host profile: $FINUFFT_PROFILE if set (the value "none"
+// disables profiles), else $HOME/.finufft_profile_<hostname>. Writes an
+// empty string if no profile is to be used.
+{
+  const char *env = getenv("FINUFFT_PROFILE");
+  if (env) {
+    if (!strcmp(env,"none")) fname[0] = '\0';
+    else snprintf(fname,len,"%s",env);
+    return;
+  }
+  const char *home = getenv("HOME");
+  char host[256] = "localhost";
+#ifdef _WIN32
+  const char *cn = getenv("COMPUTERNAME");
+  if (cn) snprintf(host,256,"%s",cn);
+#else
+  gethostname(host,255); host[255] = '\0';
+#endif
+  if (home) snprintf(fname,len,"%s/.finufft_profile_%s",home,host);
+  else fname[0] = '\0';
+}
+
+static void load_profile()
+// read profile file into memory (call only from within finufft_profile crit)
+{
+  profile.clear();
+  char fname[1024];
+  profile_filename(fname,1024);
+  FILE *fp = fname[0] ? fopen(fname,"r") : NULL;
+  if (fp) {
+    char line[1024];
+    while (fgets(line,1024,fp)) {
+      if (line[0]=='#') continue;
+      tune_entry e; long long maxsub;
+      if (sscanf(line,"%d %d %lf %lf %d %d %d %lld %lf",&e.dim,&e.ns,&e.l2nf,
+		 &e.l2M,&e.binx,&e.biny,&e.binz,&maxsub,&e.t)==9 &&
+	  e.binx>0 && e.biny>0 && e.binz>0 && maxsub>0) {
+	e.maxsub = (BIGINT)maxsub;
+	profile.push_back(e);
+      }
+    }
+    fclose(fp);
+  }
+  profile_loaded = 1;
+}
+
+static int save_profile()
+// write in-memory profile to file (call only from within finufft_profile crit)
+{
+  char fname[1024];
+  profile_filename(fname,1024);
+  if (!fname[0]) return 0;                  // profiles disabled
+  FILE *fp = fopen(fname,"w");
+  if (!fp) {
+    fprintf(stderr,"finufft_autotune: cannot write profile %s\n",fname);
+    return ERR_PROFILE_IO;
+  }
+  fprintf(fp,"# FINUFFT spreader autotune profile: dim ns log2nf log2M binx biny binz maxsub t\n");
+  for (size_t i=0; i<profile.size(); ++i) {
+    tune_entry &e = profile[i];
+    fprintf(fp,"%d %d %.2f %.2f %d %d %d %lld %.6g\n",e.dim,e.ns,e.l2nf,e.l2M,
+	    e.binx,e.biny,e.binz,(long long)e.maxsub,e.t);
+  }
+  fclose(fp);
+  return 0;
+}
+
+int apply_spread_profile(spread_opts &spopts, int ndims, BIGINT nf, BIGINT M)
+/* If the per-host profile has an entry for dimension ndims near to the
+   problem (fine grid size nf, M NU pts, kernel width spopts.nspread), set the
+   bin sizes and max subproblem size in spopts from the nearest entry.
+   The profile is read from file on first call. Thread-safe.
+   Returns 1 if an entry was applied, 0 if spopts was left unchanged.
+*/
+{
+  int found = 0;
+  double l2nf = log2((double)nf), l2M = log2((double)std::max<BIGINT>(M,1));
+#pragma omp critical (finufft_profile)
+  {
+    if (!profile_loaded) load_profile();
+    double best = PROFILE_MAX_DIST;
+    for (size_t i=0; i<profile.size(); ++i) {
+      tune_entry &e = profile[i];
+      if (e.dim!=ndims) continue;
+      double dist = fabs(e.l2nf-l2nf) + fabs(e.l2M-l2M) +
+	0.5*abs(e.ns-spopts.nspread);
+      if (dist<=best) {
+	best = dist;
+	spopts.bin_size_x = e.binx;
+	spopts.bin_size_y = e.biny;
+	spopts.bin_size_z = e.binz;
+	spopts.max_subproblem_size = e.maxsub;
+	found = 1;
+      }
+    }
+  }
+  return found;
+}
+
+static double time_spreadinterp(spread_opts spopts, BIGINT nf1, BIGINT nf2,
+				BIGINT nf3, FLT *fw, BIGINT M, FLT *x, FLT *y,
+				FLT *z, FLT *c, int reps)
+// best-of-reps time for a spread (dir=1) plus an interp (dir=2) using spopts
+{
+  double tbest = INFINITY;
+  for (int r=0; r<reps; ++r) {
+    CNTime timer; timer.start();
+    spopts.spread_direction = 1;
+    spreadinterp(nf1,nf2,nf3,fw,M,x,y,z,c,spopts);
+    spopts.spread_direction = 2;
+    spreadinterp(nf1,nf2,nf3,fw,M,x,y,z,c,spopts);
+    double t = timer.elapsedsec();
+    if (t<tbest) tbest = t;
+  }
+  return tbest;
+}
+
+int finufft_autotune(int dim, BIGINT N, BIGINT M, FLT eps, nufft_opts opts)
+/* Benchmarks the spreader (spread plus interp, with uniform random NU pts) on
+   this machine for a dim-dimensional problem with N total Fourier modes
+   (split equally over dims), M NU pts and tolerance eps, over candidate sort
+   bin sizes then max subproblem sizes, and stores the fastest choice in the
+   per-host profile file (see profile_filename), replacing any entry for the
+   same shape. Subsequent transforms of nearby shape on this host then use it,
+   unless overridden by nonzero opts.spread_bin_size_* or spread_max_sp_size.
+   opts controls the kernel (upsampfac, kerevalmeth), sorting, # threads, and
+   debug text.
+   Returns 0 on success, else an error code (see ../docs/usage.rst).
+*/
+{
+  thread_scope thrs(opts.nthreads);
+  if (dim<1 || dim>3 || N<1 || M<1) {
+    fprintf(stderr,"finufft_autotune: invalid dim=%d, N=%lld or M=%lld\n",dim,(long long)N,(long long)M);
+    return ERR_AUTOTUNE_ARGS;
+  }
+  BIGINT Nd = (BIGINT)(0.5 + pow((double)N,1.0/dim));     // modes per dim
+  if (opts.upsampfac==0.0)                      // tune for the auto choice
+    opts.upsampfac = choose_upsampfac(1,dim,eps,M,Nd,(dim>1) ? Nd : 1,
+				      (dim>2) ? Nd : 1,opts);
+  spread_opts spopts;
+  int ier = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier) return ier;
+  BIGINT nfd[3] = {1,1,1};
+  for (int d=0; d<dim; ++d)
+    set_nf_type12(Nd,opts,spopts,&nfd[d]);
+  BIGINT nf = nfd[0]*nfd[1]*nfd[2];
+  if (nf>MAX_NF) {
+    fprintf(stderr,"nf=%.3g exceeds MAX_NF of %.3g\n",(double)nf,(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  FLT *xyz[3] = {NULL,NULL,NULL};
+  for (int d=0; d<dim; ++d)
+    xyz[d] = (FLT*)malloc(sizeof(FLT)*M);
+  FLT *c = (FLT*)malloc(sizeof(FLT)*2*M);
+  FLT *fw = (FLT*)malloc(sizeof(FLT)*2*nf);
+#pragma omp parallel
+  {
+    unsigned int se=MY_OMP_GET_THREAD_NUM();
+#pragma omp for schedule(static)
+    for (BIGINT j=0; j<M; ++j) {
+      for (int d=0; d<dim; ++d)
+        xyz[d][j] = PI*randm11r(&se);
+      c[2*j] = randm11r(&se); c[2*j+1] = randm11r(&se);
+    }
+  }
+  // candidate bin sizes {x,y,z}, first being the setup_spreader default...
+  static const int bins1[][3] = {{16,1,1},{32,1,1},{64,1,1},{128,1,1},{256,1,1}};
+  static const int bins2[][3] = {{16,4,1},{16,8,1},{32,4,1},{32,8,1},{64,4,1},
+				 {16,16,1},{8,8,1}};
+  static const int bins3[][3] = {{16,4,4},{16,8,4},{32,4,4},{8,8,8},{16,8,8},
+				 {32,8,8},{16,16,16}};
+  static const BIGINT maxsubs[] = {1000,3000,10000,30000,100000};
+  const int (*bins)[3] = (dim==1) ? bins1 : ((dim==2) ? bins2 : bins3);
+  int nbins = (dim==1) ? 5 : 7, nmax = 5, reps = 3;
+
+  // coordinate search: bins at default max_subproblem_size, then the latter
+  double tbest = INFINITY; int ibest = 0;
+  for (int i=0; i<nbins; ++i) {
+    spopts.bin_size_x = bins[i][0]; spopts.bin_size_y = bins[i][1];
+    spopts.bin_size_z = bins[i][2];
+    double t = time_spreadinterp(spopts,nfd[0],nfd[1],nfd[2],fw,M,xyz[0],
+				 xyz[1],xyz[2],c,reps);
+    if (opts.debug) printf("autotune: bins %dx%dx%d, maxsub %lld:\t %.3g s\n",bins[i][0],bins[i][1],bins[i][2],(long long)spopts.max_subproblem_size,t);
+    if (t<tbest) { tbest = t; ibest = i; }
+  }
+  spopts.bin_size_x = bins[ibest][0]; spopts.bin_size_y = bins[ibest][1];
+  spopts.bin_size_z = bins[ibest][2];
+  BIGINT maxsubbest = spopts.max_subproblem_size;
+  for (int i=0; i<nmax; ++i) {
+    if (maxsubs[i]==maxsubbest) continue;                // already timed
+    spopts.max_subproblem_size = maxsubs[i];
+    double t = time_spreadinterp(spopts,nfd[0],nfd[1],nfd[2],fw,M,xyz[0],
+				 xyz[1],xyz[2],c,reps);
+    if (opts.debug) printf("autotune: bins %dx%dx%d, maxsub %lld:\t %.3g s\n",spopts.bin_size_x,spopts.bin_size_y,spopts.bin_size_z,(long long)maxsubs[i],t);
+    if (t<tbest) { tbest = t; maxsubbest = maxsubs[i]; }
+  }
+  for (int d=0; d<dim; ++d) free(xyz[d]);
+  free(c); free(fw);
+  if (opts.debug) printf("autotune: best bins %dx%dx%d, maxsub %lld (%.3g s)\n",bins[ibest][0],bins[ibest][1],bins[ibest][2],(long long)maxsubbest,tbest);
+
+  tune_entry e;
+  e.dim = dim; e.ns = spopts.nspread;
+  e.l2nf = log2((double)nf); e.l2M = log2((double)M);
+  e.binx = bins[ibest][0]; e.biny = bins[ibest][1]; e.binz = bins[ibest][2];
+  e.maxsub = maxsubbest; e.t = tbest;
+#pragma omp critical (finufft_profile)
+  {
+    if (!profile_loaded) load_profile();
+    size_t i;
+    for (i=0; i<profile.size(); ++i)         // replace entry for same shape?
+      if (profile[i].dim==e.dim && profile[i].ns==e.ns &&
+	  fabs(profile[i].l2nf-e.l2nf)<0.5 && fabs(profile[i].l2M-e.l2M)<0.5) {
+	profile[i] = e;
+	break;
+      }
+    if (i==profile.size()) profile.push_back(e);
+    ier = save_profile();
+  }
+  return ier;
+}
@@ -0,0 +1,17 @@
+// interface to spreader autotuning and the per-host tuning profile.
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "finufft.h"
+#include "spreadinterp.h"
+
+// Max distance (sum of |log2| differences in fine grid size and M, plus half
+// the kernel width difference) for a profile entry to be used for a problem.
+#define PROFILE_MAX_DIST 4.0
+
+// autotune.cpp provides (plus finufft_autotune, declared in finufft.h)...
+void profile_filename(char *fname, int len);
+int apply_spread_profile(spread_opts &spopts, int ndims, BIGINT nf, BIGINT M);
+
+#endif  // AUTOTUNE_H
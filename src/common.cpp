@@ -6,7 +6,13 @@
 #include <fftw3.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
 #include <vector>
+#ifdef __linux__
+  #include <sys/mman.h>      // madvise
+#endif
 
 #ifdef NEED_EXTERN_C
 extern "C" {
@@ -21,7 +27,7 @@ void finufft_default_opts(nufft_opts *o)
 // This was created to avoid uncertainty about C++11 style static initialization
 // when called from MEX. Barnett 10/30/17
 {
-  o->upsampfac = (FLT)2.0;   // sigma: either 2.0, or 1.25 for smaller RAM, FFTs
+  o->upsampfac = (FLT)2.0;   // sigma: 2.0, 1.25 for smaller RAM, FFTs, or 0 auto
   o->chkbnds = 0;
   o->debug = 0;
   o->spread_debug = 0;
@@ -30,29 +36,456 @@ void finufft_default_opts(nufft_opts *o)
   o->spread_kerpad = 1;      // (relevant iff kerevalmeth=0)
   o->fftw = FFTW_ESTIMATE;   // use FFTW_MEASURE for slow first call, fast rerun
   o->modeord = 0;
+  o->nthreads = 0;           // use OpenMP's current max # threads
+  o->stats = NULL;           // no statistics output
+  o->spread_bin_size_x = 0;  // 0: use autotune profile, else built-in default
+  o->spread_bin_size_y = 0;
+  o->spread_bin_size_z = 0;
+  o->spread_max_sp_size = 0;
+  o->direct = 0;             // auto: direct sum for tiny problems (types 1,2)
+  o->spread_kerprecomp = 0;  // plans: evaluate kernel at each execute
+  o->hugepages = 0;          // no madvise; THP system default applies
+  o->nf_maxprime = 7;        // fine grid sizes 2,3,5,7-smooth (FFTW is fast)
+  o->nf_timed = 0;           // smallest smooth size, not fastest measured
+  o->upsampfac_x = 0;        // per-dim sigmas: 0 means upsampfac
+  o->upsampfac_y = 0;
+  o->upsampfac_z = 0;
+  o->modeset = 0;            // all modes in the box
+  o->modelines = NULL;
+  o->xstride = 1;            // user arrays contiguous
+  o->cstride = 1;
+  o->fkstride = 1;
 }
 
-int setup_spreader_for_nufft(spread_opts &spopts, FLT eps, nufft_opts opts)
+int setup_spreader_for_nufft(spread_opts &spopts, FLT eps, nufft_opts opts,
+			     int dim)
 // Set up the spreader parameters given eps, and pass across various nufft
 // options. Report status of setup_spreader.  Barnett 10/30/17
+// If dim>1, the first dim dims use their opts.upsampfac_{x,y,z} where nonzero
+// (anisotropic kernels, see setup_spreader_dims); get dim d's sigma and kernel
+// from spread_dim_opts(spopts,d).
 {
-  int ier=setup_spreader(spopts, eps, opts.upsampfac, opts.spread_kerevalmeth);
+  FLT sig[3] = {opts.upsampfac, opts.upsampfac, opts.upsampfac};
+  if (dim>1) {
+    FLT s[3] = {opts.upsampfac_x, opts.upsampfac_y, opts.upsampfac_z};
+    for (int d=0; d<dim; ++d)
+      if (s[d]>0.0) sig[d] = s[d];
+  }
+  int ier=setup_spreader_dims(spopts, eps, sig, dim, opts.spread_kerevalmeth);
   spopts.debug = opts.spread_debug;
   spopts.sort = opts.spread_sort;     // could make dim or CPU choices here?
   spopts.kerpad = opts.spread_kerpad; // (only applies to kerevalmeth=0)
   spopts.chkbnds = opts.chkbnds;
   spopts.pirange = 1;                 // could allow user control?
+  spopts.nthreads = opts.nthreads;
   return ier;
 } 
 
+int set_spread_strides(spread_opts &spopts, nufft_opts opts)
+// Passes the layout of the user's NU pt coords and strengths (opts.xstride,
+// cstride) to the spreader, for the type 1,2 calls which spread from or
+// interpolate to the user's arrays in place. Returns 0, or
+// ERR_STRIDE_NOTVALID if any of these or opts.fkstride is <1.
+{
+  if (opts.xstride<1 || opts.cstride<1 || opts.fkstride<1)
+    return ERR_STRIDE_NOTVALID;
+  spopts.kstride = opts.xstride;
+  spopts.cstride = opts.cstride;
+  return 0;
+}
+
+FLT choose_upsampfac(int type, int dim, FLT eps, BIGINT M, FLT N1, FLT N2,
+		     FLT N3, nufft_opts opts)
+/* Automatic choice of upsampling factor sigma (for opts.upsampfac=0), between
+   the two values with Horner kernels, 2.0 and 1.25, via a crude cost model:
+   spreading (or interpolation) costs SPREAD_FFT_COST_RATIO * M * ns^dim, and
+   an FFT of total fine grid size nf costs nf log2(nf). The smaller sigma gives
+   smaller FFTs but wider kernels, so tends to win when M/N is small.
+   Inputs: type = 1,2 or 3, dim = dimension, eps = requested tolerance,
+   M = # NU pts (for type 3 sources plus targets), N1,N2,N3 = # modes in each
+   dim (unused dims 1); for type 3 these are the space-frequency products
+   2*S*X/pi, ie the fine grid size divided by sigma. opts sets kerevalmeth.
+   Returns the chosen sigma. Type 3 includes the cost of its inner type 2.
+*/
+{
+  FLT sigmas[2] = {2.0, 1.25};
+  double cost[2];
+  FLT N[3] = {N1,N2,N3};
+  int nsig = (eps>=LOWUPSAMP_MIN_EPS) ? 2 : 1;    // 1.25 can't reach small eps
+  for (int i=0; i<nsig; ++i) {
+    spread_opts spopts;
+    if (setup_spreader(spopts,eps,sigmas[i],opts.spread_kerevalmeth)) {
+      nsig = i; break;                       // (error reported by caller)
+    }
+    double ns = spopts.nspread, nf = 1.0, nfin = 1.0;
+    for (int d=0; d<dim; ++d) {
+      double nfd = std::max<double>(sigmas[i]*std::max<double>(N[d],1.0),
+				    2.0*ns);          // as set_nf_*
+      nf *= nfd;
+      nfin *= std::max<double>(sigmas[i]*nfd, 2.0*ns);  // type 3's inner type 2
+    }
+    cost[i] = SPREAD_FFT_COST_RATIO*(double)M*pow(ns,dim) + nf*log2(nf);
+    if (type==3) cost[i] += nfin*log2(nfin);
+  }
+  FLT sigma = (nsig==2 && isfinite(cost[1]) && cost[1]<cost[0]) ? sigmas[1]
+    : sigmas[0];
+  if (opts.debug) {
+    printf("auto upsampfac: model cost sigma=2.0 %.3g",cost[0]);
+    if (nsig==2) printf(", sigma=1.25 %.3g",cost[1]);
+    printf(": chose %.3g\n",(double)sigma);
+  }
+  return sigma;
+}
+
+int use_direct(int dim, BIGINT M, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT nf1,
+	       BIGINT nf2, BIGINT nf3, spread_opts spopts, nufft_opts opts)
+/* Decide whether a type-1 or type-2 transform with M NU pts and N1*N2*N3
+   modes (unused dims 1), already set up for fine grid nf1*nf2*nf3 and kernel
+   width spopts.nspread, should instead be done by direct summation (see
+   direct.cpp), which is exact to rounding so always meets the tolerance.
+   opts.direct = 1 forces it, -1 prevents it, and 0 (default) chooses it when
+   the crude cost model (constants DIRECT_* in defs.h) predicts it is faster,
+   ie for tiny problems, where the NUFFT is dominated by its setup costs.
+   Non-unit strides (opts.xstride etc) always use the NUFFT, since the
+   direct sum reads contiguous arrays.
+   Returns 1 for direct summation, 0 for the NUFFT.
+*/
+{
+  if (opts.xstride!=1 || opts.cstride!=1 || opts.fkstride!=1) return 0;
+  if (opts.direct!=0) return (opts.direct>0);
+  double ns = spopts.nspread, N = (double)N1*N2*N3, nf = (double)nf1*nf2*nf3;
+  int q = (int)(2 + 1.5*ns);                    // as in onedim_fseries_kernel
+  double nseg = (double)((N1+DIRECT_RESEED-1)/DIRECT_RESEED);
+  double cdir = (double)M*N + DIRECT_SEED_COST*M*(nseg + (dim>1 ? N2 : 0) +
+					       (dim>2 ? N3 : 0));
+  double cnufft = DIRECT_NUFFT_OVERHEAD + DIRECT_SPREAD_COST*M*pow(ns,dim) +
+    DIRECT_FFT_COST*nf*log2(max(nf,2.0)) +
+    DIRECT_KERSER_COST*q*0.5*(nf1 + (dim>1 ? nf2 : 0) + (dim>2 ? nf3 : 0));
+  if (opts.debug)
+    printf("direct sum model cost %.3g vs NUFFT %.3g\n",cdir,cnufft);
+  return (cdir<cnufft);
+}
+
+void set_spread_tuning(spread_opts &spopts, nufft_opts opts, BIGINT nf1,
+		       BIGINT nf2, BIGINT nf3, BIGINT M)
+// Choose the spreader's sort bin sizes and max subproblem size for a problem
+// with fine grid nf1*nf2*nf3 and M NU pts: use the per-host autotune profile
+// if it has a nearby entry (else the setup_spreader defaults), then let any
+// nonzero user opts override.
+{
+  int ndims = 1 + (nf2>1) + (nf3>1);
+  apply_spread_profile(spopts,ndims,nf1*nf2*nf3,M);
+  if (opts.spread_bin_size_x>0) spopts.bin_size_x = opts.spread_bin_size_x;
+  if (opts.spread_bin_size_y>0) spopts.bin_size_y = opts.spread_bin_size_y;
+  if (opts.spread_bin_size_z>0) spopts.bin_size_z = opts.spread_bin_size_z;
+  if (opts.spread_max_sp_size>0) spopts.max_subproblem_size = opts.spread_max_sp_size;
+  if (opts.debug)
+    printf("spread tuning: bins %dx%dx%d, max subprob size %lld\n",
+	   spopts.bin_size_x,spopts.bin_size_y,spopts.bin_size_z,
+	   (long long)spopts.max_subproblem_size);
+}
+
+void start_stats(nufft_stats &st, spread_opts &spopts, BIGINT nf1, BIGINT nf2,
+		 BIGINT nf3)
+// Zero a driver's local stats struct, record the fine grid sizes, and hook it
+// into spopts so that the spreader adds its sort/spread timings to it.
+{
+  memset(&st,0,sizeof(nufft_stats));
+  st.nf1 = nf1; st.nf2 = nf2; st.nf3 = nf3;
+  st.nspread = spopts.nspread;
+  spopts.stats = &st;
+}
+
+void add_stats(nufft_stats &st, const nufft_stats &s2)
+// Accumulate the per-stage costs of a sub-call (eg the type-2 inside type-3)
+// into st. Grid sizes and thread counts are left as those of st.
+{
+  st.t_kerfser += s2.t_kerfser;
+  st.t_fftwplan += s2.t_fftwplan;
+  st.t_sort += s2.t_sort;
+  st.t_spread += s2.t_spread;
+  st.t_fft += s2.t_fft;
+  st.t_deconv += s2.t_deconv;
+  st.t_prephase += s2.t_prephase;
+  st.t_kerFT += s2.t_kerFT;
+  st.t_direct += s2.t_direct;
+  st.bytes_alloc += s2.bytes_alloc;
+  st.bytes_kerprecomp += s2.bytes_kerprecomp;
+  st.nsubprobs += s2.nsubprobs;
+  st.did_sort = st.did_sort || s2.did_sort;
+}
+
+void finish_stats(nufft_stats &st, double t_total, BIGINT npts,
+		  nufft_opts opts)
+// Fill whole-call fields of the local stats struct st given the total time
+// and total number of NU pts handled, then copy out to user's struct if
+// requested via opts.stats.
+{
+  st.t_total = t_total;
+  st.nthreads = MY_OMP_GET_MAX_THREADS();
+  st.pts_per_sec = (t_total>0.0) ? npts/t_total : 0.0;
+  if (opts.debug)
+    printf("total (%.3g Mbyte alloc, %d threads):\t %.3g s\n",
+	   st.bytes_alloc/1e6,st.nthreads,t_total);
+  if (opts.stats)
+    *opts.stats = st;
+}
+
+static void planner_threads(int nth)
+// sets FFTW's planner to nth threads (call inside critical finufft_fftw);
+// fftw_init_threads is called only the first time. Always sets the count,
+// even for nth=1, since another FFTW user may have left it higher.
+{
+  static int fftw_threads_ready = 0;
+  if (!fftw_threads_ready) {
+    FFTW_INIT();           // (these do nothing anyway when OMP=OFF)
+    fftw_threads_ready = 1;
+  }
+  FFTW_PLAN_TH(nth);
+}
+
+FFTW_PLAN plan_fftw(int dim, const int *n, int howmany, FFTW_CPX *fw,
+		    int sign, unsigned flags, int nth, int interleaved)
+/* Makes FFTW plan for howmany in-place complex FFTs of size n[0]*..*n[dim-1]
+   (row-major, ie n[dim-1] fastest) stored contiguously in fw, using nth
+   threads. If interleaved is nonzero the arrays are instead interleaved, ie
+   element i of array d is fw[i*howmany+d]. FFTW's planner is not thread-safe,
+   so planning is serialized across all threads calling the library;
+   fftw_init_threads is called only once,
+   and the planner's thread count is left at FFTW's default of 1 after (FFTW
+   has no portable way to read the application's own setting, which is thus
+   not restored). Executing the plan is thread-safe. Destroy with
+   destroy_fftw.
+*/
+{
+  FFTW_PLAN p;
+  int dist = 1, stride = 1;
+  for (int d=0; d<dim; ++d) dist *= n[d];
+  if (interleaved) { stride = howmany; dist = 1; }
+#pragma omp critical (finufft_fftw)
+  {
+    planner_threads(nth);
+    p = FFTW_PLAN_MANY_DFT(dim, n, howmany, fw, n, stride, dist, fw, n, stride,
+			   dist, sign, flags);
+    planner_threads(1);
+  }
+  return p;
+}
+
+static FFTW_PLAN plan_lines(int n, int stride, int nh, const FFTW_IODIM *h,
+			    FFTW_CPX *a, int sign, unsigned flags, int nth)
+// Guru plan for in-place 1D FFTs of length n and element stride stride, one
+// for each line in the nh-dim set h, starting at a. Serialized as plan_fftw.
+{
+  FFTW_PLAN p;
+  FFTW_IODIM d = {n, stride, stride};
+#pragma omp critical (finufft_fftw)
+  {
+    planner_threads(nth);
+    p = FFTW_PLAN_GURU_DFT(1, &d, nh, h, a, a, sign, flags);
+    planner_threads(1);
+  }
+  return p;
+}
+
+void plan_pruned_fft(pruned_fft &pf, int dim, BIGINT nf1, BIGINT nf2,
+		     BIGINT nf3, BIGINT ms, BIGINT mt, BIGINT mu,
+		     const BIGINT *ext, FFTW_CPX *fw, int dir, int sign,
+		     unsigned flags, int nth)
+/* Plans the in-place FFT of the fine grid fw (size nf1*nf2*nf3, dim 2 or 3)
+   for a type 1 (dir=1) or type 2 (dir=2) transform whose modes are
+   restricted to the per-x-line extents ext (see set_mode_lines). The FFT is
+   then done one dim at a time, skipping the lines which only feed (type 1) or
+   come from (type 2) unused modes: for type 1, x-FFTs of all x-lines, then
+   y-FFTs of only the columns with a used k1, then (3D) z-FFTs of only the
+   z-lines with a used (k1,k2); type 2 does the reverse, its other lines
+   being zero. At sigma=2 this halves the y work, and for a ball the z work
+   falls to about pi/16 of that for the full grid. If ext is NULL, just plans
+   the usual whole-grid FFT. Execute with exec_pruned_fft, destroy with
+   destroy_pruned_fft.
+*/
+{
+  pf.full = NULL; pf.zblk = pf.zone = NULL; pf.dir = dir;
+  pf.stage.clear(); pf.zruns.clear();
+  if (!ext) {
+    int n[] = {int(nf3), int(nf2), int(nf1)};
+    pf.full = plan_fftw(dim,n+3-dim,1,fw,sign,flags,nth);
+    return;
+  }
+  if (dim==2) { nf3 = 1; mu = 1; }
+  BIGINT np = nf1*nf2, nl = mt*mu;
+  // hull of used k1 over all lines, and over each k2 (3D z-lines)...
+  BIGINT xlo = ms, xhi = -ms;
+  std::vector<BIGINT> lo2(mt,ms), hi2(mt,-ms);
+  for (BIGINT l=0; l<nl; ++l)
+    if (ext[2*l]<=ext[2*l+1]) {
+      BIGINT j = l % mt;
+      xlo = std::min(xlo,ext[2*l]); xhi = std::max(xhi,ext[2*l+1]);
+      lo2[j] = std::min(lo2[j],ext[2*l]); hi2[j] = std::max(hi2[j],ext[2*l+1]);
+    }
+  FFTW_IODIM hx[] = {{int(nf2*nf3),int(nf1),int(nf1)}};
+  FFTW_PLAN px = plan_lines(nf1,1,1,hx,fw,sign,flags,nth);   // all x-lines
+  std::vector<FFTW_PLAN> py;
+  BIGINT c0[2] = {std::max(xlo,(BIGINT)0), nf1+xlo};  // used column ranges
+  BIGINT c1[2] = {xhi, nf1+std::min(xhi,(BIGINT)-1)};
+  for (int r=0; r<2; ++r)
+    if (c1[r]>=c0[r]) {
+      FFTW_IODIM hy[] = {{int(c1[r]-c0[r]+1),1,1},{int(nf3),int(np),int(np)}};
+      py.push_back(plan_lines(nf2,nf1,dim-1,hy,fw+c0[r],sign,flags,nth));
+    }
+  if (dir==1) pf.stage.push_back(px);
+  pf.stage.insert(pf.stage.end(),py.begin(),py.end());
+  if (dir==2) pf.stage.push_back(px);
+  if (dim==3) {                   // z-lines: runs of adjacent used (k1,k2)
+    for (BIGINT k2=-mt/2, j=0; j<mt; ++k2, ++j) {
+      if (lo2[j]>hi2[j]) continue;
+      BIGINT o2 = nf1*((k2>=0) ? k2 : nf2+k2);
+      if (hi2[j]>=0) {          // nonneg k1
+        BIGINT a = std::max(lo2[j],(BIGINT)0);
+        pf.zruns.push_back(o2+a); pf.zruns.push_back(hi2[j]-a+1);
+      }
+      if (lo2[j]<0) {           // neg k1
+        BIGINT b = std::min(hi2[j],(BIGINT)-1);
+        pf.zruns.push_back(o2+nf1+lo2[j]); pf.zruns.push_back(b-lo2[j]+1);
+      }
+    }
+    // single-thread plans, executed on each run by the threads in turn...
+    FFTW_IODIM hb[] = {{PRUNE_ZBLOCK,1,1}}, h1[] = {{1,1,1}};
+    pf.zblk = plan_lines(nf3,np,1,hb,fw,sign,flags|FFTW_UNALIGNED,1);
+    pf.zone = plan_lines(nf3,np,1,h1,fw,sign,flags|FFTW_UNALIGNED,1);
+  }
+}
+
+void exec_pruned_fft(pruned_fft &pf, FFTW_CPX *fw)
+// Does the FFT planned by plan_pruned_fft on fw (the array it was planned on)
+{
+  if (pf.full) { FFTW_EX(pf.full); return; }
+  if (pf.dir==1)
+    for (size_t s=0; s<pf.stage.size(); ++s) FFTW_EX(pf.stage[s]);
+  BIGINT nr = pf.zruns.size()/2;
+#pragma omp parallel for schedule(dynamic)
+  for (BIGINT r=0; r<nr; ++r) {
+    FFTW_CPX *a = fw + pf.zruns[2*r];
+    BIGINT n = pf.zruns[2*r+1], i = 0;
+    for (; i+PRUNE_ZBLOCK<=n; i+=PRUNE_ZBLOCK) FFTW_EX_DFT(pf.zblk,a+i,a+i);
+    for (; i<n; ++i) FFTW_EX_DFT(pf.zone,a+i,a+i);
+  }
+  if (pf.dir==2)
+    for (size_t s=0; s<pf.stage.size(); ++s) FFTW_EX(pf.stage[s]);
+}
+
+void destroy_pruned_fft(pruned_fft &pf)
+{
+  if (pf.full) destroy_fftw(pf.full);
+  for (size_t s=0; s<pf.stage.size(); ++s) destroy_fftw(pf.stage[s]);
+  if (pf.zblk) destroy_fftw(pf.zblk);
+  if (pf.zone) destroy_fftw(pf.zone);
+  pf.full = pf.zblk = pf.zone = NULL; pf.stage.clear();
+}
+
+void destroy_fftw(FFTW_PLAN p)
+// thread-safe destruction of a plan made by plan_fftw
+{
+#pragma omp critical (finufft_fftw)
+  FFTW_DE(p);
+}
+
+FFTW_CPX* alloc_fine_grid(BIGINT n, nufft_opts opts)
+/* Allocates a fine grid (or other FFTW array) of n complex entries, as does
+   FFTW_ALLOC_CPX, then first-touches it with the calling thread's current
+   OpenMP threads, each writing one entry per page of a contiguous static block.
+   On a NUMA machine the pages then live on the nodes of the threads that later
+   zero, spread into and FFT them (these use static contiguous partitions too),
+   rather than all on the node of the allocating thread. If opts.hugepages=1
+   and the array is large, first asks Linux to back it by transparent huge
+   pages, which cuts TLB misses in the scattered writes of spreading.
+   Contents are undefined on return, as for FFTW_ALLOC_CPX. Returns NULL on
+   allocation failure. Call from outside parallel regions.
+*/
+{
+  FFTW_CPX *fw = FFTW_ALLOC_CPX(n);
+  if (!fw) return NULL;
+  size_t bytes = sizeof(FFTW_CPX)*(size_t)n;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (opts.hugepages && bytes>=(size_t)HUGEPAGE_MIN_BYTES) {
+    size_t pg = FIRSTTOUCH_STRIDE;            // madvise needs page alignment
+    char *a = (char*)(((size_t)fw + pg-1)/pg*pg);
+    char *b = (char*)(((size_t)fw + bytes)/pg*pg);
+    if (b>a && madvise(a,b-a,MADV_HUGEPAGE) && opts.debug)
+      printf("madvise(MADV_HUGEPAGE) failed; using normal pages\n");
+  }
+#else
+  (void)opts;
+#endif
+  BIGINT stride = FIRSTTOUCH_STRIDE/sizeof(FFTW_CPX);
+  BIGINT npages = (n+stride-1)/stride;
+#pragma omp parallel for schedule(static)
+  for (BIGINT p=0; p<npages; ++p)
+    fw[p*stride][0] = 0.0;
+  return fw;
+}
+
+static double time_fft1d(BIGINT n, unsigned flags)
+// best time per execution of a single-threaded in-place 1D complex FFT of
+// size n planned with FFTW flags, repeated for at least NF_TIMED_MINSEC.
+{
+  FFTW_CPX *a = FFTW_ALLOC_CPX(n);
+  for (BIGINT i=0; i<n; ++i) a[i][0] = a[i][1] = 0.0;
+  int nn = (int)n;
+  FFTW_PLAN p = plan_fftw(1,&nn,1,a,FFTW_FORWARD,flags,1);
+  int reps = 0;
+  CNTime timer; timer.start();
+  double t;
+  do {
+    FFTW_EX(p);
+    ++reps;
+  } while ((t=timer.elapsedsec())<NF_TIMED_MINSEC);
+  destroy_fftw(p);
+  FFTW_FR(a);
+  return t/reps;
+}
+
+BIGINT next_fine_size(BIGINT n, nufft_opts opts)
+/* Returns the fine grid size (or other FFT length) to use in place of the
+   minimum size n in one dimension: the smallest even integer >= n with no
+   prime factor above opts.nf_maxprime. If opts.nf_timed=1 and n is at most
+   NF_TIMED_MAXN, instead the smooth sizes up to NF_TIMED_GROWFRAC larger
+   (at most NF_TIMED_NCAND of them) are compared by measured 1D FFT time on
+   this machine, and the fastest returned. Timings are cached per size and
+   FFTW flags for the rest of the run, so only the first call measures.
+   Thread-safe.
+*/
+{
+  BIGINT nf = next_smooth_even(n,opts.nf_maxprime);
+  if (!opts.nf_timed || nf>NF_TIMED_MAXN) return nf;
+  static std::map<std::pair<BIGINT,unsigned>,double> fftcost;  // cache
+  BIGINT best = nf, nmax = (BIGINT)(n*(1.0+NF_TIMED_GROWFRAC));
+#pragma omp critical (finufft_nfcost)
+  {
+    double tbest = INFINITY;
+    for (int i=0; i<NF_TIMED_NCAND && (i==0 || nf<=nmax); ++i) {
+      std::pair<BIGINT,unsigned> key(nf,(unsigned)opts.fftw);
+      if (!fftcost.count(key)) fftcost[key] = time_fft1d(nf,opts.fftw);
+      double t = fftcost[key];
+      if (opts.debug>1) printf("nf=%lld: 1D FFT %.3g s\n",(long long)nf,t);
+      if (t<tbest) { tbest = t; best = nf; }
+      nf = next_smooth_even(nf+1,opts.nf_maxprime);
+    }
+  }
+  if (opts.debug) printf("timed fine grid size for n=%lld: %lld\n",
+			 (long long)n,(long long)best);
+  return best;
+}
+
 void set_nf_type12(BIGINT ms, nufft_opts opts, spread_opts spopts, BIGINT *nf)
 // type 1 & 2 recipe for how to set 1d size of upsampled array, nf, given opts
-// and requested number of Fourier modes ms.
+// and requested number of Fourier modes ms. The sigma used is that of spopts
+// (for anisotropic kernels pass spread_dim_opts(spopts,d) for dim d).
 {
-  *nf = (BIGINT)(opts.upsampfac*ms);
+  *nf = (BIGINT)(spopts.upsampfac*ms);
   if (*nf<2*spopts.nspread) *nf=2*spopts.nspread; // otherwise spread fails
   if (*nf<MAX_NF)                                 // otherwise will fail anyway
-    *nf = next235even(*nf);                       // expensive at huge nf
+    *nf = next_fine_size(*nf,opts);
 }
 
 void set_nhg_type3(FLT S, FLT X, nufft_opts opts, spread_opts spopts,
@@ -87,7 +520,7 @@ void set_nhg_type3(FLT S, FLT X, nufft_opts opts, spread_opts spopts,
   // catch too small nf, and nan or +-inf, otherwise spread fails...
   if (*nf<2*spopts.nspread) *nf=2*spopts.nspread;
   if (*nf<MAX_NF)                             // otherwise will fail anyway
-    *nf = next235even(*nf);                   // expensive at huge nf
+    *nf = next_fine_size(*nf,opts);
   *h = 2*PI / *nf;                            // upsampled grid spacing
   *gam = (FLT)*nf / (2.0*opts.upsampfac*Ssafe);  // x scale fac to x'
 }
@@ -192,8 +625,46 @@ void onedim_nuft_kernel(BIGINT nk, FLT *k, FLT *phihat, spread_opts opts)
   }
 }  
 
+int set_mode_lines(std::vector<BIGINT> &ext, int dim, BIGINT ms, BIGINT mt,
+		   BIGINT mu, nufft_opts opts)
+/* Writes the restricted mode set of opts.modeset as per-x-line extents: for
+   each x-line l=(k2+mt/2)+mt*(k3+mu/2) of the mode box (mu=1 in 2D), the
+   first and last used k1 go to ext[2l], ext[2l+1] (the line is unused if
+   first>last). modeset=1 uses the modes in the ellipse (2D) or ellipsoid (3D)
+   inscribed in the box, ie sum_d (k_d/(m_d/2))^2 <= 1; modeset=2 copies
+   opts.modelines. ext is left empty (all modes used) if modeset=0 or dim=1.
+   Returns 0, or ERR_MODESET_NOTVALID.
+*/
+{
+  ext.clear();
+  if (opts.modeset==0 || dim==1)
+    return 0;
+  if (opts.modeset<0 || opts.modeset>2 || (opts.modeset==2 && !opts.modelines))
+    return ERR_MODESET_NOTVALID;
+  if (dim==2) mu = 1;
+  BIGINT kmin = -ms/2, kmax = (ms-1)/2;
+  ext.resize(2*mt*mu);
+  BIGINT l = 0;
+  for (BIGINT k3=-mu/2; k3<=(mu-1)/2; ++k3)
+    for (BIGINT k2=-mt/2; k2<=(mt-1)/2; ++k2, ++l) {
+      BIGINT lo, hi;
+      if (opts.modeset==1) {
+	double q = 1.0 - pow(k2/(0.5*mt),2) - pow(k3/(0.5*mu),2);
+	hi = (q<0.0) ? -1 : (BIGINT)(0.5*ms*sqrt(q));
+	lo = (q<0.0) ? 1 : -hi;
+      } else {
+	lo = opts.modelines[2*l]; hi = opts.modelines[2*l+1];
+	if (lo<=hi && (lo<kmin || hi>kmax))
+	  return ERR_MODESET_NOTVALID;
+      }
+      ext[2*l] = std::max(lo,kmin); ext[2*l+1] = std::min(hi,kmax);
+    }
+  return 0;
+}
+
 void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
-			 FLT *fk, BIGINT nf1, FFTW_CPX* fw, int modeord)
+			 FLT *fk, BIGINT nf1, FFTW_CPX* fw, int modeord,
+			 const BIGINT *ext, BIGINT fks)
 /*
   if dir==1: copies fw to fk with amplification by prefac/ker
   if dir==2: copies fk to fw (and zero pads rest of it), same amplification.
@@ -205,6 +676,9 @@ void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
   fw is a FFTW style complex array, ie FLT [nf1][2], essentially FLTs
        alternating re,im parts.
   ker is real-valued FLT array of length nf1/2+1.
+  ext: if not NULL, only modes k in [ext[0],ext[1]] are used, the others
+       written as zero (to fk if dir==1, fw if dir==2).
+  fks: stride of fk in complex entries (1 for contiguous).
 
   Single thread only, but shouldn't matter since mostly data movement.
 
@@ -220,28 +694,38 @@ void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
 {
   BIGINT kmin = -ms/2, kmax = (ms-1)/2;    // inclusive range of k indices
   if (ms==0) kmax=-1;           // fixes zero-pad for trivial no-mode case
+  BIGINT ka = kmin, kb = kmax;  // range of used k (all, unless ext given)
+  if (ext) { ka = std::max(ka,ext[0]); kb = std::min(kb,ext[1]); }
+  bool some = (ka>kmin || kb<kmax);          // only some modes used?
+  BIGINT st = 2*fks;                 // FLT stride of fk
   // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*kmin, pn = 0;       // CMCL mode-ordering case (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(kmax+1); }   // or, instead, FFT ordering
+  BIGINT pp = -st*kmin, pn = 0;      // CMCL mode-ordering case (2* since cmplx)
+  if (modeord==1) { pp = 0; pn = st*(kmax+1); }  // or, instead, FFT ordering
+  pp += st*std::max(ka,(BIGINT)0); pn += st*(ka-kmin);  // skip unused low k
   if (dir==1) {    // read fw, write out to fk...
-    for (BIGINT k=0;k<=kmax;++k) {                    // non-neg freqs k
-      fk[pp++] = prefac * fw[k][0] / ker[k];          // re
-      fk[pp++] = prefac * fw[k][1] / ker[k];          // im
+    if (some)                                         // unused modes are 0
+      for (BIGINT i=0;i<ms;++i) fk[st*i] = fk[st*i+1] = 0.0;
+    for (BIGINT k=std::max(ka,(BIGINT)0);k<=kb;++k,pp+=st) { // non-neg freqs k
+      fk[pp] = prefac * fw[k][0] / ker[k];            // re
+      fk[pp+1] = prefac * fw[k][1] / ker[k];          // im
     }
-    for (BIGINT k=kmin;k<0;++k) {                     // neg freqs k
-      fk[pn++] = prefac * fw[nf1+k][0] / ker[-k];     // re
-      fk[pn++] = prefac * fw[nf1+k][1] / ker[-k];     // im
+    for (BIGINT k=ka;k<=std::min(kb,(BIGINT)-1);++k,pn+=st) { // neg freqs k
+      fk[pn] = prefac * fw[nf1+k][0] / ker[-k];       // re
+      fk[pn+1] = prefac * fw[nf1+k][1] / ker[-k];     // im
     }
   } else {    // read fk, write out to fw w/ zero padding...
-    for (BIGINT k=kmax+1; k<nf1+kmin; ++k) {  // zero pad precisely where needed
-      fw[k][0] = fw[k][1] = 0.0; }
-    for (BIGINT k=0;k<=kmax;++k) {                    // non-neg freqs k
-      fw[k][0] = prefac * fk[pp++] / ker[k];          // re
-      fw[k][1] = prefac * fk[pp++] / ker[k];          // im
+    if (some)                                  // unused modes are 0 too
+      for (BIGINT k=0; k<nf1; ++k) fw[k][0] = fw[k][1] = 0.0;
+    else
+      for (BIGINT k=kmax+1; k<nf1+kmin; ++k) {  // zero pad precisely where needed
+        fw[k][0] = fw[k][1] = 0.0; }
+    for (BIGINT k=std::max(ka,(BIGINT)0);k<=kb;++k,pp+=st) { // non-neg freqs k
+      fw[k][0] = prefac * fk[pp] / ker[k];            // re
+      fw[k][1] = prefac * fk[pp+1] / ker[k];          // im
     }
-    for (BIGINT k=kmin;k<0;++k) {                     // neg freqs k
-      fw[nf1+k][0] = prefac * fk[pn++] / ker[-k];     // re
-      fw[nf1+k][1] = prefac * fk[pn++] / ker[-k];     // im
+    for (BIGINT k=ka;k<=std::min(kb,(BIGINT)-1);++k,pn+=st) { // neg freqs k
+      fw[nf1+k][0] = prefac * fk[pn] / ker[-k];       // re
+      fw[nf1+k][1] = prefac * fk[pn+1] / ker[-k];     // im
     }
   }
 }
@@ -249,7 +733,7 @@ void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker, BIGINT ms,
 void deconvolveshuffle2d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
 			 BIGINT ms, BIGINT mt,
 			 FLT *fk, BIGINT nf1, BIGINT nf2, FFTW_CPX* fw,
-			 int modeord)
+			 int modeord, const BIGINT *ext, BIGINT fks)
 /*
   2D version of deconvolveshuffle1d, calls it on each x-line using 1/ker2 fac.
 
@@ -265,6 +749,9 @@ void deconvolveshuffle2d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
        alternating re,im parts; again nf1 is fast and nf2 slow.
   ker1, ker2 are real-valued FLT arrays of lengths nf1/2+1, nf2/2+1
        respectively.
+  ext: if not NULL, size 2*mt list of used k1 ranges, one per x-line in
+       increasing k2 order from -mt/2 (see deconvolveshuffle1d).
+  fks: stride of fk in complex entries (1 for contiguous).
 
   Barnett 2/1/17, Fixed mt=0 case 3/14/17. modeord 10/25/17
 */
@@ -272,22 +759,25 @@ void deconvolveshuffle2d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
   BIGINT k2min = -mt/2, k2max = (mt-1)/2;    // inclusive range of k2 indices
   if (mt==0) k2max=-1;           // fixes zero-pad for trivial no-mode case
   // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*k2min*ms, pn = 0;   // CMCL mode-ordering case (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(k2max+1)*ms; }  // or, instead, FFT ordering
+  BIGINT st = 2*fks*ms;              // FLT stride of fk between x-lines
+  BIGINT pp = -st*k2min, pn = 0;     // CMCL mode-ordering case (2* since cmplx)
+  if (modeord==1) { pp = 0; pn = st*(k2max+1); }    // or, instead, FFT ordering
   if (dir==2)               // zero pad needed x-lines (contiguous in memory)
     for (BIGINT j=nf1*(k2max+1); j<nf1*(nf2+k2min); ++j)  // sweeps all dims
       fw[j][0] = fw[j][1] = 0.0;
-  for (BIGINT k2=0;k2<=k2max;++k2, pp+=2*ms)          // non-neg y-freqs
+  for (BIGINT k2=0;k2<=k2max;++k2, pp+=st)          // non-neg y-freqs
     // point fk and fw to the start of this y value's row (2* is for complex):
-    deconvolveshuffle1d(dir,prefac/ker2[k2],ker1,ms,fk + pp,nf1,&fw[nf1*k2],modeord);
-  for (BIGINT k2=k2min;k2<0;++k2, pn+=2*ms)           // neg y-freqs
-    deconvolveshuffle1d(dir,prefac/ker2[-k2],ker1,ms,fk + pn,nf1,&fw[nf1*(nf2+k2)],modeord);
+    deconvolveshuffle1d(dir,prefac/ker2[k2],ker1,ms,fk + pp,nf1,&fw[nf1*k2],modeord,
+			ext ? ext+2*(k2-k2min) : NULL,fks);
+  for (BIGINT k2=k2min;k2<0;++k2, pn+=st)           // neg y-freqs
+    deconvolveshuffle1d(dir,prefac/ker2[-k2],ker1,ms,fk + pn,nf1,&fw[nf1*(nf2+k2)],modeord,
+			ext ? ext+2*(k2-k2min) : NULL,fks);
 }
 
 void deconvolveshuffle3d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
 			 FLT *ker3, BIGINT ms, BIGINT mt, BIGINT mu,
 			 FLT *fk, BIGINT nf1, BIGINT nf2, BIGINT nf3,
-			 FFTW_CPX* fw, int modeord)
+			 FFTW_CPX* fw, int modeord, const BIGINT *ext, BIGINT fks)
 /*
   3D version of deconvolveshuffle2d, calls it on each xy-plane using 1/ker3 fac.
 
@@ -303,6 +793,9 @@ void deconvolveshuffle3d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
        FLTs alternating re,im parts; again nf1 is fastest and nf3 slowest.
   ker1, ker2, ker3 are real-valued FLT arrays of lengths nf1/2+1, nf2/2+1,
        and nf3/2+1 respectively.
+  ext: if not NULL, size 2*mt*mu list of used k1 ranges, one per x-line,
+       with k2 fast and k3 slow, each increasing (see deconvolveshuffle2d).
+  fks: stride of fk in complex entries (1 for contiguous).
 
   Barnett 2/1/17, Fixed mu=0 case 3/14/17. modeord 10/25/17
 */
@@ -310,17 +803,20 @@ void deconvolveshuffle3d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
   BIGINT k3min = -mu/2, k3max = (mu-1)/2;    // inclusive range of k3 indices
   if (mu==0) k3max=-1;           // fixes zero-pad for trivial no-mode case
   // set up pp & pn as ptrs to start of pos(ie nonneg) & neg chunks of fk array
-  BIGINT pp = -2*k3min*ms*mt, pn = 0; // CMCL mode-ordering (2* since cmplx)
-  if (modeord==1) { pp = 0; pn = 2*(k3max+1)*ms*mt; }  // or FFT ordering
+  BIGINT st = 2*fks*ms*mt;           // FLT stride of fk between xy-planes
+  BIGINT pp = -st*k3min, pn = 0;     // CMCL mode-ordering (2* since cmplx)
+  if (modeord==1) { pp = 0; pn = st*(k3max+1); }    // or FFT ordering
   BIGINT np = nf1*nf2;  // # pts in an upsampled Fourier xy-plane
   if (dir==2)           // zero pad needed xy-planes (contiguous in memory)
     for (BIGINT j=np*(k3max+1);j<np*(nf3+k3min);++j)  // sweeps all dims
       fw[j][0] = fw[j][1] = 0.0;
-  for (BIGINT k3=0;k3<=k3max;++k3, pp+=2*ms*mt)      // non-neg z-freqs
+  for (BIGINT k3=0;k3<=k3max;++k3, pp+=st)      // non-neg z-freqs
     // point fk and fw to the start of this z value's plane (2* is for complex):
     deconvolveshuffle2d(dir,prefac/ker3[k3],ker1,ker2,ms,mt,
-			fk + pp,nf1,nf2,&fw[np*k3],modeord);
-  for (BIGINT k3=k3min;k3<0;++k3, pn+=2*ms*mt)       // neg z-freqs
+			fk + pp,nf1,nf2,&fw[np*k3],modeord,
+			ext ? ext+2*mt*(k3-k3min) : NULL,fks);
+  for (BIGINT k3=k3min;k3<0;++k3, pn+=st)       // neg z-freqs
     deconvolveshuffle2d(dir,prefac/ker3[-k3],ker1,ker2,ms,mt,
-			fk + pn,nf1,nf2,&fw[np*(nf3+k3)],modeord);
+			fk + pn,nf1,nf2,&fw[np*(nf3+k3)],modeord,
+			ext ? ext+2*mt*(k3-k3min) : NULL,fks);
 }
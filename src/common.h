@@ -4,7 +4,10 @@
 #include "finufft.h"
 #include "defs.h"
 #include "spreadinterp.h"
+#include "autotune.h"
+#include "direct.h"
 #include <fftw3.h>
+#include <vector>
 
 // defs internal to common.cpp...
 typedef std::complex<double> dcomplex;
@@ -12,7 +15,40 @@ typedef std::complex<double> dcomplex;
 
 
 // common.cpp provides...
-int setup_spreader_for_nufft(spread_opts &spopts, FLT eps, nufft_opts opts);
+int setup_spreader_for_nufft(spread_opts &spopts, FLT eps, nufft_opts opts,
+			     int dim=1);
+int set_spread_strides(spread_opts &spopts, nufft_opts opts);
+FLT choose_upsampfac(int type, int dim, FLT eps, BIGINT M, FLT N1, FLT N2,
+		     FLT N3, nufft_opts opts);
+int use_direct(int dim, BIGINT M, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT nf1,
+	       BIGINT nf2, BIGINT nf3, spread_opts spopts, nufft_opts opts);
+void set_spread_tuning(spread_opts &spopts, nufft_opts opts, BIGINT nf1,
+		       BIGINT nf2, BIGINT nf3, BIGINT M);
+void start_stats(nufft_stats &st, spread_opts &spopts, BIGINT nf1, BIGINT nf2,
+		 BIGINT nf3);
+void add_stats(nufft_stats &st, const nufft_stats &s2);
+void finish_stats(nufft_stats &st, double t_total, BIGINT npts,
+		  nufft_opts opts);
+FFTW_PLAN plan_fftw(int dim, const int *n, int howmany, FFTW_CPX *fw,
+		    int sign, unsigned flags, int nth, int interleaved=0);
+void destroy_fftw(FFTW_PLAN p);
+struct pruned_fft {     // fine-grid FFT skipping lines of unused modes
+  FFTW_PLAN full;                 // whole-grid plan (all modes used), or NULL
+  std::vector<FFTW_PLAN> stage;   // x and y stages, in order of execution
+  int dir;                        // 1 (type 1) or 2 (type 2)
+  FFTW_PLAN zblk, zone;           // 3D: PRUNE_ZBLOCK z-lines, and one z-line
+  std::vector<BIGINT> zruns;      // 3D: offset,count of adjacent used z-lines
+};
+void plan_pruned_fft(pruned_fft &pf, int dim, BIGINT nf1, BIGINT nf2,
+		     BIGINT nf3, BIGINT ms, BIGINT mt, BIGINT mu,
+		     const BIGINT *ext, FFTW_CPX *fw, int dir, int sign,
+		     unsigned flags, int nth);
+void exec_pruned_fft(pruned_fft &pf, FFTW_CPX *fw);
+void destroy_pruned_fft(pruned_fft &pf);
+int set_mode_lines(std::vector<BIGINT> &ext, int dim, BIGINT ms, BIGINT mt,
+		   BIGINT mu, nufft_opts opts);
+FFTW_CPX* alloc_fine_grid(BIGINT n, nufft_opts opts);
+BIGINT next_fine_size(BIGINT n, nufft_opts opts);
 void set_nf_type12(BIGINT ms, nufft_opts opts, spread_opts spopts,BIGINT *nf);
 void set_nhg_type3(FLT S, FLT X, nufft_opts opts, spread_opts spopts,
 		  BIGINT *nf, FLT *h, FLT *gam);
@@ -20,13 +56,31 @@ void onedim_dct_kernel(BIGINT nf, FLT *fwkerhalf, spread_opts opts);
 void onedim_fseries_kernel(BIGINT nf, FLT *fwkerhalf, spread_opts opts);
 void onedim_nuft_kernel(BIGINT nk, FLT *k, FLT *phihat, spread_opts opts);
 void deconvolveshuffle1d(int dir,FLT prefac,FLT* ker,BIGINT ms,FLT *fk,
-			 BIGINT nf1,FFTW_CPX* fw,int modeord);
+			 BIGINT nf1,FFTW_CPX* fw,int modeord,
+			 const BIGINT *ext=NULL, BIGINT fks=1);
 void deconvolveshuffle2d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
 			 BIGINT ms,BIGINT mt,
 			 FLT *fk, BIGINT nf1, BIGINT nf2, FFTW_CPX* fw,
-			 int modeord);
+			 int modeord, const BIGINT *ext=NULL, BIGINT fks=1);
 void deconvolveshuffle3d(int dir,FLT prefac,FLT *ker1, FLT *ker2,
 			 FLT *ker3, BIGINT ms, BIGINT mt, BIGINT mu,
 			 FLT *fk, BIGINT nf1, BIGINT nf2, BIGINT nf3,
-			 FFTW_CPX* fw, int modeord);
+			 FFTW_CPX* fw, int modeord, const BIGINT *ext=NULL,
+			 BIGINT fks=1);
+
+// mode numbering in a size-m array for either ordering (opts.modeord), used
+// in inner loops so inline here...
+static inline BIGINT mode_k(BIGINT i, BIGINT m, int modeord)
+// mode number k in [-m/2,(m-1)/2] stored at index i in a size-m array
+{
+  if (modeord==1) return (i<(m+1)/2) ? i : i-m;   // FFT-style
+  return i - m/2;                                 // CMCL-style (increasing)
+}
+static inline BIGINT mode_index(BIGINT k, BIGINT m, int modeord)
+// index in a size-m array of mode k in [-m/2,(m-1)/2] (inverse of mode_k)
+{
+  if (modeord==1) return (k>=0) ? k : m+k;        // FFT-style
+  return k + m/2;                                 // CMCL-style (increasing)
+}
+
 #endif  // COMMON_H
@@ -22,10 +22,58 @@
 #define MAX_NQUAD 100
 
 // Internal (nf1 etc) array allocation size that immediately raises error.
-// (Note: next235 takes 1s for this size.)
 // Increase this if you need >1TB RAM... (used only in common.cpp)
 #define MAX_NF    (BIGINT)1e11
 
+// Cost model for automatic upsampfac choice (used only in common.cpp): cost of
+// one kernel-point spread or interp relative to one unit of FFT nf*log2(nf).
+#define SPREAD_FFT_COST_RATIO 1.0
+// Smallest eps for which upsampfac=1.25 is considered (max ns is reached).
+#define LOWUPSAMP_MIN_EPS 1e-9
+// Cost model for the automatic direct-sum choice for types 1,2 (common.cpp),
+// in units of one direct-sum term (one NU pt and one mode): one exact phase
+// seed in direct.cpp, the fixed setup of a NUFFT (FFTW plan lookup,
+// allocations, threads), one kernel-point spread or interp, one unit of FFT
+// nf*log2(nf), and one kernel Fourier series quadrature node at one frequency.
+// Fitted to timings of a single-threaded AVX2 machine.
+#define DIRECT_SEED_COST      40.0
+#define DIRECT_NUFFT_OVERHEAD 6e4
+#define DIRECT_SPREAD_COST    2.0
+#define DIRECT_FFT_COST       1.5
+#define DIRECT_KERSER_COST    6.0
+// Bin-sorting NU pts that are already nearly in bin order (used only in
+// spreadinterp.cpp): the sort is replaced by a merge fix-up if at most
+// 1/PRESORT_FIXUP_FRAC of the pts are out of order, and the sort would use at
+// most PRESORT_FIXUP_MAXTHR threads (the fix-up is single-threaded).
+#define PRESORT_FIXUP_FRAC    16
+#define PRESORT_FIXUP_MAXTHR  4
+// Re-sorting moved NU pts (spreadinterp.cpp:spreadresort) patches the old
+// order if at most 1/RESORT_PATCH_FRAC of the pts changed bin, else sorts.
+#define RESORT_PATCH_FRAC     64
+// Kernel widths up to which the Horner kernel is evaluated for blocks of
+// KERBLOCK NU pts at once, vectorized across pts rather than across the w
+// (padded) offsets of one pt, so every SIMD lane (eg all 8 or 16 of AVX-512)
+// does useful work; plain loops left to the compiler's auto-vectorization
+// (used only in spreadinterp.cpp).
+#define KERBLOCK_MAXW 6
+#define KERBLOCK      32
+// Fine grids at least this many bytes get a transparent huge page hint when
+// opts.hugepages=1 (Linux only; used only in common.cpp). First-touch page
+// granularity in bytes (a lower bound on the OS page size is all that matters).
+#define HUGEPAGE_MIN_BYTES    ((BIGINT)1<<25)
+#define FIRSTTOUCH_STRIDE     4096
+// Fine grid size choice by measured FFT time, opts.nf_timed=1 (used only in
+// common.cpp): compare at most NF_TIMED_NCAND smooth sizes up to a fraction
+// NF_TIMED_GROWFRAC above the smallest, only for sizes up to NF_TIMED_MAXN
+// (beyond that the smallest is used), timing each for NF_TIMED_MINSEC secs.
+#define NF_TIMED_NCAND        8
+#define NF_TIMED_GROWFRAC     0.1
+#define NF_TIMED_MAXN         ((BIGINT)1<<20)
+#define NF_TIMED_MINSEC       1e-3
+// # adjacent z-lines done by one FFTW call in the pruned 3D FFT for a
+// restricted mode set (used only in common.cpp).
+#define PRUNE_ZBLOCK          8
+
 
 
 // ---------- Global error output codes for the library -----------------------
@@ -40,6 +88,13 @@
 #define ERR_UPSAMPFAC_TOO_SMALL  7
 #define HORNER_WRONG_BETA        8
 #define ERR_NDATA_NOTVALID       9
+#define ERR_PROFILE_IO           10
+#define ERR_AUTOTUNE_ARGS        11
+#define ERR_BATCH_ARGS           12
+#define ERR_PLAN_ARGS            13
+#define ERR_MODESET_NOTVALID     14
+#define ERR_STRIDE_NOTVALID      15
+#define ERR_ASYNC_ARGS           16
 
 
 
@@ -93,7 +148,10 @@ using namespace std;        // means std:: not needed for cout, max, etc
   #define FFTW_PLAN_2D fftwf_plan_dft_2d
   #define FFTW_PLAN_3D fftwf_plan_dft_3d
   #define FFTW_PLAN_MANY_DFT fftwf_plan_many_dft
+  #define FFTW_PLAN_GURU_DFT fftwf_plan_guru_dft
+  typedef fftwf_iodim FFTW_IODIM;
   #define FFTW_EX fftwf_execute
+  #define FFTW_EX_DFT fftwf_execute_dft
   #define FFTW_DE fftwf_destroy_plan
   #define FFTW_FR fftwf_free
   #define FFTW_FORGET_WISDOM fftwf_forget_wisdom
@@ -111,7 +169,10 @@ using namespace std;        // means std:: not needed for cout, max, etc
   #define FFTW_PLAN_2D fftw_plan_dft_2d
   #define FFTW_PLAN_3D fftw_plan_dft_3d
   #define FFTW_PLAN_MANY_DFT fftw_plan_many_dft
+  #define FFTW_PLAN_GURU_DFT fftw_plan_guru_dft
+  typedef fftw_iodim FFTW_IODIM;
   #define FFTW_EX fftw_execute
+  #define FFTW_EX_DFT fftw_execute_dft
   #define FFTW_DE fftw_destroy_plan
   #define FFTW_FR fftw_free
   #define FFTW_FORGET_WISDOM fftw_forget_wisdom
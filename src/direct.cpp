@@ -0,0 +1,196 @@
+// Direct summation of type-1 and type-2 NUFFTs in 1, 2 or 3 dims, used by the
+// drivers in place of spread/FFT/deconvolve for tiny problems where the cost
+// model (common.cpp:use_direct) predicts it is faster.
+//
+// Phases exp(+-i k1 x_j) are wound along the fastest mode index k1 by repeated
+// complex multiplication, reseeded every DIRECT_RESEED modes (and at the start
+// of each row of modes k2,k3) from tables of exact sin/cos, so that rounding
+// error does not grow with the number of modes and only O(M(N1/DIRECT_RESEED
+// + N2 + N3)) sin/cos are needed. The inner loops run over blocks of
+// DIRECT_BLOCK NU pts in split real/imag arrays, so they vectorize. Type 1 is
+// multithreaded over segments of output modes, type 2 over blocks of NU pts,
+// so each thread writes to its own part of the output.
+
+#include "direct.h"
+#include "common.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+using namespace std;
+
+struct phase_tables {   // exact phases for seeding, each [i*M+j] split re,im
+  FLT *ar, *ai;         // exp(i sgn x_j), the factor advancing k1 by one
+  FLT *sr, *si;         // exp(i sgn k1 x_j) at each segment start k1
+  FLT *yr, *yi;         // exp(i sgn k2 y_j) for each k2 (dim>1)
+  FLT *zr, *zi;         // exp(i sgn k3 z_j) for each k3 (dim>2)
+};
+
+static void phase_table(BIGINT M, FLT *x, FLT sgn, BIGINT kmin, BIGINT step,
+			BIGINT n, FLT **er, FLT **ei)
+// allocates and fills er + i ei [i*M+j] = exp(i sgn (kmin + i*step) x_j), for
+// i=0,..,n-1 and all NU pts j
+{
+  *er = (FLT*)malloc(sizeof(FLT)*n*M);
+  *ei = (FLT*)malloc(sizeof(FLT)*n*M);
+#pragma omp parallel for schedule(static)
+  for (BIGINT j=0; j<M; ++j)
+    for (BIGINT i=0; i<n; ++i) {
+      FLT ph = sgn*(FLT)(kmin+i*step)*x[j];
+      (*er)[i*M+j] = cos(ph);
+      (*ei)[i*M+j] = sin(ph);
+    }
+}
+
+static void setup_phases(phase_tables &t, int dim, BIGINT M, FLT *x, FLT *y,
+			 FLT *z, FLT sgn, BIGINT ms, BIGINT mt, BIGINT mu)
+{
+  BIGINT nseg = (ms+DIRECT_RESEED-1)/DIRECT_RESEED;
+  phase_table(M,x,sgn,1,1,1,&t.ar,&t.ai);
+  phase_table(M,x,sgn,-(ms/2),DIRECT_RESEED,nseg,&t.sr,&t.si);
+  t.yr = t.yi = t.zr = t.zi = NULL;
+  if (dim>1) phase_table(M,y,sgn,-(mt/2),1,mt,&t.yr,&t.yi);
+  if (dim>2) phase_table(M,z,sgn,-(mu/2),1,mu,&t.zr,&t.zi);
+}
+
+static void free_phases(phase_tables &t)
+{
+  free(t.ar); free(t.ai); free(t.sr); free(t.si);
+  free(t.yr); free(t.yi); free(t.zr); free(t.zi);
+}
+
+static inline void seed(int dim, const phase_tables &t, BIGINT M, BIGINT j0,
+			int nb, BIGINT s, BIGINT i2, BIGINT i3, FLT *qr, FLT *qi)
+// qr + i qi [j] = exp(i sgn (k1 x + k2 y + k3 z)) for NU pts j0+j, j<nb, at
+// start of segment s of row with k2,k3 indices (from min) i2,i3
+{
+  const FLT *sr = t.sr+s*M+j0, *si = t.si+s*M+j0;
+  for (int j=0; j<nb; ++j) { qr[j] = sr[j]; qi[j] = si[j]; }
+  for (int d=1; d<dim; ++d) {
+    const FLT *er = (d==1) ? t.yr+i2*M+j0 : t.zr+i3*M+j0;
+    const FLT *ei = (d==1) ? t.yi+i2*M+j0 : t.zi+i3*M+j0;
+    for (int j=0; j<nb; ++j) {
+      FLT tr = qr[j]*er[j] - qi[j]*ei[j];
+      qi[j] = qr[j]*ei[j] + qi[j]*er[j];
+      qr[j] = tr;
+    }
+  }
+}
+
+void direct_type1(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *c,
+		  int iflag, BIGINT ms, BIGINT mt, BIGINT mu, CPX *fk,
+		  int modeord)
+/* Direct evaluation of the dim-dimensional type-1 NUFFT, as finufft?d1:
+
+     fk[k1,k2,k3] = SUM_j c[j] exp(+-i (k1 x[j] + k2 y[j] + k3 z[j]))
+
+   for modes k1,k2,k3 in the ranges [-m/2,(m-1)/2] for m = ms,mt,mu, output
+   ordered according to modeord (0: CMCL, 1: FFT-style). Unused dims must have
+   mt or mu = 1; y or z are then not read. Uses all available threads.
+*/
+{
+  if (dim<2) mt = 1;
+  if (dim<3) mu = 1;
+  FLT sgn = (iflag>=0) ? 1.0 : -1.0;
+  BIGINT kmin1 = -(ms/2), kmin2 = -(mt/2), kmin3 = -(mu/2);
+  BIGINT nseg = (ms+DIRECT_RESEED-1)/DIRECT_RESEED;  // segments per row
+  BIGINT ntask = nseg*mt*mu;
+  phase_tables t;
+  setup_phases(t,dim,M,x,y,z,sgn,ms,mt,mu);
+#pragma omp parallel
+  {
+    FLT qr[DIRECT_BLOCK], qi[DIRECT_BLOCK];   // c_j times current phase
+    FLT fr[DIRECT_RESEED], fi[DIRECT_RESEED]; // this segment's output
+#pragma omp for schedule(dynamic,1)
+    for (BIGINT task=0; task<ntask; ++task) {  // task: DIRECT_RESEED k1 modes
+      BIGINT s = task%nseg, r = task/nseg, i2 = r%mt, i3 = r/mt;
+      BIGINT k1a = kmin1 + s*DIRECT_RESEED;
+      int nk = (int)min((BIGINT)DIRECT_RESEED, kmin1+ms-k1a);
+      for (int k=0; k<nk; ++k) fr[k] = fi[k] = 0.0;
+      for (BIGINT j0=0; j0<M; j0+=DIRECT_BLOCK) {
+	int nb = (int)min((BIGINT)DIRECT_BLOCK, M-j0);
+	seed(dim,t,M,j0,nb,s,i2,i3,qr,qi);
+	for (int j=0; j<nb; ++j) {             // times strengths
+	  FLT cr = real(c[j0+j]), ci = imag(c[j0+j]);
+	  FLT tr = cr*qr[j] - ci*qi[j];
+	  qi[j] = cr*qi[j] + ci*qr[j];
+	  qr[j] = tr;
+	}
+	const FLT *a_r = t.ar+j0, *a_i = t.ai+j0;
+	for (int k=0; k<nk; ++k) {
+	  FLT sr = 0.0, si = 0.0;
+#pragma omp simd reduction(+:sr,si)
+	  for (int j=0; j<nb; ++j) {
+	    sr += qr[j]; si += qi[j];
+	    FLT tr = qr[j]*a_r[j] - qi[j]*a_i[j];   // wind to next k1
+	    qi[j] = qr[j]*a_i[j] + qi[j]*a_r[j];
+	    qr[j] = tr;
+	  }
+	  fr[k] += sr; fi[k] += si;
+	}
+      }
+      BIGINT off = ms*(mode_index(kmin2+i2,mt,modeord) +
+		       mt*mode_index(kmin3+i3,mu,modeord));
+      for (int k=0; k<nk; ++k)
+	fk[off + mode_index(k1a+k,ms,modeord)] = CPX(fr[k],fi[k]);
+    }
+  }
+  free_phases(t);
+}
+
+void direct_type2(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *c,
+		  int iflag, BIGINT ms, BIGINT mt, BIGINT mu, CPX *fk,
+		  int modeord)
+/* Direct evaluation of the dim-dimensional type-2 NUFFT, as finufft?d2:
+
+     c[j] = SUM_{k1,k2,k3} fk[k1,k2,k3] exp(+-i (k1 x[j] + k2 y[j] + k3 z[j]))
+
+   for j=0,..,M-1, with modes and their ordering as in direct_type1. Uses all
+   available threads.
+*/
+{
+  if (dim<2) mt = 1;
+  if (dim<3) mu = 1;
+  FLT sgn = (iflag>=0) ? 1.0 : -1.0;
+  BIGINT kmin1 = -(ms/2), kmin2 = -(mt/2), kmin3 = -(mu/2);
+  BIGINT nseg = (ms+DIRECT_RESEED-1)/DIRECT_RESEED;
+  BIGINT nblk = (M+DIRECT_BLOCK-1)/DIRECT_BLOCK;
+  phase_tables t;
+  setup_phases(t,dim,M,x,y,z,sgn,ms,mt,mu);
+#pragma omp parallel
+  {
+    FLT qr[DIRECT_BLOCK], qi[DIRECT_BLOCK];   // current phases
+    FLT sr[DIRECT_BLOCK], si[DIRECT_BLOCK];   // output sums
+#pragma omp for schedule(dynamic,1)
+    for (BIGINT b=0; b<nblk; ++b) {
+      BIGINT j0 = b*DIRECT_BLOCK;
+      int nb = (int)min((BIGINT)DIRECT_BLOCK, M-j0);
+      const FLT *a_r = t.ar+j0, *a_i = t.ai+j0;
+      for (int j=0; j<nb; ++j) sr[j] = si[j] = 0.0;
+      for (BIGINT r=0; r<mt*mu; ++r) {           // rows of modes
+	BIGINT i2 = r%mt, i3 = r/mt;
+	BIGINT off = ms*(mode_index(kmin2+i2,mt,modeord) +
+			 mt*mode_index(kmin3+i3,mu,modeord));
+	for (BIGINT s=0; s<nseg; ++s) {
+	  BIGINT k1a = kmin1 + s*DIRECT_RESEED;
+	  int nk = (int)min((BIGINT)DIRECT_RESEED, kmin1+ms-k1a);
+	  seed(dim,t,M,j0,nb,s,i2,i3,qr,qi);
+	  for (int k=0; k<nk; ++k) {
+	    CPX f = fk[off + mode_index(k1a+k,ms,modeord)];
+	    FLT fr = real(f), fi = imag(f);
+#pragma omp simd
+	    for (int j=0; j<nb; ++j) {
+	      sr[j] += fr*qr[j] - fi*qi[j];
+	      si[j] += fr*qi[j] + fi*qr[j];
+	      FLT tr = qr[j]*a_r[j] - qi[j]*a_i[j];   // wind to next k1
+	      qi[j] = qr[j]*a_i[j] + qi[j]*a_r[j];
+	      qr[j] = tr;
+	    }
+	  }
+	}
+      }
+      for (int j=0; j<nb; ++j)
+	c[j0+j] = CPX(sr[j],si[j]);
+    }
+  }
+  free_phases(t);
+}
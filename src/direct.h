@@ -0,0 +1,22 @@
+// interface to the library's direct-summation evaluator for tiny problems.
+
+#ifndef DIRECT_H
+#define DIRECT_H
+
+#include "finufft.h"
+#include "defs.h"
+
+// # modes along x between exact reseeds of the wound phases (bounds rounding
+// error growth), and # NU pts per vectorized inner block.
+#define DIRECT_RESEED 32
+#define DIRECT_BLOCK  64
+
+// direct.cpp provides...
+void direct_type1(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *c,
+		  int iflag, BIGINT ms, BIGINT mt, BIGINT mu, CPX *fk,
+		  int modeord);
+void direct_type2(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *c,
+		  int iflag, BIGINT ms, BIGINT mt, BIGINT mu, CPX *fk,
+		  int modeord);
+
+#endif  // DIRECT_H
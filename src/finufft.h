@@ -44,6 +44,30 @@ typedef int64_t BIGINT;
 #endif
 
 
+// ------------------- the optional statistics output struct ----------------
+typedef struct {      // filled on successful return iff opts.stats non-NULL
+  double t_kerfser;   // times in secs: kernel Fourier series coeffs (types 1,2)
+  double t_fftwplan;  // FFTW plan (incl. first-call wisdom lookup)
+  double t_sort;      // spreader: bin-sort decision & sort of NU pts
+  double t_spread;    // spreader: spread (type 1) and/or interp (type 2)
+  double t_fft;       // FFT execution
+  double t_deconv;    // deconvolve (amplify) and copy out (in)
+  double t_prephase;  // type 3 only: rescale & prephase of NU sources
+  double t_kerFT;     // type 3 only: kernel FT at NU target freqs
+  double t_direct;    // direct summation, if chosen instead of the above
+  double t_total;     // whole call
+  double bytes_alloc; // total bytes of work arrays allocated during call
+  double bytes_kerprecomp; // plans only: bytes of stored kernel values
+  BIGINT nf1,nf2,nf3; // fine grid sizes (1 for unused dims, 0 if direct sum)
+  BIGINT nsubprobs;   // # spread subproblems (type 1), or interp chunks (type 2)
+  int did_sort;       // 1 if NU pts were bin-sorted, 0 if not
+  int nspread;        // kernel width w used
+  int nthreads;       // # threads available to the call
+  int fft_nthreads;   // plans only: # threads of the FFT (0 if direct sum)
+  double pts_per_sec; // throughput: total # NU pts (input+output) / t_total
+} nufft_stats;
+
+
 // ------------------- the user input options struct ------------------------
 typedef struct {      // Note: defaults in common/finufft_default_opts()
   int debug;          // 0: silent, 1: text basic timing output
@@ -55,20 +79,107 @@ typedef struct {      // Note: defaults in common/finufft_default_opts()
   int fftw;           // 0:FFTW_ESTIMATE, or 1:FFTW_MEASURE (slow plan but faster)
   int modeord;        // 0: CMCL-style increasing mode ordering (neg to pos), or
                       // 1: FFT-style mode ordering (affects type-1,2 only)
-  FLT upsampfac;      // upsampling ratio sigma, either 2.0 (standard) or 1.25 (small FFT)
+  FLT upsampfac;      // upsampling ratio sigma, 2.0 (standard), 1.25 (small FFT), other >1,
+                      // or 0.0 (auto: choose per call via cost model)
+  int nthreads;       // # threads for this call (0: OpenMP default); restored after
+  nufft_stats *stats; // NULL: no stats, else ptr to user struct to fill
+  int spread_bin_size_x; // spreader sort bin size in x, in fine grid pts
+  int spread_bin_size_y; //  "  y  (these three: 0 means autotune profile
+  int spread_bin_size_z; //  "  z   or built-in default)
+  BIGINT spread_max_sp_size; // max # NU pts per spread subproblem (0: auto)
+  int direct;         // types 1,2: 0: direct sum if cost model predicts faster,
+                      // 1: always direct sum, -1: never
+  int spread_kerprecomp; // plans only: 1: store kernel values at NU pts in
+                      // setpts (more RAM, faster execute), 0: don't
+  int hugepages;      // 1: advise transparent huge pages for large fine grids
+                      // (Linux), 0: don't
+  int nf_maxprime;    // largest prime factor of fine grid sizes (5, 7, 11, 13)
+  int nf_timed;       // 1: choose among nearby smooth fine grid sizes by
+                      // measured FFT time (cached), 0: smallest smooth size
+  FLT upsampfac_x;    // types 1,2 in 2D,3D: sigma for each dim (each >1), so
+  FLT upsampfac_y;    //  each gets its own kernel width; 0 means use
+  FLT upsampfac_z;    //  upsampfac (all 0 gives the isotropic default)
+  int modeset;        // types 1,2 in 2D,3D: 0 all modes in the ms*mt*mu box,
+                      // 1 only those in the inscribed disk/ball (ellipse),
+                      // 2 only k1 in [modelines[2l],modelines[2l+1]] on each
+                      // x-line l; unused modes are output as 0 or ignored
+  BIGINT *modelines;  // modeset=2: size 2*mt*mu, line l=(k2+mt/2)+mt*(k3+mu/2)
+  BIGINT xstride;     // types 1,2: FLTs between successive NU pt coords in
+                      // each of xj,yj,zj (1 separate arrays; 3 packed xyz
+                      // structs, passing xj,yj,zj = &p[0].x,&p[0].y,&p[0].z)
+  BIGINT cstride;     // types 1,2: complex entries btw successive cj (1)
+  BIGINT fkstride;    // types 1,2: complex entries btw successive fk (1)
 } nufft_opts;
 
 
+// ------------------- one problem in a batch of small transforms -----------
+typedef struct {      // see finufft_batch; fields unused in lower dims ignored
+  BIGINT M;           // # NU pts
+  FLT *x, *y, *z;     // NU pt coords, each size M
+  CPX *c;             // size-M strengths (type 1 input) or values (type 2 output)
+  BIGINT ms, mt, mu;  // # Fourier modes in x, y, z
+  CPX *fk;            // size ms*mt*mu modes (type 1 output, type 2 input)
+  int ier;            // output: error code for this problem (0 if success)
+} nufft_batch_prob;
+
+
+// ------------------- handle for repeated transforms (see finufft_plan.cpp) --
+typedef struct finufft_plan_s *finufft_plan;   // opaque
+
+
+// ------------------- handle for normal operator (see finufft_toeplitz.cpp) -
+typedef struct finufft_toeplitz_s *finufft_toeplitz;   // opaque
+
+
+// ------------------- handle for streaming type 1 (see finufft_accum.cpp) ---
+typedef struct finufft_accum_s *finufft_accum;   // opaque
+
+
+// --------------- completion handle for async execute (see finufft_async.cpp)
+typedef struct finufft_async_s *finufft_async;   // opaque
+
+
 // ------------------ library provides ------------------------------------
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 void finufft_default_opts(nufft_opts *o);
+int finufft_autotune(int dim, BIGINT N, BIGINT M, FLT eps, nufft_opts opts);
+int finufft_batch(int dim, int type, int nprob, nufft_batch_prob *probs,
+		  int iflag, FLT eps, nufft_opts opts);
+int finufft_makeplan(int type, int dim, BIGINT ms, BIGINT mt, BIGINT mu,
+		     int iflag, FLT eps, finufft_plan *plan, nufft_opts opts);
+int finufft_setpts(finufft_plan plan, BIGINT M, FLT *x, FLT *y, FLT *z);
+int finufft_updatepts(finufft_plan plan, FLT *x, FLT *y, FLT *z);
+int finufft_execute(finufft_plan plan, CPX *c, CPX *fk);
+int finufft_destroy(finufft_plan plan);
+int finufft_async_threads(int nworkers, int nthreads);
+int finufft_execute_async(finufft_plan plan, CPX *c, CPX *fk,
+			  finufft_async *h);
+int finufft_async_test(finufft_async h);
+int finufft_async_wait(finufft_async h);
+int finufft_toeplitz_make(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *w,
+			  int iflag, FLT eps, BIGINT ms, BIGINT mt, BIGINT mu,
+			  finufft_toeplitz *T, nufft_opts opts);
+int finufft_toeplitz_apply(finufft_toeplitz T, CPX *fk, CPX *gk);
+int finufft_toeplitz_destroy(finufft_toeplitz T);
+int finufft_accum_make(int dim, BIGINT ms, BIGINT mt, BIGINT mu, int iflag,
+		       FLT eps, finufft_accum *A, nufft_opts opts);
+int finufft_accum_add(finufft_accum A, BIGINT nj, FLT *xj, FLT *yj, FLT *zj,
+		      CPX *cj);
+int finufft_accum_finalize(finufft_accum A, CPX *fk);
+int finufft_accum_destroy(finufft_accum A);
 int finufft1d1(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
 	       CPX* fk, nufft_opts opts);
 int finufft1d2(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
 	       CPX* fk, nufft_opts opts);
+int finufft1d2grad(BIGINT nj,FLT* xj,CPX* cj,CPX* gxj,int iflag,FLT eps,
+		   BIGINT ms,CPX* fk,nufft_opts opts);
+int finufft1d1split(BIGINT nj,FLT* xj,FLT* cr,FLT* ci,int iflag,FLT eps,
+		    BIGINT ms,FLT* fr,FLT* fi,nufft_opts opts);
+int finufft1d2split(BIGINT nj,FLT* xj,FLT* cr,FLT* ci,int iflag,FLT eps,
+		    BIGINT ms,FLT* fr,FLT* fi,nufft_opts opts);
 int finufft1d3(BIGINT nj,FLT* x,CPX* c,int iflag,FLT eps,BIGINT nk, FLT* s, CPX* f, nufft_opts opts);
 
 int finufft2d1(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,FLT eps,
@@ -79,12 +190,30 @@ int finufft2d2(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,FLT eps,
 	       BIGINT ms, BIGINT mt, CPX* fk, nufft_opts opts);
 int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
                    FLT eps, BIGINT ms, BIGINT mt, CPX* fk, nufft_opts opts);
+int finufft2d2grad(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,CPX* gxj,CPX* gyj,
+		   int iflag,FLT eps,BIGINT ms,BIGINT mt,CPX* fk,
+		   nufft_opts opts);
+int finufft2d1split(BIGINT nj,FLT* xj,FLT* yj,FLT* cr,FLT* ci,int iflag,
+		    FLT eps,BIGINT ms,BIGINT mt,FLT* fr,FLT* fi,
+		    nufft_opts opts);
+int finufft2d2split(BIGINT nj,FLT* xj,FLT* yj,FLT* cr,FLT* ci,int iflag,
+		    FLT eps,BIGINT ms,BIGINT mt,FLT* fr,FLT* fi,
+		    nufft_opts opts);
 int finufft2d3(BIGINT nj,FLT* x,FLT *y,CPX* cj,int iflag,FLT eps,BIGINT nk, FLT* s, FLT* t, CPX* fk, nufft_opts opts);
 
 int finufft3d1(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,int iflag,FLT eps,
 	       BIGINT ms, BIGINT mt, BIGINT mu, CPX* fk, nufft_opts opts);
 int finufft3d2(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,int iflag,FLT eps,
 	       BIGINT ms, BIGINT mt, BIGINT mu, CPX* fk, nufft_opts opts);
+int finufft3d2grad(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,CPX* cj,CPX* gxj,
+		   CPX* gyj,CPX* gzj,int iflag,FLT eps,BIGINT ms,BIGINT mt,
+		   BIGINT mu,CPX* fk,nufft_opts opts);
+int finufft3d1split(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,FLT* cr,FLT* ci,
+		    int iflag,FLT eps,BIGINT ms,BIGINT mt,BIGINT mu,FLT* fr,
+		    FLT* fi,nufft_opts opts);
+int finufft3d2split(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,FLT* cr,FLT* ci,
+		    int iflag,FLT eps,BIGINT ms,BIGINT mt,BIGINT mu,FLT* fr,
+		    FLT* fi,nufft_opts opts);
 int finufft3d3(BIGINT nj,FLT* x,FLT *y,FLT *z, CPX* cj,int iflag,
 	       FLT eps,BIGINT nk,FLT* s, FLT* t, FLT *u,
 	       CPX* fk, nufft_opts opts);
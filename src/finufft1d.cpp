@@ -40,28 +40,43 @@ int finufft1d1(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
    Barnett 1/22/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(1,1,eps,nj,ms,1,1,opts);
   spread_opts spopts;
   int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
   if (ier_set) return ier_set;
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
   if (nf1>MAX_NF) {
     fprintf(stderr,"nf1=%.3g exceeds MAX_NF of %.3g\n",(double)nf1,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,1,1);
+  if (use_direct(1,nj,ms,1,1,nf1,1,1,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type1(1,nj,xj,NULL,NULL,cj,iflag,ms,1,1,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("1d1: direct sum (ms=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,1,1,nj);
 
   if (opts.debug) printf("1d1: ms=%lld nf1=%lld nj=%lld ...\n",(long long)ms,(long long)nf1,(long long)nj);
 
   CNTime timer; timer.start();
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();           // (these do nothing anyway when OMP=OFF)
-    FFTW_PLAN_TH(nth);
-  }
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1);    // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1,opts);    // working upsampled array
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_1D(nf1,fw,fw,fftsign, opts.fftw);  // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1;
+  int n[] = {int(nf1)};
+  FFTW_PLAN p = plan_fftw(1,n,1,fw,fftsign,opts.fftw,nth);  // in-place
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // Step 1: spread from irregular points to regular grid
   timer.restart();
@@ -75,24 +90,30 @@ int finufft1d1(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
   // Step 2:  Call FFT
   timer.restart();
   FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, timer.elapsedsec());
+  destroy_fftw(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, st.t_fft);
   //for (int j=0;j<nf1;++j) cout<<fw[j][0]<<"\t"<<fw[j][1]<<endl;
 
   // STEP 3a: get FT (series) of real symmetric spreading kernel
   timer.restart();
   FLT *fwkerhalf = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+1);
   onedim_fseries_kernel(nf1, fwkerhalf, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread, timer.elapsedsec());
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread, st.t_kerfser);
   //for (int j=0;j<=nf1/2;++j) cout<<fwkerhalf[j]<<endl;
 
   // Step 3b: Deconvolve by dividing coeffs by that of kernel; shuffle to output
   timer.restart();
-  deconvolveshuffle1d(1,1.0,fwkerhalf,ms,(FLT*)fk,nf1,fw,opts.modeord);  // prefac now 1
-  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", timer.elapsedsec());
+  deconvolveshuffle1d(1,1.0,fwkerhalf,ms,(FLT*)fk,nf1,fw,opts.modeord,NULL,
+		      opts.fkstride);  // prefac now 1
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", st.t_deconv);
   //for (int j=0;j<ms;++j) cout<<fk[j]<<endl;
 
   FFTW_FR(fw); free(fwkerhalf); if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -130,47 +151,67 @@ int finufft1d2(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
    Barnett 1/25/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(2,1,eps,nj,ms,1,1,opts);
   spread_opts spopts;
   int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
   if (ier_set) return ier_set;
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12((BIGINT)ms,opts,spopts,&nf1);
   if (nf1>MAX_NF) {
     fprintf(stderr,"nf1=%.3g exceeds MAX_NF of %.3g\n",(double)nf1,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,1,1);
+  if (use_direct(1,nj,ms,1,1,nf1,1,1,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type2(1,nj,xj,NULL,NULL,cj,iflag,ms,1,1,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("1d2: direct sum (ms=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,1,1,nj);
 
   if (opts.debug) printf("1d2: ms=%lld nf1=%lld nj=%lld ...\n",(long long)ms,(long long)nf1,(long long)nj); 
 
   // STEP 0: get FT of real symmetric spreading kernel
   CNTime timer; timer.start();
   FLT *fwkerhalf = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+1);
   onedim_fseries_kernel(nf1, fwkerhalf, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread, timer.elapsedsec());
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread, st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
   timer.restart();
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1);    // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1,opts);    // working upsampled array
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_1D(nf1,fw,fw,fftsign, opts.fftw); // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1;
+  int n[] = {int(nf1)};
+  FFTW_PLAN p = plan_fftw(1,n,1,fw,fftsign,opts.fftw,nth); // in-place
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // STEP 1: amplify Fourier coeffs fk and copy into upsampled array fw
   timer.restart();
-  deconvolveshuffle1d(2,1.0,fwkerhalf,ms,(FLT*)fk,nf1,fw,opts.modeord);
+  deconvolveshuffle1d(2,1.0,fwkerhalf,ms,(FLT*)fk,nf1,fw,opts.modeord,NULL,
+		      opts.fkstride);
   free(fwkerhalf);        // in 1d could help to free up
-  if (opts.debug) printf("amplify & copy in:\t %.3g s\n", timer.elapsedsec());
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("amplify & copy in:\t %.3g s\n", st.t_deconv);
   //cout<<"fw:\n"; for (int j=0;j<nf1;++j) cout<<fw[j][0]<<"\t"<<fw[j][1]<<endl;
 
   // Step 2:  Call FFT
   timer.restart();
   FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, timer.elapsedsec());
+  destroy_fftw(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, st.t_fft);
 
   // Step 3: unspread (interpolate) from regular to irregular target pts
   timer.restart();
@@ -182,6 +223,7 @@ int finufft1d2(BIGINT nj,FLT* xj,CPX* cj,int iflag,FLT eps,BIGINT ms,
   if (ier_spread>0) return ier_spread;
 
   FFTW_FR(fw); if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -223,23 +265,28 @@ int finufft1d3(BIGINT nj,FLT* xj,CPX* cj,int iflag, FLT eps, BIGINT nk, FLT* s,
    Barnett 2/7/17-6/9/17. 
  */
 {
-  spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
-  if (ier_set) return ier_set;
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
   BIGINT nf1;
   FLT X1,C1,S1,D1,h1,gam1;
-  cout << scientific << setprecision(15);  // for debug
 
   // pick x, s intervals & shifts, then apply these to xj, cj (twist iii)...
   CNTime timer; timer.start();
   arraywidcen(nj,xj,&X1,&C1);  // get half-width, center, containing {x_j}
   arraywidcen(nk,s,&S1,&D1);   // get half-width, center, containing {s_k}
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(3,1,eps,nj+nk,2*S1*X1/PI,1,1,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
   set_nhg_type3(S1,X1,opts,spopts,&nf1,&h1,&gam1);          // applies twist i)
   if (opts.debug) printf("1d3: X1=%.3g C1=%.3g S1=%.3g D1=%.3g gam1=%g nf1=%lld nj=%lld nk=%lld...\n",X1,C1,S1,D1,gam1,(long long)nf1,(long long)nj,(long long)nk);
   if (nf1>MAX_NF) {
     fprintf(stderr,"nf1=%.3g exceeds MAX_NF of %.3g\n",(double)nf1,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
+  nufft_stats st; start_stats(st,spopts,nf1,1,1);
+  set_spread_tuning(spopts,opts,nf1,1,1,nj);
   FLT* xpj = (FLT*)malloc(sizeof(FLT)*nj);
   for (BIGINT j=0;j<nj;++j)
     xpj[j] = (xj[j]-C1) / gam1;                          // rescale x_j
@@ -253,9 +300,11 @@ int finufft1d3(BIGINT nj,FLT* xj,CPX* cj,int iflag, FLT eps, BIGINT nk, FLT* s,
   } else
     for (BIGINT j=0;j<nj;++j)
       cpj[j] = cj[j];                                    // just copy over
+  st.t_prephase = timer.elapsedsec();
   
   // Step 1: spread from irregular sources to regular grid as in type 1
   CPX* fw = (CPX*)malloc(sizeof(CPX)*nf1);
+  st.bytes_alloc += sizeof(FLT)*nj + sizeof(CPX)*(nj+nf1);
   timer.restart();
   spopts.spread_direction = 1;
   FLT *dummy=NULL;
@@ -270,17 +319,24 @@ int finufft1d3(BIGINT nj,FLT* xj,CPX* cj,int iflag, FLT eps, BIGINT nk, FLT* s,
   FLT *sp = (FLT*)malloc(sizeof(FLT)*nk);     // rescaled targs s'_k
   for (BIGINT k=0;k<nk;++k)
     sp[k] = h1*gam1*(s[k]-D1);                         // so that |s'_k| < pi/R
-  int ier_t2 = finufft1d2(nk,sp,fk,iflag,eps,nf1,fw,opts);  // the meat
+  nufft_opts opts2 = opts; nufft_stats st2;
+  opts2.stats = &st2;                        // collect type-2 stats separately
+  opts2.modeset = 0; opts2.modelines = NULL;  // (all of type 3's own grid)
+  opts2.xstride = opts2.cstride = opts2.fkstride = 1;  // (own arrays)
+  int ier_t2 = finufft1d2(nk,sp,fk,iflag,eps,nf1,fw,opts2);  // the meat
   free(fw);
   if (opts.debug) printf("total type-2 (ier=%d):\t %.3g s\n",ier_t2,timer.elapsedsec());
   if (ier_t2) return ier_t2;
+  add_stats(st,st2);
   //for (int k=0;k<nk;++k) printf("fk[%d]=(%.3g,%.3g)\n",k,real(fk[k]),imag(fk[k]));
 
   // Step 3a: compute Fourier transform of scaled kernel at targets
   timer.restart();
   FLT *fkker = (FLT*)malloc(sizeof(FLT)*nk);
+  st.bytes_alloc += sizeof(FLT)*2*nk;
   onedim_nuft_kernel(nk, sp, fkker, spopts);           // fill fkker
-  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  st.t_kerFT = timer.elapsedsec();
+  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerFT);
   free(sp);
   // Step 3b: correct for spreading by dividing by the Fourier transform from 3a
   timer.restart();
@@ -292,8 +348,10 @@ int finufft1d3(BIGINT nj,FLT* xj,CPX* cj,int iflag, FLT eps, BIGINT nk, FLT* s,
 #pragma omp parallel for schedule(dynamic)
     for (BIGINT k=0;k<nk;++k)
       fk[k] *= (CPX)(1.0/fkker[k]);
+  st.t_deconv += timer.elapsedsec();
   if (opts.debug) printf("deconvolve:\t\t %.3g s\n",timer.elapsedsec());
 
   free(fkker); if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj+nk,opts);
   return 0;
 }
@@ -48,16 +48,36 @@ int finufft2d1(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,
    Written with FFTW style complex arrays. Barnett 2/1/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(1,2,eps,nj,ms,mt,1,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,2);
   if (ier_set) return ier_set;
+  std::vector<BIGINT> ext;              // restricted mode set, if any
+  int ier_ms = set_mode_lines(ext,2,ms,mt,1,opts);
+  if (ier_ms) return ier_ms;
+  const BIGINT *ml = ext.empty() ? NULL : &ext[0];
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12(mt,opts,spopts,&nf2);
+  BIGINT nf2; set_nf_type12(mt,opts,spread_dim_opts(spopts,1),&nf2);
   if (nf1*nf2>MAX_NF) {
     fprintf(stderr,"nf1*nf2=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,1);
+  if (!ml && use_direct(2,nj,ms,mt,1,nf1,nf2,1,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type1(2,nj,xj,yj,NULL,cj,iflag,ms,mt,1,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("2d1: direct sum (ms=%lld mt=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)mt,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,nf2,1,nj);
 
   if (opts.debug) printf("2d1: (ms,mt)=(%lld,%lld) (nf1,nf2)=(%lld,%lld) nj=%lld ...\n",(long long)ms,(long long)mt,(long long)nf1,(long long)nf2,(long long)nj);
 
@@ -65,20 +85,21 @@ int finufft2d1(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,
   CNTime timer; timer.start();
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+2);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
   timer.restart();
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2);  // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2,opts);  // working upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2;
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_2D(nf2,nf1,fw,fw,fftsign, opts.fftw);  // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  pruned_fft p;         // in-place; only the lines needed if ml is set
+  plan_pruned_fft(p,2,nf1,nf2,1,ms,mt,1,ml,fw,1,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // Step 1: spread from irregular points to regular grid
   timer.restart();
@@ -90,17 +111,21 @@ int finufft2d1(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,
 
   // Step 2:  Call FFT
   timer.restart();
-  FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, timer.elapsedsec());
+  exec_pruned_fft(p,fw);
+  destroy_pruned_fft(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, st.t_fft);
 
   // Step 3: Deconvolve by dividing coeffs by that of kernel; shuffle to output
   timer.restart();
-  deconvolveshuffle2d(1,1.0,fwkerhalf1,fwkerhalf2,ms,mt,(FLT*)fk,nf1,nf2,fw,opts.modeord);
-  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", timer.elapsedsec());
+  deconvolveshuffle2d(1,1.0,fwkerhalf1,fwkerhalf2,ms,mt,(FLT*)fk,nf1,nf2,fw,opts.modeord,ml,
+		      opts.fkstride);
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", st.t_deconv);
 
   FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -142,20 +167,25 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
   By Melody Shih, originally called "manysimul" (many_seq=0 opt). Jun 2018.
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
   if (ndata<1) {
     fprintf(stderr,"ndata should be at least 1 (ndata=%d)\n",ndata);
     return ERR_NDATA_NOTVALID;
   }
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(1,2,eps,nj,ms,mt,1,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,2);
   if (ier_set) return ier_set;
   BIGINT nf1; set_nf_type12((BIGINT)ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12((BIGINT)mt,opts,spopts,&nf2);
+  BIGINT nf2; set_nf_type12((BIGINT)mt,opts,spread_dim_opts(spopts,1),&nf2);
   if (nf1*nf2>MAX_NF) {
     fprintf(stderr,"nf1*nf2=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,1);
+  set_spread_tuning(spopts,opts,nf1,nf2,1,nj);
 
   if (opts.debug) printf("2d1many: ndata=%d (ms,mt)=(%lld,%lld) (nf1,nf2)=(%lld,%lld) nj=%lld ...\n", ndata,(long long)ms,(long long)mt,(long long)nf1,(long long)nf2,(long long)nj);
 
@@ -163,25 +193,24 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
   CNTime timer; timer.start();
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+2);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
 
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2*nth);  // nthreads copies of upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2*nth,opts);  // nthreads copies of upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2*nth;
   int fftsign = (iflag>=0) ? 1 : -1;
   const int n[] = {int(nf2), int(nf1)};
   // http://www.fftw.org/fftw3_doc/Row_002dmajor-Format.html#Row_002dmajor-Format
 
   timer.restart();
-  FFTW_PLAN p = FFTW_PLAN_MANY_DFT(2, n, nth, fw, n, 1, n[0]*n[1], fw, n, 1,
-                                   n[0]*n[1], fftsign, opts.fftw);
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  FFTW_PLAN p = plan_fftw(2,n,nth,fw,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   spopts.debug = opts.spread_debug;
   spopts.sort = opts.spread_sort;
@@ -189,12 +218,22 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
   spopts.pirange = 1; FLT *dummy=NULL;
   spopts.chkbnds = opts.chkbnds;
 
-  int ier_check = spreadcheck(nf1,nf2,1,nj,xj,yj,dummy,spopts);
-  if (ier_check>0) return ier_check;
-  
-  timer.restart();          // sort
+  timer.restart();          // check & sort, keeping sorted rescaled coords
   BIGINT *sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*nj);
-  int did_sort = spreadsort(sort_indices,nf1,nf2,1,nj,xj,yj,dummy,spopts);
+  FLT *kr = (FLT*)malloc(sizeof(FLT)*2*nj);
+  int did_sort;
+  int ier_check = spreadchecksort(sort_indices,kr,nf1,nf2,1,nj,xj,yj,dummy,
+				  spopts,did_sort);
+  if (ier_check>0) {
+    free(sort_indices); free(kr);
+    return ier_check;
+  }
+  st.bytes_alloc += (sizeof(BIGINT) + (did_sort ? 2*sizeof(FLT) : 0))*nj;
+  FLT *kx = xj, *ky = yj;     // coords to spread from: presorted if sorted
+  if (did_sort) {
+    spopts.kpresorted = 1;
+    kx = kr; ky = kr+nj;
+  }
   if (opts.debug) printf("[many] sort (did_sort=%d):\t %.3g s\n", did_sort,
 			 timer.elapsedsec());
   
@@ -202,10 +241,8 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
   // since can't return within omp block, need this array to catch errors...
   int *ier_spreads = (int*)calloc(nth,sizeof(int));
 
-#if _OPENMP
-  // make sure only single threaded spreadinterp used for each data...
-  MY_OMP_SET_NESTED(0);       // note this doesn't change omp_get_max_nthreads()
-#endif
+  spopts.stats = NULL;        // threads below would race on st; time here
+  spopts.nthreads = 1;        // single-threaded spreadinterp for each data
   
   for (int j = 0; j*nth < ndata; ++j) { // main loop over data blocks of size nth
     
@@ -217,7 +254,7 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
       CPX *cstart  = c + (i+j*nth)*nj;  // ptr to strengths this thread spreads
       FFTW_CPX *fwstart = fw + i*nf1*nf2;    // ptr to output grid for this thread
       int ier = spreadwithsortidx(sort_indices,nf1,nf2,1,(FLT*)fwstart,
-				  nj,xj,yj,dummy,(FLT*)cstart,spopts,did_sort);
+				  nj,kx,ky,dummy,(FLT*)cstart,spopts,did_sort);
       if (ier!=0)
 	ier_spreads[i] = ier;           // thank-you Melody for catching this
     }
@@ -242,16 +279,18 @@ int finufft2d1many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c,
     }
     time_deconv += timer.elapsedsec();
   }
+  st.t_spread = time_spread; st.t_fft = time_fft; st.t_deconv = time_deconv;
 
   if (opts.debug) printf("[many] spread:\t\t\t %.3g s\n", time_spread);
   if (opts.debug) printf("[many] fft (%d threads):\t\t %.3g s\n", nth, time_fft);
   if (opts.debug) printf("[many] deconvolve & copy out:\t %.3g s\n", time_deconv);
   //  if (opts.debug) printf("[many] total execute time (exclude fftw_plan, etc.) %.3g s\n", time_spread+time_fft+time_deconv);
 
-  FFTW_DE(p);
-  FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(sort_indices);
+  destroy_fftw(p);
+  FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(sort_indices); free(kr);
   free(ier_spreads);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),ndata*nj,opts);
   return 0;
 }
 
@@ -291,16 +330,36 @@ int finufft2d2(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,FLT eps,
    Written with FFTW style complex arrays. Barnett 2/1/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(2,2,eps,nj,ms,mt,1,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,2);
   if (ier_set) return ier_set;
+  std::vector<BIGINT> ext;              // restricted mode set, if any
+  int ier_ms = set_mode_lines(ext,2,ms,mt,1,opts);
+  if (ier_ms) return ier_ms;
+  const BIGINT *ml = ext.empty() ? NULL : &ext[0];
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12(mt,opts,spopts,&nf2);
+  BIGINT nf2; set_nf_type12(mt,opts,spread_dim_opts(spopts,1),&nf2);
   if (nf1*nf2>MAX_NF) {
     fprintf(stderr,"nf1*nf2=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,1);
+  if (!ml && use_direct(2,nj,ms,mt,1,nf1,nf2,1,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type2(2,nj,xj,yj,NULL,cj,iflag,ms,mt,1,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("2d2: direct sum (ms=%lld mt=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)mt,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,nf2,1,nj);
 
   if (opts.debug) printf("2d2: (ms,mt)=(%lld,%lld) (nf1,nf2)=(%lld,%lld) nj=%lld ...\n",(long long)ms,(long long)mt,(long long)nf1,(long long)nf2,(long long)nj);
 
@@ -308,32 +367,36 @@ int finufft2d2(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,FLT eps,
   CNTime timer; timer.start();
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+2);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
   timer.restart();
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2);  // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2,opts);  // working upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2;
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_2D(nf2,nf1,fw,fw,fftsign, opts.fftw);  // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  pruned_fft p;         // in-place; only the lines needed if ml is set
+  plan_pruned_fft(p,2,nf1,nf2,1,ms,mt,1,ml,fw,2,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // STEP 1: amplify Fourier coeffs fk and copy into upsampled array fw
   timer.restart();
-  deconvolveshuffle2d(2,1.0,fwkerhalf1,fwkerhalf2,ms,mt,(FLT*)fk,nf1,nf2,fw,opts.modeord);
-  if (opts.debug) printf("amplify & copy in:\t %.3g s\n",timer.elapsedsec());
+  deconvolveshuffle2d(2,1.0,fwkerhalf1,fwkerhalf2,ms,mt,(FLT*)fk,nf1,nf2,fw,opts.modeord,ml,
+		      opts.fkstride);
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("amplify & copy in:\t %.3g s\n",st.t_deconv);
   //cout<<"fw:\n"; for (int j=0;j<nf1*nf2;++j) cout<<fw[j][0]<<"\t"<<fw[j][1]<<endl;
 
   // Step 2:  Call FFT
   timer.restart();
-  FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,timer.elapsedsec());
+  exec_pruned_fft(p,fw);
+  destroy_pruned_fft(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,st.t_fft);
 
   // Step 3: unspread (interpolate) from regular to irregular target pts
   timer.restart();
@@ -345,6 +408,7 @@ int finufft2d2(BIGINT nj,FLT* xj,FLT *yj,CPX* cj,int iflag,FLT eps,
 
   FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -383,20 +447,25 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
   By Melody Shih, originally called "manysimul" (many_seq=0 opt). Jun 2018.
 */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
   if (ndata<1) {
     fprintf(stderr,"ndata should be at least 1 (ndata=%d)\n",ndata);
     return ERR_NDATA_NOTVALID;
   }
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(2,2,eps,nj,ms,mt,1,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,2);
   if (ier_set) return ier_set;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12(mt,opts,spopts,&nf2);
+  BIGINT nf2; set_nf_type12(mt,opts,spread_dim_opts(spopts,1),&nf2);
   if (nf1*nf2>MAX_NF) {
     fprintf(stderr,"nf1*nf2=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,1);
+  set_spread_tuning(spopts,opts,nf1,nf2,1,nj);
 
   if (opts.debug) printf("2d2: ndata=%d (ms,mt)=(%lld,%lld) (nf1,nf2)=(%lld,%lld) nj=%lld ...\n",
                          ndata,(long long)ms,(long long)mt,(long long)nf1,(long long)nf2,(long long)nj);
@@ -405,25 +474,24 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
   CNTime timer; timer.start();
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+2);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
 
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2*nth);  // nthreads copies of upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2*nth,opts);  // nthreads copies of upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2*nth;
   int fftsign = (iflag>=0) ? 1 : -1;
   const int n[] = {int(nf2), int(nf1)};
   // http://www.fftw.org/fftw3_doc/Row_002dmajor-Format.html#Row_002dmajor-Format
 
   timer.restart();
-  FFTW_PLAN p = FFTW_PLAN_MANY_DFT(2, n, nth, fw, n, 1, n[0]*n[1], fw, n, 1,
-                                   n[0]*n[1], fftsign, opts.fftw);
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  FFTW_PLAN p = plan_fftw(2,n,nth,fw,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   spopts.debug = opts.spread_debug;
   spopts.sort = opts.spread_sort;
@@ -431,12 +499,22 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
   spopts.pirange = 1; FLT *dummy=NULL;
   spopts.chkbnds = opts.chkbnds;
 
-  int ier_check = spreadcheck(nf1,nf2,1,nj,xj,yj,dummy,spopts);
-  if (ier_check>0) return ier_check;
-
-  timer.restart();            // sort
-  BIGINT* sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*nj);
-  int did_sort = spreadsort(sort_indices,nf1,nf2,1,nj,xj,yj,dummy,spopts);
+  timer.restart();          // check & sort, keeping sorted rescaled coords
+  BIGINT *sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*nj);
+  FLT *kr = (FLT*)malloc(sizeof(FLT)*2*nj);
+  int did_sort;
+  int ier_check = spreadchecksort(sort_indices,kr,nf1,nf2,1,nj,xj,yj,dummy,
+				  spopts,did_sort);
+  if (ier_check>0) {
+    free(sort_indices); free(kr);
+    return ier_check;
+  }
+  st.bytes_alloc += (sizeof(BIGINT) + (did_sort ? 2*sizeof(FLT) : 0))*nj;
+  FLT *kx = xj, *ky = yj;     // coords to spread from: presorted if sorted
+  if (did_sort) {
+    spopts.kpresorted = 1;
+    kx = kr; ky = kr+nj;
+  }
   if (opts.debug) printf("[many] sort (did_sort=%d):\t %.3g s\n", did_sort,
 			 timer.elapsedsec());
 
@@ -444,10 +522,8 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
   // since can't return within omp block, need this array to catch errors...
   int *ier_spreads = (int*)calloc(nth,sizeof(int));
 
-#if _OPENMP
-  // make sure only single threaded spreadinterp used for each data...
-  MY_OMP_SET_NESTED(0);       // note this doesn't change omp_get_max_nthreads()
-#endif
+  spopts.stats = NULL;        // threads below would race on st; time here
+  spopts.nthreads = 1;        // single-threaded spreadinterp for each data
   
   for (int j = 0; j*nth < ndata; ++j) {   // main loop over data blocks of size nth
 
@@ -475,7 +551,7 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
       FFTW_CPX *fwstart = fw + i*nf1*nf2;      // ptr to input values for thread
       CPX *cstart  = c + (i+j*nth)*nj;         // ptr to output vals for thread
       int ier = spreadwithsortidx(sort_indices,nf1,nf2,1,(FLT*)fwstart,nj,
-				  xj,yj,dummy,(FLT*)cstart,spopts,did_sort);
+				  kx,ky,dummy,(FLT*)cstart,spopts,did_sort);
       if (ier!=0)
 	ier_spreads[i] = ier;           // thank-you Melody for catching this
     }
@@ -484,14 +560,17 @@ int finufft2d2many(int ndata, BIGINT nj, FLT* xj, FLT *yj, CPX* c, int iflag,
       if (ier_spreads[i]!=0)
         return ier_spreads[i];              // tell us one of these errors
   }
+  st.t_spread = time_spread; st.t_fft = time_fft; st.t_deconv = time_deconv;
   if (opts.debug) printf("[many] amplify & copy in:\t %.3g s\n", time_deconv);
   if (opts.debug) printf("[many] fft (%d threads):\t\t %.3g s\n", nth, time_fft);
   if (opts.debug) printf("[many] unspread:\t\t %.3g s\n", time_spread);
   //if (opts.debug) printf("[many] total execute time (exclude fftw_plan, etc.) %.3g s\n",time_spread+time_fft+time_deconv);
 
-  FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(sort_indices);
+  destroy_fftw(p);
+  FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(sort_indices); free(kr);
   free(ier_spreads);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),ndata*nj,opts);
   return 0;
 }
 
@@ -534,12 +613,10 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
    Barnett 2/17/17, 6/12/17
  */
 {
-  spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
-  if (ier_set) return ier_set;
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
   BIGINT nf1,nf2;
   FLT X1,C1,S1,D1,h1,gam1,X2,C2,S2,D2,h2,gam2;
-  cout << scientific << setprecision(15);  // for debug
 
   // pick x, s intervals & shifts, then apply these to xj, cj (twist iii)...
   CNTime timer; timer.start();
@@ -547,6 +624,11 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
   arraywidcen(nk,s,&S1,&D1);   // {s_k}
   arraywidcen(nj,yj,&X2,&C2);  // {y_j}
   arraywidcen(nk,t,&S2,&D2);   // {t_k}
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(3,2,eps,nj+nk,2*S1*X1/PI,2*S2*X2/PI,1,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
   set_nhg_type3(S1,X1,opts,spopts,&nf1,&h1,&gam1);          // applies twist i)
   set_nhg_type3(S2,X2,opts,spopts,&nf2,&h2,&gam2);
   if (opts.debug) printf("2d3: X1=%.3g C1=%.3g S1=%.3g D1=%.3g gam1=%g nf1=%lld X2=%.3g C2=%.3g S2=%.3g D2=%.3g gam2=%g nf2=%lld nj=%lld nk=%lld...\n",X1,C1,S1,D1,gam1,(long long)nf1,X2,C2,S2,D2,gam2,(long long)nf2,(long long)nj,(long long)nk);
@@ -554,14 +636,18 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
     fprintf(stderr,"nf1*nf2=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,1);
+  set_spread_tuning(spopts,opts,nf1,nf2,1,nj);
   FLT* xpj = (FLT*)malloc(sizeof(FLT)*nj);
   FLT* ypj = (FLT*)malloc(sizeof(FLT)*nj);
+  st.bytes_alloc += sizeof(FLT)*2*nj;
   for (BIGINT j=0;j<nj;++j) {
     xpj[j] = (xj[j]-C1) / gam1;          // rescale x_j
     ypj[j] = (yj[j]-C2) / gam2;          // rescale y_j
   }
   CPX imasign = (iflag>=0) ? IMA : -IMA;
   CPX* cpj = (CPX*)malloc(sizeof(CPX)*nj);  // c'_j rephased src
+  st.bytes_alloc += sizeof(CPX)*nj;
   if (D1!=0.0 || D2!=0.0) {
 #pragma omp parallel for schedule(dynamic)               // since cexp slow
     for (BIGINT j=0;j<nj;++j)
@@ -570,9 +656,11 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
   } else
     for (BIGINT j=0;j<nj;++j)
       cpj[j] = cj[j];                                    // just copy over
+  st.t_prephase = timer.elapsedsec();
 
   // Step 1: spread from irregular sources to regular grid as in type 1
   CPX* fw = (CPX*)malloc(sizeof(CPX)*nf1*nf2);
+  st.bytes_alloc += sizeof(CPX)*nf1*nf2;
   timer.restart();
   spopts.spread_direction = 1;
   FLT *dummy=NULL;
@@ -585,23 +673,31 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
   timer.restart();
   FLT *sp = (FLT*)malloc(sizeof(FLT)*nk);     // rescaled targs s'_k
   FLT *tp = (FLT*)malloc(sizeof(FLT)*nk);     // t'_k
+  st.bytes_alloc += sizeof(FLT)*2*nk;
   for (BIGINT k=0;k<nk;++k) {
     sp[k] = h1*gam1*(s[k]-D1);                         // so that |s'_k| < pi/R
     tp[k] = h2*gam2*(t[k]-D2);                         // so that |t'_k| < pi/R
   }
-  int ier_t2 = finufft2d2(nk,sp,tp,fk,iflag,eps,nf1,nf2,fw,opts);
+  nufft_opts opts2 = opts; nufft_stats st2;
+  opts2.stats = &st2;                        // collect type-2 stats separately
+  opts2.modeset = 0; opts2.modelines = NULL;  // (all of type 3's own grid)
+  opts2.xstride = opts2.cstride = opts2.fkstride = 1;  // (own arrays)
+  int ier_t2 = finufft2d2(nk,sp,tp,fk,iflag,eps,nf1,nf2,fw,opts2);
   free(fw);
   if (opts.debug) printf("total type-2 (ier=%d):\t %.3g s\n",ier_t2,timer.elapsedsec());
   if (ier_t2) exit(ier_t2);
+  add_stats(st,st2);
 
   // Step 3a: compute Fourier transform of scaled kernel at targets
   timer.restart();
   FLT *fkker1 = (FLT*)malloc(sizeof(FLT)*nk);
   FLT *fkker2 = (FLT*)malloc(sizeof(FLT)*nk);
+  st.bytes_alloc += sizeof(FLT)*2*nk;
   // exploit that Fourier transform separates because kernel built separable...
   onedim_nuft_kernel(nk, sp, fkker1, spopts);           // fill fkker1
   onedim_nuft_kernel(nk, tp, fkker2, spopts);           // fill fkker2
-  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  st.t_kerFT = timer.elapsedsec();
+  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerFT);
   free(sp); free(tp);
   // Step 3b: correct for spreading by dividing by the Fourier transform from 3a
   timer.restart();
@@ -614,8 +710,10 @@ int finufft2d3(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,int iflag, FLT eps, BIGINT nk,
 #pragma omp parallel for schedule(dynamic)
     for (BIGINT k=0;k<nk;++k)         // also phases to account for C1,C2 shift
       fk[k] *= (CPX)(1.0/(fkker1[k]*fkker2[k]));
+  st.t_deconv += timer.elapsedsec();
   if (opts.debug) printf("deconvolve:\t\t %.3g s\n",timer.elapsedsec());
 
   free(fkker1); free(fkker2); if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj+nk,opts);
   return 0;
 }
@@ -49,17 +49,37 @@ int finufft3d1(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,int iflag,
    Written with FFTW style complex arrays. Barnett 2/2/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(1,3,eps,nj,ms,mt,mu,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,3);
   if (ier_set) return ier_set;
+  std::vector<BIGINT> ext;              // restricted mode set, if any
+  int ier_ms = set_mode_lines(ext,3,ms,mt,mu,opts);
+  if (ier_ms) return ier_ms;
+  const BIGINT *ml = ext.empty() ? NULL : &ext[0];
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12(mt,opts,spopts,&nf2);
-  BIGINT nf3; set_nf_type12(mu,opts,spopts,&nf3);
+  BIGINT nf2; set_nf_type12(mt,opts,spread_dim_opts(spopts,1),&nf2);
+  BIGINT nf3; set_nf_type12(mu,opts,spread_dim_opts(spopts,2),&nf3);
   if (nf1*nf2*nf3>MAX_NF) {
     fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2*nf3,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,nf3);
+  if (!ml && use_direct(3,nj,ms,mt,mu,nf1,nf2,nf3,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type1(3,nj,xj,yj,zj,cj,iflag,ms,mt,mu,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("3d1: direct sum (ms=%lld mt=%lld mu=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)mt,(long long)mu,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,nf2,nf3,nj);
 
   if (opts.debug) printf("3d1: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld) nj=%lld ...\n",(long long)ms,(long long)mt,(long long)mu,(long long)nf1,(long long)nf2,(long long)nf3,(long long)nj);
 
@@ -68,22 +88,22 @@ int finufft3d1(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,int iflag,
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
   FLT *fwkerhalf3 = (FLT*)malloc(sizeof(FLT)*(nf3/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+nf3/2+3);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  onedim_fseries_kernel(nf3, fwkerhalf3, spopts);
-  double t=timer.elapsedsec();
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,t);
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  onedim_fseries_kernel(nf3, fwkerhalf3, spread_dim_opts(spopts,2));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
   timer.restart();
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2*nf3);  // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2*nf3,opts);  // working upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2*nf3;
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_3D(nf3,nf2,nf1,fw,fw,fftsign, opts.fftw);  // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  pruned_fft p;         // in-place; only the lines needed if ml is set
+  plan_pruned_fft(p,3,nf1,nf2,nf3,ms,mt,mu,ml,fw,1,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // Step 1: spread from irregular points to regular grid
   timer.restart();
@@ -94,18 +114,22 @@ int finufft3d1(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,int iflag,
 
   // Step 2:  Call FFT
   timer.restart();
-  FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, timer.elapsedsec());
+  exec_pruned_fft(p,fw);
+  destroy_pruned_fft(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n", nth, st.t_fft);
 
   // Step 3: Deconvolve by dividing coeffs by that of kernel; shuffle to output
   timer.restart();
-  deconvolveshuffle3d(1,1.0,fwkerhalf1,fwkerhalf2,fwkerhalf3,ms,mt,mu,(FLT*)fk,nf1,nf2,nf3,fw,opts.modeord);
-  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", timer.elapsedsec());
+  deconvolveshuffle3d(1,1.0,fwkerhalf1,fwkerhalf2,fwkerhalf3,ms,mt,mu,(FLT*)fk,nf1,nf2,nf3,fw,opts.modeord,ml,
+		      opts.fkstride);
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n", st.t_deconv);
 
   FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(fwkerhalf3);
   //fftw_cleanup();    // useful so doesn't show in valgrind
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -148,17 +172,37 @@ int finufft3d2(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,
    Written with FFTW style complex arrays. Barnett 2/2/17
  */
 {
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(2,3,eps,nj,ms,mt,mu,opts);
   spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,3);
   if (ier_set) return ier_set;
+  std::vector<BIGINT> ext;              // restricted mode set, if any
+  int ier_ms = set_mode_lines(ext,3,ms,mt,mu,opts);
+  if (ier_ms) return ier_ms;
+  const BIGINT *ml = ext.empty() ? NULL : &ext[0];
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
   BIGINT nf1; set_nf_type12(ms,opts,spopts,&nf1);
-  BIGINT nf2; set_nf_type12(mt,opts,spopts,&nf2);
-  BIGINT nf3; set_nf_type12(mu,opts,spopts,&nf3);
+  BIGINT nf2; set_nf_type12(mt,opts,spread_dim_opts(spopts,1),&nf2);
+  BIGINT nf3; set_nf_type12(mu,opts,spread_dim_opts(spopts,2),&nf3);
   if (nf1*nf2*nf3>MAX_NF) {
     fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2*nf3,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
-  cout << scientific << setprecision(15);  // for debug
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,nf3);
+  if (!ml && use_direct(3,nj,ms,mt,mu,nf1,nf2,nf3,spopts,opts)) {  // tiny: direct sum
+    CNTime timer; timer.start();
+    direct_type2(3,nj,xj,yj,zj,cj,iflag,ms,mt,mu,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("3d2: direct sum (ms=%lld mt=%lld mu=%lld nj=%lld):\t %.3g s\n",(long long)ms,(long long)mt,(long long)mu,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf1,nf2,nf3,nj);
 
   if (opts.debug) printf("3d2: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld) nj=%lld ...\n",(long long)ms,(long long)mt,(long long)mu,(long long)nf1,(long long)nf2,(long long)nf3,(long long)nj);
   
@@ -167,32 +211,36 @@ int finufft3d2(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,
   FLT *fwkerhalf1 = (FLT*)malloc(sizeof(FLT)*(nf1/2+1));
   FLT *fwkerhalf2 = (FLT*)malloc(sizeof(FLT)*(nf2/2+1));
   FLT *fwkerhalf3 = (FLT*)malloc(sizeof(FLT)*(nf3/2+1));
+  st.bytes_alloc += sizeof(FLT)*(nf1/2+nf2/2+nf3/2+3);
   onedim_fseries_kernel(nf1, fwkerhalf1, spopts);
-  onedim_fseries_kernel(nf2, fwkerhalf2, spopts);
-  onedim_fseries_kernel(nf3, fwkerhalf3, spopts);
-  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  onedim_fseries_kernel(nf2, fwkerhalf2, spread_dim_opts(spopts,1));
+  onedim_fseries_kernel(nf3, fwkerhalf3, spread_dim_opts(spopts,2));
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerfser);
 
   int nth = MY_OMP_GET_MAX_THREADS();
-  if (nth>1) {             // set up multithreaded fftw stuff...
-    FFTW_INIT();
-    FFTW_PLAN_TH(nth);
-  }
   timer.restart();
-  FFTW_CPX *fw = FFTW_ALLOC_CPX(nf1*nf2*nf3); // working upsampled array
+  FFTW_CPX *fw = alloc_fine_grid(nf1*nf2*nf3,opts); // working upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nf1*nf2*nf3;
   int fftsign = (iflag>=0) ? 1 : -1;
-  FFTW_PLAN p = FFTW_PLAN_3D(nf3,nf2,nf1,fw,fw,fftsign, opts.fftw);  // in-place
-  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,timer.elapsedsec());
+  pruned_fft p;         // in-place; only the lines needed if ml is set
+  plan_pruned_fft(p,3,nf1,nf2,nf3,ms,mt,mu,ml,fw,2,fftsign,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
 
   // STEP 1: amplify Fourier coeffs fk and copy into upsampled array fw
   timer.restart();
-  deconvolveshuffle3d(2,1.0,fwkerhalf1,fwkerhalf2,fwkerhalf3,ms,mt,mu,(FLT*)fk,nf1,nf2,nf3,fw,opts.modeord);
-  if (opts.debug) printf("amplify & copy in:\t %.3g s\n",timer.elapsedsec());
+  deconvolveshuffle3d(2,1.0,fwkerhalf1,fwkerhalf2,fwkerhalf3,ms,mt,mu,(FLT*)fk,nf1,nf2,nf3,fw,opts.modeord,ml,
+		      opts.fkstride);
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("amplify & copy in:\t %.3g s\n",st.t_deconv);
 
   // Step 2:  Call FFT
   timer.restart();
-  FFTW_EX(p);
-  FFTW_DE(p);
-  if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,timer.elapsedsec());
+  exec_pruned_fft(p,fw);
+  destroy_pruned_fft(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,st.t_fft);
 
   // Step 3: unspread (interpolate) from regular to irregular target pts
   timer.restart();
@@ -203,6 +251,7 @@ int finufft3d2(BIGINT nj,FLT* xj,FLT *yj,FLT *zj,CPX* cj,
 
   FFTW_FR(fw); free(fwkerhalf1); free(fwkerhalf2); free(fwkerhalf3);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
   return 0;
 }
 
@@ -247,12 +296,10 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
    Barnett 2/17/17, 6/12/17
  */
 {
-  spread_opts spopts;
-  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
-  if (ier_set) return ier_set;
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
   BIGINT nf1,nf2,nf3;
   FLT X1,C1,S1,D1,h1,gam1,X2,C2,S2,D2,h2,gam2,X3,C3,S3,D3,h3,gam3;
-  cout << scientific << setprecision(15);  // for debug
 
   // pick x, s intervals & shifts, then apply these to xj, cj (twist iii)...
   CNTime timer; timer.start();
@@ -262,6 +309,11 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
   arraywidcen(nk,t,&S2,&D2);   // {t_k}
   arraywidcen(nj,zj,&X3,&C3);  // {z_j}
   arraywidcen(nk,u,&S3,&D3);   // {u_k}
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(3,3,eps,nj+nk,2*S1*X1/PI,2*S2*X2/PI,2*S3*X3/PI,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
   set_nhg_type3(S1,X1,opts,spopts,&nf1,&h1,&gam1);          // applies twist i)
   set_nhg_type3(S2,X2,opts,spopts,&nf2,&h2,&gam2);
   set_nhg_type3(S3,X3,opts,spopts,&nf3,&h3,&gam3);
@@ -272,9 +324,12 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
     fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nf1*nf2*nf3,(double)MAX_NF);
     return ERR_MAXNALLOC;
   }
+  nufft_stats st; start_stats(st,spopts,nf1,nf2,nf3);
+  set_spread_tuning(spopts,opts,nf1,nf2,nf3,nj);
   FLT* xpj = (FLT*)malloc(sizeof(FLT)*nj);
   FLT* ypj = (FLT*)malloc(sizeof(FLT)*nj);
   FLT* zpj = (FLT*)malloc(sizeof(FLT)*nj);
+  st.bytes_alloc += sizeof(FLT)*3*nj;
   for (BIGINT j=0;j<nj;++j) {
     xpj[j] = (xj[j]-C1) / gam1;          // rescale x_j
     ypj[j] = (yj[j]-C2) / gam2;          // rescale y_j
@@ -282,6 +337,7 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
   }
   CPX imasign = (iflag>=0) ? IMA : -IMA;
   CPX* cpj = (CPX*)malloc(sizeof(CPX)*nj);  // c'_j rephased src
+  st.bytes_alloc += sizeof(CPX)*nj;
   if (D1!=0.0 || D2!=0.0 || D3!=0.0) {
 #pragma omp parallel for schedule(dynamic)                // since cexp slow
     for (BIGINT j=0;j<nj;++j)
@@ -290,9 +346,11 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
   } else
     for (BIGINT j=0;j<nj;++j)
       cpj[j] = cj[j];                                    // just copy over
+  st.t_prephase = timer.elapsedsec();
   
   // Step 1: spread from irregular sources to regular grid as in type 1
   CPX* fw = (CPX*)malloc(sizeof(CPX)*nf1*nf2*nf3);
+  st.bytes_alloc += sizeof(CPX)*nf1*nf2*nf3;
   timer.restart();
   spopts.spread_direction = 1;
   int ier_spread = spreadinterp(nf1,nf2,nf3,(FLT*)fw,nj,xpj,ypj,zpj,(FLT*)cpj,spopts);
@@ -305,26 +363,34 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
   FLT *sp = (FLT*)malloc(sizeof(FLT)*nk);     // rescaled targs s'_k
   FLT *tp = (FLT*)malloc(sizeof(FLT)*nk);     // t'_k
   FLT *up = (FLT*)malloc(sizeof(FLT)*nk);     // u'_k
+  st.bytes_alloc += sizeof(FLT)*3*nk;
   for (BIGINT k=0;k<nk;++k) {
     sp[k] = h1*gam1*(s[k]-D1);                         // so that |s'_k| < pi/R
     tp[k] = h2*gam2*(t[k]-D2);                         // so that |t'_k| < pi/R
     up[k] = h3*gam3*(u[k]-D3);                         // so that |u'_k| < pi/R
   }
-  int ier_t2 = finufft3d2(nk,sp,tp,up,fk,iflag,eps,nf1,nf2,nf3,fw,opts);
+  nufft_opts opts2 = opts; nufft_stats st2;
+  opts2.stats = &st2;                        // collect type-2 stats separately
+  opts2.modeset = 0; opts2.modelines = NULL;  // (all of type 3's own grid)
+  opts2.xstride = opts2.cstride = opts2.fkstride = 1;  // (own arrays)
+  int ier_t2 = finufft3d2(nk,sp,tp,up,fk,iflag,eps,nf1,nf2,nf3,fw,opts2);
   free(fw);
   if (opts.debug) printf("total type-2 (ier=%d):\t %.3g s\n",ier_t2,timer.elapsedsec());
   if (ier_t2>0) exit(ier_t2);
+  add_stats(st,st2);
 
   // Step 3a: compute Fourier transform of scaled kernel at targets
   timer.restart();
   FLT *fkker1 = (FLT*)malloc(sizeof(FLT)*nk);
   FLT *fkker2 = (FLT*)malloc(sizeof(FLT)*nk);
   FLT *fkker3 = (FLT*)malloc(sizeof(FLT)*nk);
+  st.bytes_alloc += sizeof(FLT)*3*nk;
   // exploit that Fourier transform separates because kernel built separable...
   onedim_nuft_kernel(nk, sp, fkker1, spopts);           // fill fkker1
   onedim_nuft_kernel(nk, tp, fkker2, spopts);           // etc
   onedim_nuft_kernel(nk, up, fkker3, spopts);
-  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,timer.elapsedsec());
+  st.t_kerFT = timer.elapsedsec();
+  if (opts.debug) printf("kernel FT (ns=%d):\t %.3g s\n", spopts.nspread,st.t_kerFT);
   free(sp); free(tp); free(up);
   // Step 3b: correct for spreading by dividing by the Fourier transform from 3a
   timer.restart();
@@ -337,9 +403,11 @@ int finufft3d3(BIGINT nj,FLT* xj,FLT* yj,FLT *zj, CPX* cj,
 #pragma omp parallel for schedule(dynamic)
     for (BIGINT k=0;k<nk;++k)
       fk[k] *= (CPX)(1.0/(fkker1[k]*fkker2[k]*fkker3[k]));
+  st.t_deconv += timer.elapsedsec();
   if (opts.debug) printf("deconvolve:\t\t %.3g s\n",timer.elapsedsec());
 
   free(fkker1); free(fkker2); free(fkker3);
   if (opts.debug) printf("freed\n");
+  finish_stats(st,totaltimer.elapsedsec(),nj+nk,opts);
   return 0;
 }
@@ -0,0 +1,206 @@
+// Streaming type-1 NUFFT: NU pts and strengths arriving in chunks are spread
+// as they arrive into a persistent fine grid (finufft_accum_add), and the FFT
+// and deconvolve are done once at the end (finufft_accum_finalize), giving
+// the same result as one finufft?d1 call on all the pts. Memory is the fine
+// grid plus the sort indices of one chunk, whatever the total # pts.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct finufft_accum_s {  // (opaque to the user; see finufft.h)
+  int dim;
+  BIGINT ms, mt, mu;      // # modes in each dim (1 for unused dims)
+  BIGINT nf1, nf2, nf3;   // fine grid sizes (1 for unused dims)
+  nufft_opts opts;        // copy of user's opts (upsampfac resolved)
+  spread_opts spopts;     // spreader opts (accumulating), tuned per chunk
+  FLT *fwkerhalf[3];      // kernel Fourier series per dim (NULL if unused)
+  FFTW_CPX *fw;           // fine grid, holding the sum of spread chunks
+  FFTW_PLAN fftwplan;     // in-place on fw
+  BIGINT npts;            // # NU pts spread since make or last finalize
+};
+
+static void zero_grid(finufft_accum A)
+{
+  FLT *f = (FLT*)A->fw;
+  BIGINT n = 2*A->nf1*A->nf2*A->nf3;
+#pragma omp parallel for schedule(static)
+  for (BIGINT i=0; i<n; ++i) f[i] = 0.0;
+  A->npts = 0;
+}
+
+int finufft_accum_make(int dim, BIGINT ms, BIGINT mt, BIGINT mu, int iflag,
+		       FLT eps, finufft_accum *A, nufft_opts opts)
+/* Creates a handle accumulating a dim-dimensional type-1 NUFFT with
+   ms,mt,mu modes (as in finufft?d1; mt, mu ignored in lower dims), sign iflag,
+   tolerance eps and options opts, writing it to *A. This makes the kernel
+   Fourier series, the (zeroed) fine grid and the FFTW plan. upsampfac=0
+   chooses sigma as if the total # NU pts equalled the # modes. Then call
+   finufft_accum_add for each chunk of NU pts, and finufft_accum_finalize to
+   get the modes; the handle may then accumulate another transform, until
+   finufft_accum_destroy. A handle holds one fine grid, so may be used by only
+   one thread at a time. If opts.stats is set, it is filled by this and each
+   later call on the handle with that call's timings.
+   Returns 0 on success, ERR_PLAN_ARGS if dim or the mode counts are invalid,
+   else as finufft?d1 (see ../docs/usage.rst); *A is then NULL.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  *A = NULL;
+  if (dim<1 || dim>3 || ms<0 || (dim>1 && mt<0) || (dim>2 && mu<0)) {
+    fprintf(stderr,"finufft_accum_make: invalid dim=%d or mode counts\n",dim);
+    return ERR_PLAN_ARGS;
+  }
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (dim<2) mt = 1;
+  if (dim<3) mu = 1;
+  if (opts.upsampfac==0.0)              // auto: assume M is of order N
+    opts.upsampfac = choose_upsampfac(1,dim,eps,ms*mt*mu,ms,mt,mu,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
+  BIGINT m[3] = {ms,mt,mu}, nf[3] = {1,1,1};
+  for (int d=0; d<dim; ++d)
+    set_nf_type12(m[d],opts,spopts,&nf[d]);
+  BIGINT nft = nf[0]*nf[1]*nf[2];
+  if (nft>MAX_NF) {
+    fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nft,(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  nufft_stats st; start_stats(st,spopts,nf[0],nf[1],nf[2]);
+  if (opts.debug) printf("accum_make %dd: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld)\n",dim,(long long)ms,(long long)mt,(long long)mu,(long long)nf[0],(long long)nf[1],(long long)nf[2]);
+
+  finufft_accum a = (finufft_accum)malloc(sizeof(struct finufft_accum_s));
+  a->dim = dim;
+  a->ms = ms; a->mt = mt; a->mu = mu;
+  a->nf1 = nf[0]; a->nf2 = nf[1]; a->nf3 = nf[2];
+  a->opts = opts;
+  a->spopts = spopts;
+  a->spopts.spread_direction = 1;
+  a->spopts.accumulate = 1;             // add each chunk into the grid
+
+  CNTime timer; timer.start();
+  for (int d=0; d<3; ++d) {
+    a->fwkerhalf[d] = NULL;
+    if (d<dim) {
+      a->fwkerhalf[d] = (FLT*)malloc(sizeof(FLT)*(nf[d]/2+1));
+      st.bytes_alloc += sizeof(FLT)*(nf[d]/2+1);
+      onedim_fseries_kernel(nf[d],a->fwkerhalf[d],spopts);
+    }
+  }
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n",spopts.nspread,st.t_kerfser);
+
+  timer.restart();
+  a->fw = alloc_fine_grid(nft,opts);
+  st.bytes_alloc += sizeof(FFTW_CPX)*nft;
+  int fftsign = (iflag>=0) ? 1 : -1;
+  int n[3];
+  for (int d=0; d<dim; ++d) n[d] = (int)nf[dim-1-d];  // (row-major)
+  a->fftwplan = plan_fftw(dim,n,1,a->fw,fftsign,opts.fftw,
+			  MY_OMP_GET_MAX_THREADS());
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
+  zero_grid(a);                         // (after planning, which may use fw)
+
+  *A = a;
+  finish_stats(st,totaltimer.elapsedsec(),0,opts);
+  return 0;
+}
+
+int finufft_accum_add(finufft_accum A, BIGINT nj, FLT *xj, FLT *yj, FLT *zj,
+		      CPX *cj)
+/* Spreads a chunk of nj NU pts xj,yj,zj (as in finufft?d1; yj, zj ignored in
+   lower dims) with strengths cj (size nj) into the handle's fine grid, adding
+   to the chunks spread since make or the last finalize. Checks bounds if
+   opts.chkbnds, and bin-sorts the chunk, needing nj*sizeof(BIGINT) bytes
+   which are freed on return. The arrays may be reused once this returns.
+   If the handle's opts.stats is set it is filled with this call's timings.
+   Returns 0 on success, ERR_PLAN_ARGS if nj<0, else as finufft?d1 (see
+   ../docs/usage.rst), in which case nothing is added.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = A->opts;
+  thread_scope thrs(opts.nthreads);
+  int dim = A->dim;
+  if (nj<0) {
+    fprintf(stderr,"finufft_accum_add: invalid nj=%lld\n",(long long)nj);
+    return ERR_PLAN_ARGS;
+  }
+  spread_opts spopts = A->spopts;
+  set_spread_tuning(spopts,opts,A->nf1,A->nf2,A->nf3,nj);
+  nufft_stats st; start_stats(st,spopts,A->nf1,A->nf2,A->nf3);
+  if (opts.debug) printf("accum_add %dd: nj=%lld (%lld so far)\n",dim,(long long)nj,(long long)A->npts);
+  BIGINT n2 = (dim>1) ? A->nf2 : 1, n3 = (dim>2) ? A->nf3 : 1;
+  if (dim<2) yj = NULL;
+  if (dim<3) zj = NULL;
+  BIGINT *sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*nj);
+  int did_sort;
+  int ier = spreadchecksort(sort_indices,NULL,A->nf1,n2,n3,nj,xj,yj,zj,spopts,
+			    did_sort);
+  if (ier) {
+    free(sort_indices);
+    return ier;
+  }
+  st.bytes_alloc += sizeof(BIGINT)*nj;
+  CNTime timer; timer.start();
+  ier = spreadwithsortidx(sort_indices,A->nf1,n2,n3,(FLT*)A->fw,nj,xj,yj,zj,
+			  (FLT*)cj,spopts,did_sort);
+  if (opts.debug) printf("spread (ier=%d):\t\t %.3g s\n",ier,timer.elapsedsec());
+  free(sort_indices);
+  if (ier) return ier;
+  A->npts += nj;
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+  return 0;
+}
+
+int finufft_accum_finalize(finufft_accum A, CPX *fk)
+/* Writes to fk (size ms*mt*mu, ordered as given by opts.modeord) the type-1
+   NUFFT of all the chunks added since make or the last finalize, by doing the
+   FFT and deconvolve of the fine grid, which is then zeroed so that the
+   handle can accumulate a new transform. If the handle's opts.stats is set it
+   is filled with this call's timings (npts is the total # pts).
+   Returns 0.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = A->opts;
+  thread_scope thrs(opts.nthreads);
+  int dim = A->dim;
+  BIGINT nf1 = A->nf1, nf2 = A->nf2, nf3 = A->nf3;
+  nufft_stats st; start_stats(st,A->spopts,nf1,nf2,nf3);
+  FFTW_CPX *fw = A->fw;
+  CNTime timer; timer.start();
+  FFTW_EX(A->fftwplan);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("accum_finalize %dd: %lld pts\nfft (%d threads):\t %.3g s\n",dim,(long long)A->npts,MY_OMP_GET_MAX_THREADS(),st.t_fft);
+  timer.restart();
+  if (dim==1)
+    deconvolveshuffle1d(1,1.0,A->fwkerhalf[0],A->ms,(FLT*)fk,nf1,fw,opts.modeord);
+  else if (dim==2)
+    deconvolveshuffle2d(1,1.0,A->fwkerhalf[0],A->fwkerhalf[1],A->ms,A->mt,
+			(FLT*)fk,nf1,nf2,fw,opts.modeord);
+  else
+    deconvolveshuffle3d(1,1.0,A->fwkerhalf[0],A->fwkerhalf[1],A->fwkerhalf[2],
+			A->ms,A->mt,A->mu,(FLT*)fk,nf1,nf2,nf3,fw,opts.modeord);
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n",st.t_deconv);
+  BIGINT npts = A->npts;
+  zero_grid(A);
+  finish_stats(st,totaltimer.elapsedsec(),npts,opts);
+  return 0;
+}
+
+int finufft_accum_destroy(finufft_accum A)
+// Frees all memory held by the handle A (which may be NULL). Returns 0.
+{
+  if (!A) return 0;
+  destroy_fftw(A->fftwplan);
+  FFTW_FR(A->fw);
+  for (int d=0; d<3; ++d) free(A->fwkerhalf[d]);
+  free(A);
+  return 0;
+}
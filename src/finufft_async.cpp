@@ -0,0 +1,191 @@
+// Asynchronous execution of plans: finufft_execute_async queues a
+// finufft_execute on an internal pool of worker threads and returns at once
+// with a completion handle, which can be polled (finufft_async_test) or
+// waited on (finufft_async_wait), so that the caller can overlap transforms
+// with I/O or other work. The pool has its own thread budget, split between
+// its workers as the OpenMP threads each uses for a transform, so it need not
+// oversubscribe the caller's cores. Since a plan holds one fine grid, jobs on
+// the same plan are run one at a time, in the order queued; jobs on different
+// plans run concurrently, one per worker. Every handle must be waited on
+// before the program exits: at exit the pool is joined without starting any
+// more jobs.
+
+#include "finufft.h"
+#include "utils.h"
+#include <stdio.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct finufft_async_s {  // (opaque to the user; see finufft.h)
+  finufft_plan plan;
+  CPX *c, *fk;            // user's arrays for finufft_execute
+  int ier;                // its returned value, once done
+  int done;
+};
+
+struct async_pool {       // the one pool; all fields guarded by mtx
+  std::mutex mtx;
+  std::condition_variable work_cv;       // job queued or plan freed, or stop
+  std::condition_variable done_cv;       // a job finished
+  std::condition_variable stop_cv;       // a stop_pool finished
+  std::deque<finufft_async> queue;       // jobs not yet started
+  std::vector<finufft_plan> busy;        // plans with a running job
+  std::vector<std::thread> workers;      // empty until first needed
+  int nworkers, nthreads;                // config for the next start
+  int stop;                              // 1 while stop_pool joins workers
+  int quit;                              // at exit: drop queued jobs
+  async_pool() : nworkers(1), nthreads(0), stop(0), quit(0) {}
+  ~async_pool();
+};
+static async_pool pool;
+
+static void worker(int nth)
+// Runs queued jobs until the pool is stopped and its queue is empty (or, at
+// exit, at once), each with at most nth OpenMP threads (unless the plan's
+// opts.nthreads is set).
+{
+  MY_OMP_SET_NUM_THREADS(nth);           // (this thread's default)
+  std::unique_lock<std::mutex> lk(pool.mtx);
+  while (true) {
+    if (pool.quit)
+      return;
+    std::deque<finufft_async>::iterator it = pool.queue.begin();
+    while (it!=pool.queue.end() &&       // first job whose plan is free
+	   std::find(pool.busy.begin(),pool.busy.end(),(*it)->plan)!=pool.busy.end())
+      ++it;
+    if (it!=pool.queue.end()) {
+      finufft_async h = *it;
+      pool.queue.erase(it);
+      pool.busy.push_back(h->plan);
+      lk.unlock();
+      int ier = finufft_execute(h->plan,h->c,h->fk);
+      lk.lock();
+      h->ier = ier;
+      h->done = 1;
+      pool.busy.erase(std::find(pool.busy.begin(),pool.busy.end(),h->plan));
+      pool.done_cv.notify_all();
+      pool.work_cv.notify_all();         // (a job on that plan may be queued)
+    } else if (pool.stop && pool.queue.empty())
+      return;
+    else
+      pool.work_cv.wait(lk);
+  }
+}
+
+static void stop_pool()
+// Lets the workers finish all queued jobs, then joins them. The next job
+// queued starts a new pool with the current config. Meanwhile pool.stop is
+// 1, and other threads wanting to queue jobs or stop the pool wait on
+// stop_cv, since workers started now would exit at once.
+{
+  std::unique_lock<std::mutex> lk(pool.mtx);
+  while (pool.stop)                      // (another stop in progress)
+    pool.stop_cv.wait(lk);
+  pool.stop = 1;
+  pool.work_cv.notify_all();
+  std::vector<std::thread> w;
+  w.swap(pool.workers);
+  lk.unlock();
+  for (size_t i=0; i<w.size(); ++i)
+    w[i].join();
+  lk.lock();
+  pool.stop = 0;
+  pool.stop_cv.notify_all();
+}
+
+async_pool::~async_pool()
+// At exit: joins the workers, each after its running job (if any), without
+// starting queued ones, whose plans and arrays may no longer exist.
+{
+  std::vector<std::thread> w;
+  {
+    std::lock_guard<std::mutex> lk(mtx);
+    quit = 1;
+    work_cv.notify_all();
+    w.swap(workers);
+  }
+  for (size_t i=0; i<w.size(); ++i)
+    w[i].join();
+}
+
+int finufft_async_threads(int nworkers, int nthreads)
+/* Sets the pool used by finufft_execute_async to nworkers worker threads
+   (default 1), sharing a budget of nthreads OpenMP threads (0, the default:
+   the caller's OpenMP max # threads when the pool starts), so that each
+   transform uses nthreads/nworkers threads (at least 1) unless its plan's
+   opts.nthreads is set. At most nworkers transforms, on different plans, run
+   at once. If the pool is running, first waits for the queued jobs to finish.
+   Returns 0, or ERR_ASYNC_ARGS if nworkers<1 or nthreads<0.
+*/
+{
+  if (nworkers<1 || nthreads<0) {
+    fprintf(stderr,"finufft_async_threads: invalid nworkers=%d or nthreads=%d\n",nworkers,nthreads);
+    return ERR_ASYNC_ARGS;
+  }
+  stop_pool();
+  std::lock_guard<std::mutex> lk(pool.mtx);
+  pool.nworkers = nworkers;
+  pool.nthreads = nthreads;
+  return 0;
+}
+
+int finufft_execute_async(finufft_plan plan, CPX *c, CPX *fk,
+			  finufft_async *h)
+/* Queues finufft_execute(plan,c,fk) on the worker pool (see
+   finufft_async_threads), starting the pool if need be, and returns at once,
+   writing a completion handle to *h. The arrays c and fk must not be
+   touched, nor the plan used other than by further finufft_execute_async
+   calls, until the handle has been waited on by finufft_async_wait (which
+   also frees it); every handle must be waited on before the program exits.
+   Jobs on one plan run in the order queued. If another thread is stopping
+   the pool (finufft_async_threads), first waits for that to finish.
+   Returns 0, or ERR_ASYNC_ARGS if plan is NULL (*h is then NULL).
+*/
+{
+  *h = NULL;
+  if (!plan) {
+    fprintf(stderr,"finufft_execute_async: NULL plan\n");
+    return ERR_ASYNC_ARGS;
+  }
+  finufft_async a = new finufft_async_s;
+  a->plan = plan; a->c = c; a->fk = fk;
+  a->ier = 0; a->done = 0;
+  std::unique_lock<std::mutex> lk(pool.mtx);
+  while (pool.stop)                      // (its workers are exiting)
+    pool.stop_cv.wait(lk);
+  if (pool.workers.empty()) {            // start the pool
+    int budget = pool.nthreads>0 ? pool.nthreads : MY_OMP_GET_MAX_THREADS();
+    int nth = std::max(1,budget/pool.nworkers);
+    for (int i=0; i<pool.nworkers; ++i)
+      pool.workers.push_back(std::thread(worker,nth));
+  }
+  pool.queue.push_back(a);
+  pool.work_cv.notify_all();
+  *h = a;
+  return 0;
+}
+
+int finufft_async_test(finufft_async h)
+// Returns 1 if the job of handle h has finished, 0 if it is queued or
+// running. Does not block (other than briefly for the pool's lock).
+{
+  std::lock_guard<std::mutex> lk(pool.mtx);
+  return h->done;
+}
+
+int finufft_async_wait(finufft_async h)
+// Blocks until the job of handle h has finished, frees the handle, and
+// returns the value returned by its finufft_execute.
+{
+  std::unique_lock<std::mutex> lk(pool.mtx);
+  while (!h->done)
+    pool.done_cv.wait(lk);
+  lk.unlock();
+  int ier = h->ier;
+  delete h;
+  return ier;
+}
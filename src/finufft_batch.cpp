@@ -0,0 +1,208 @@
+// Batched interface for many independent small type-1 or type-2 transforms,
+// each with its own NU pts, strengths and mode counts. Problems are done one
+// per thread (single-threaded spread, FFT, deconvolve), with the FFTW plan and
+// kernel Fourier series computed once per distinct fine grid size and shared.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+struct batch_grid {     // shared data for all problems with one fine grid size
+  BIGINT nf[3];         // fine grid sizes (1 for unused dims)
+  BIGINT M;             // total # NU pts of its problems (for spread tuning)
+  int nprob;            // # problems using it
+  spread_opts spopts;   // spreader opts tuned for this grid size
+  FFTW_PLAN p;          // in-place plan, executed on each thread's own array
+  FLT *ker[3];          // kernel Fourier series per dim (NULL if unused)
+};
+
+static void batch_deconvolve(int dir, int dim, batch_grid &g,
+			     nufft_batch_prob &pr, FFTW_CPX *fw, int modeord)
+// deconvolve and copy out (dir=1) or amplify and copy in (dir=2) one problem
+{
+  if (dim==1)
+    deconvolveshuffle1d(dir,1.0,g.ker[0],pr.ms,(FLT*)pr.fk,g.nf[0],fw,modeord);
+  else if (dim==2)
+    deconvolveshuffle2d(dir,1.0,g.ker[0],g.ker[1],pr.ms,pr.mt,(FLT*)pr.fk,
+			g.nf[0],g.nf[1],fw,modeord);
+  else
+    deconvolveshuffle3d(dir,1.0,g.ker[0],g.ker[1],g.ker[2],pr.ms,pr.mt,pr.mu,
+			(FLT*)pr.fk,g.nf[0],g.nf[1],g.nf[2],fw,modeord);
+}
+
+int finufft_batch(int dim, int type, int nprob, nufft_batch_prob *probs,
+		  int iflag, FLT eps, nufft_opts opts)
+/* Batch of nprob independent dim-dimensional type-1 (or type-2) NUFFTs, the
+   q'th being as finufft?d1 (or finufft?d2) with nj=probs[q].M, NU pts
+   probs[q].x,y,z, strengths (or output values) probs[q].c, and mode counts
+   probs[q].ms,mt,mu, outputs (or inputs) probs[q].fk. Fields for dims beyond
+   dim are ignored. iflag, eps and opts are common to all problems.
+
+   Problems are distributed one per thread (dynamically, so differing sizes
+   balance), each done single-threaded, using opts.nthreads threads in total
+   (0: OpenMP default). FFTW plans and kernel Fourier series are made once per
+   distinct fine grid size, before any problem is done, so for many small
+   problems the per-problem overhead is only the spread, FFT and deconvolve.
+   Each thread needs one working array the size of the largest fine grid.
+   upsampfac=0 chooses sigma once for the batch, from the mean problem size.
+
+   Each problem's error code is written to probs[q].ier. If opts.stats is set,
+   its per-stage times are summed over threads (ie, CPU time) and its fine
+   grid sizes are those of the largest grid.
+   Returns 0 on success, ERR_BATCH_ARGS if dim, type or any problem's sizes
+   are invalid, else the first nonzero probs[q].ier (see ../docs/usage.rst).
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (dim<1 || dim>3 || (type!=1 && type!=2) || nprob<0) {
+    fprintf(stderr,"finufft_batch: invalid dim=%d, type=%d or nprob=%d\n",dim,type,nprob);
+    return ERR_BATCH_ARGS;
+  }
+  BIGINT Mtot = 0;
+  double Nmean[3] = {0.0,0.0,0.0};
+  for (int q=0; q<nprob; ++q) {
+    nufft_batch_prob &pr = probs[q];
+    BIGINT m[3] = {pr.ms,pr.mt,pr.mu};
+    int bad = (pr.M<0);
+    for (int d=0; d<dim; ++d)
+      bad = bad || (m[d]<0);
+    if (bad) {
+      fprintf(stderr,"finufft_batch: problem %d has invalid M or mode count\n",q);
+      return ERR_BATCH_ARGS;
+    }
+    Mtot += pr.M;
+    for (int d=0; d<dim; ++d) Nmean[d] += (double)m[d]/nprob;
+  }
+  if (nprob==0) return 0;
+  if (opts.upsampfac==0.0)              // auto: choose sigma for mean problem
+    opts.upsampfac = choose_upsampfac(type,dim,eps,Mtot/nprob,Nmean[0],
+				      (dim>1) ? Nmean[1] : 1,
+				      (dim>2) ? Nmean[2] : 1,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
+  spopts.nthreads = 1;                  // each problem is single-threaded
+
+  // group problems by fine grid size (distinct mode counts may share one)...
+  CNTime timer; timer.start();
+  std::vector<batch_grid> grids;
+  std::vector<int> igrid(nprob);
+  std::map<std::vector<BIGINT>,int> gridindex;
+  BIGINT nfmax = 1, ngmax = 0;
+  for (int q=0; q<nprob; ++q) {
+    nufft_batch_prob &pr = probs[q];
+    BIGINT m[3] = {pr.ms,pr.mt,pr.mu};
+    std::vector<BIGINT> nf(3,1);
+    for (int d=0; d<dim; ++d)
+      set_nf_type12(m[d],opts,spopts,&nf[d]);
+    if (nf[0]*nf[1]*nf[2]>MAX_NF) {
+      fprintf(stderr,"finufft_batch: problem %d nf=%.3g exceeds MAX_NF of %.3g\n",q,(double)nf[0]*nf[1]*nf[2],(double)MAX_NF);
+      return ERR_MAXNALLOC;
+    }
+    std::map<std::vector<BIGINT>,int>::iterator it = gridindex.find(nf);
+    if (it==gridindex.end()) {
+      batch_grid g;
+      for (int d=0; d<3; ++d) { g.nf[d] = nf[d]; g.ker[d] = NULL; }
+      g.M = 0; g.nprob = 0; g.p = NULL;
+      it = gridindex.insert(std::make_pair(nf,(int)grids.size())).first;
+      grids.push_back(g);
+    }
+    igrid[q] = it->second;
+    grids[it->second].M += pr.M;
+    grids[it->second].nprob++;
+    BIGINT nft = nf[0]*nf[1]*nf[2];
+    if (nft>nfmax) { nfmax = nft; ngmax = it->second; }
+  }
+  int ngrids = grids.size();
+  nufft_stats st; start_stats(st,spopts,grids[ngmax].nf[0],grids[ngmax].nf[1],
+			      grids[ngmax].nf[2]);
+  if (opts.debug) printf("batch %dd%d: %d problems, %d distinct fine grids (max nf=%lld), total M=%lld\n",dim,type,nprob,ngrids,(long long)nfmax,(long long)Mtot);
+
+  // per grid size: spread tuning, kernel Fourier series, and FFTW plan...
+  int fftsign = (iflag>=0) ? 1 : -1;
+  for (int i=0; i<ngrids; ++i) {
+    batch_grid &g = grids[i];
+    g.spopts = spopts;
+    set_spread_tuning(g.spopts,opts,g.nf[0],g.nf[1],g.nf[2],g.M/g.nprob);
+    timer.restart();
+    for (int d=0; d<dim; ++d) {
+      g.ker[d] = (FLT*)malloc(sizeof(FLT)*(g.nf[d]/2+1));
+      st.bytes_alloc += sizeof(FLT)*(g.nf[d]/2+1);
+      onedim_fseries_kernel(g.nf[d],g.ker[d],spopts);
+    }
+    st.t_kerfser += timer.elapsedsec();
+    timer.restart();
+    BIGINT nft = g.nf[0]*g.nf[1]*g.nf[2];
+    FFTW_CPX *fw = FFTW_ALLOC_CPX(nft);  // (same alignment as thread arrays)
+    int n[3];
+    for (int d=0; d<dim; ++d) n[d] = (int)g.nf[dim-1-d];  // (row-major)
+    g.p = plan_fftw(dim,n,1,fw,fftsign,opts.fftw,1);
+    FFTW_FR(fw);
+    st.t_fftwplan += timer.elapsedsec();
+  }
+  if (opts.debug) printf("kernel fser & fftw plans (%d):\t %.3g s\n",opts.fftw,st.t_kerfser+st.t_fftwplan);
+
+  // do the problems, one per thread...
+  timer.restart();
+#pragma omp parallel
+  {
+    nufft_stats tst;                    // this thread's stats, summed after
+    memset(&tst,0,sizeof(nufft_stats));
+    FFTW_CPX *fw = FFTW_ALLOC_CPX(nfmax);  // this thread's working fine grid
+    tst.bytes_alloc += sizeof(FFTW_CPX)*nfmax;
+#pragma omp for schedule(dynamic,1)
+    for (int q=0; q<nprob; ++q) {
+      nufft_batch_prob &pr = probs[q];
+      batch_grid &g = grids[igrid[q]];
+      spread_opts sp = g.spopts;
+      sp.stats = &tst;
+      FLT *y = (dim>1) ? pr.y : NULL, *z = (dim>2) ? pr.z : NULL;
+      CNTime t;
+      if (type==1) {
+	sp.spread_direction = 1;
+	pr.ier = spreadinterp(g.nf[0],g.nf[1],g.nf[2],(FLT*)fw,pr.M,pr.x,y,z,
+			      (FLT*)pr.c,sp);
+	if (pr.ier>0) continue;
+	t.start();
+	FFTW_EX_DFT(g.p,fw,fw);
+	tst.t_fft += t.elapsedsec();
+	t.restart();
+	batch_deconvolve(1,dim,g,pr,fw,opts.modeord);
+	tst.t_deconv += t.elapsedsec();
+      } else {
+	t.start();
+	batch_deconvolve(2,dim,g,pr,fw,opts.modeord);
+	tst.t_deconv += t.elapsedsec();
+	t.restart();
+	FFTW_EX_DFT(g.p,fw,fw);
+	tst.t_fft += t.elapsedsec();
+	sp.spread_direction = 2;
+	pr.ier = spreadinterp(g.nf[0],g.nf[1],g.nf[2],(FLT*)fw,pr.M,pr.x,y,z,
+			      (FLT*)pr.c,sp);
+	if (pr.ier>0) continue;
+      }
+      pr.ier = 0;
+    }
+    FFTW_FR(fw);
+#pragma omp critical (finufft_batch_stats)
+    add_stats(st,tst);
+  }
+  if (opts.debug) printf("problems (%d threads):\t %.3g s\n",MY_OMP_GET_MAX_THREADS(),timer.elapsedsec());
+
+  for (int i=0; i<ngrids; ++i) {
+    destroy_fftw(grids[i].p);
+    for (int d=0; d<dim; ++d) free(grids[i].ker[d]);
+  }
+  int ier = 0;
+  for (int q=0; q<nprob && !ier; ++q)
+    ier = probs[q].ier;
+  if (ier) return ier;
+  finish_stats(st,totaltimer.elapsedsec(),Mtot,opts);
+  return 0;
+}
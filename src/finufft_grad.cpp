@@ -0,0 +1,195 @@
+// Type-2 NUFFT returning the gradient alongside the values at each target, as
+// needed for particle-mesh forces. The gradient component in dim d has modes
+// weighted by i k_d (times the sign of iflag), so each component gets its own
+// fine grid, interleaved with the others and all FFT'd in one batched FFTW
+// call; then a single sorted interpolation pass evaluates the kernel once per
+// target, and reads all the grids' values at each grid point together.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int type2grad(int dim, BIGINT nj, FLT *xj, FLT *yj, FLT *zj, CPX *cj,
+		     CPX **gj, int iflag, FLT eps, BIGINT ms, BIGINT mt,
+		     BIGINT mu, CPX *fk, nufft_opts opts)
+// Does the work of finufft?d2grad in dims 1,2,3 (mt=mu=1 if unused), with the
+// gradient output arrays gj[0..dim-1].
+{
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(2,dim,eps,nj,ms,mt,mu,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
+  BIGINT m[3] = {ms,mt,mu}, nf[3] = {1,1,1};
+  for (int d=0; d<dim; ++d)
+    set_nf_type12(m[d],opts,spopts,&nf[d]);
+  BIGINT nft = nf[0]*nf[1]*nf[2];
+  if (nft*(dim+1)>MAX_NF) {
+    fprintf(stderr,"(dim+1)*nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nft*(dim+1),(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  FLT sgn = (iflag>=0) ? 1.0 : -1.0;
+  nufft_stats st; start_stats(st,spopts,nf[0],nf[1],nf[2]);
+  if (use_direct(dim,nj,ms,mt,mu,nf[0],nf[1],nf[2],spopts,opts)) {
+    CNTime timer; timer.start();      // tiny: direct sum per component
+    direct_type2(dim,nj,xj,yj,zj,cj,iflag,ms,mt,mu,fk,opts.modeord);
+    BIGINT N = ms*mt*mu;
+    CPX *fkw = (CPX*)malloc(sizeof(CPX)*N);
+    for (int d=0; d<dim; ++d) {
+      BIGINT stride = (d==0) ? 1 : (d==1) ? ms : ms*mt;
+      for (BIGINT i=0; i<N; ++i)
+	fkw[i] = fk[i] * CPX(0.0,sgn*mode_k((i/stride)%m[d],m[d],opts.modeord));
+      direct_type2(dim,nj,xj,yj,zj,gj[d],iflag,ms,mt,mu,fkw,opts.modeord);
+    }
+    free(fkw);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("%dd2grad: direct sum (nj=%lld):\t %.3g s\n",dim,(long long)nj,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+    return 0;
+  }
+  set_spread_tuning(spopts,opts,nf[0],nf[1],nf[2],nj);
+  if (opts.debug) printf("%dd2grad: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld) nj=%lld ...\n",dim,(long long)ms,(long long)mt,(long long)mu,(long long)nf[0],(long long)nf[1],(long long)nf[2],(long long)nj);
+
+  // STEP 0: get Fourier coeffs of spread kernel in each dim:
+  CNTime timer; timer.start();
+  FLT *fwkerhalf[3] = {NULL,NULL,NULL};
+  for (int d=0; d<dim; ++d) {
+    fwkerhalf[d] = (FLT*)malloc(sizeof(FLT)*(nf[d]/2+1));
+    st.bytes_alloc += sizeof(FLT)*(nf[d]/2+1);
+    onedim_fseries_kernel(nf[d],fwkerhalf[d],spopts);
+  }
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n",spopts.nspread,st.t_kerfser);
+
+  int nth = MY_OMP_GET_MAX_THREADS();
+  timer.restart();
+  int nd = dim+1;                              // # grids: value, gradient
+  FFTW_CPX *fw = alloc_fine_grid(nft*nd,opts);       // (interleaved per grid pt)
+  st.bytes_alloc += sizeof(FFTW_CPX)*nft*nd;
+  int fftsign = (iflag>=0) ? 1 : -1;
+  int n[3];
+  for (int d=0; d<dim; ++d) n[d] = (int)nf[dim-1-d];  // (row-major)
+  FFTW_PLAN p = plan_fftw(dim,n,nd,fw,fftsign,opts.fftw,nth,1);  // in-place
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
+
+  // STEP 1: amplify Fourier coeffs fk and copy into the start of upsampled
+  // array fw, then spread out each value in place (backwards, so unread values
+  // are never overwritten) followed by its product with i*sgn*k_d for each d
+  timer.restart();
+  if (dim==1)
+    deconvolveshuffle1d(2,1.0,fwkerhalf[0],ms,(FLT*)fk,nf[0],fw,opts.modeord);
+  else if (dim==2)
+    deconvolveshuffle2d(2,1.0,fwkerhalf[0],fwkerhalf[1],ms,mt,(FLT*)fk,nf[0],
+			nf[1],fw,opts.modeord);
+  else
+    deconvolveshuffle3d(2,1.0,fwkerhalf[0],fwkerhalf[1],fwkerhalf[2],ms,mt,mu,
+			(FLT*)fk,nf[0],nf[1],nf[2],fw,opts.modeord);
+  FLT *f = (FLT*)fw;
+  for (BIGINT i=nft-1; i>=0; --i) {
+    FLT re = f[2*i], im = f[2*i+1];
+    BIGINT idx[3] = {i%nf[0], (i/nf[0])%nf[1], i/(nf[0]*nf[1])};
+    FLT *o = f + 2*nd*i;
+    o[0] = re; o[1] = im;
+    for (int d=0; d<dim; ++d) {
+      FLT k = sgn*mode_k(idx[d],nf[d],1);      // fine grid is FFT-style
+      o[2*d+2] = -k*im;
+      o[2*d+3] = k*re;
+    }
+  }
+  st.t_deconv = timer.elapsedsec();
+  if (opts.debug) printf("amplify & copy in:\t %.3g s\n",st.t_deconv);
+
+  // Step 2:  Call FFT (all grids)
+  timer.restart();
+  FFTW_EX(p);
+  destroy_fftw(p);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("fft (%d threads, %d grids):\t %.3g s\n",nth,nd,st.t_fft);
+
+  // Step 3: check & sort NU pts, then interpolate all grids in one pass
+  timer.restart();
+  spopts.spread_direction = 2;
+  BIGINT n2 = (dim>1) ? nf[1] : 1, n3 = (dim>2) ? nf[2] : 1;
+  BIGINT *sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*nj);
+  st.bytes_alloc += sizeof(BIGINT)*nj;
+  int did_sort;
+  int ier = spreadchecksort(sort_indices,NULL,nf[0],n2,n3,nj,xj,yj,zj,spopts,
+			    did_sort);
+  if (ier==0) {
+    FLT *out[4] = {(FLT*)cj,NULL,NULL,NULL};
+    for (int d=0; d<dim; ++d) out[d+1] = (FLT*)gj[d];
+    ier = interpmultiwithsortidx(sort_indices,nf[0],n2,n3,nd,(FLT*)fw,nj,
+				 xj,yj,zj,out,spopts);
+  }
+  free(sort_indices);
+  if (opts.debug) printf("unspread (ier=%d):\t %.3g s\n",ier,timer.elapsedsec());
+  FFTW_FR(fw);
+  for (int d=0; d<dim; ++d) free(fwkerhalf[d]);
+  if (ier>0) return ier;
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+  return 0;
+}
+
+int finufft1d2grad(BIGINT nj,FLT* xj,CPX* cj,CPX* gxj,int iflag,FLT eps,
+		   BIGINT ms,CPX* fk,nufft_opts opts)
+/* Type-2 1D complex nonuniform FFT with derivative. As finufft1d2, computes
+
+     c[j] = SUM_k f[k] exp(+-i k x[j])     for j = 0,...,nj-1,
+
+   and also its derivative with respect to x[j],
+
+     gx[j] = SUM_k (+-i k) f[k] exp(+-i k x[j]),
+
+   writing it to gxj (size-nj complex FLT array). Other inputs and outputs,
+   and returned value, as for finufft1d2. The derivative uses a second FFT,
+   but the kernel is evaluated once per target for both outputs.
+*/
+{
+  CPX *g[1] = {gxj};
+  return type2grad(1,nj,xj,NULL,NULL,cj,g,iflag,eps,ms,1,1,fk,opts);
+}
+
+int finufft2d2grad(BIGINT nj,FLT* xj,FLT* yj,CPX* cj,CPX* gxj,CPX* gyj,
+		   int iflag,FLT eps,BIGINT ms,BIGINT mt,CPX* fk,
+		   nufft_opts opts)
+/* Type-2 2D complex nonuniform FFT with gradient. As finufft2d2, computes
+
+     c[j] = SUM_{k1,k2} f[k1,k2] exp(+-i (k1 x[j] + k2 y[j])),
+
+   and also its gradient with respect to (x[j],y[j]), ie gx[j] and gy[j] are
+   the same sums with f[k1,k2] multiplied by +-i k1 and +-i k2 respectively,
+   writing them to gxj and gyj (each size-nj complex FLT arrays). Other inputs
+   and outputs, and returned value, as for finufft2d2. Each gradient
+   component uses another FFT, but the kernel is evaluated once per target
+   for all outputs.
+*/
+{
+  CPX *g[2] = {gxj,gyj};
+  return type2grad(2,nj,xj,yj,NULL,cj,g,iflag,eps,ms,mt,1,fk,opts);
+}
+
+int finufft3d2grad(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,CPX* cj,CPX* gxj,
+		   CPX* gyj,CPX* gzj,int iflag,FLT eps,BIGINT ms,BIGINT mt,
+		   BIGINT mu,CPX* fk,nufft_opts opts)
+/* Type-2 3D complex nonuniform FFT with gradient. As finufft3d2, computes
+
+     c[j] = SUM_{k1,k2,k3} f[k1,k2,k3] exp(+-i (k1 x[j] + k2 y[j] + k3 z[j])),
+
+   and also its gradient with respect to (x[j],y[j],z[j]), ie gx[j], gy[j],
+   gz[j] are the same sums with f[k1,k2,k3] multiplied by +-i k1, +-i k2 and
+   +-i k3 respectively, writing them to gxj, gyj, gzj (each size-nj complex
+   FLT arrays). Other inputs and outputs, and returned value, as for
+   finufft3d2. Replaces four finufft3d2 calls (for particle-mesh forces) by
+   four FFTs but only one sort and one interpolation pass, which evaluates the
+   kernel once per target for all outputs.
+*/
+{
+  CPX *g[3] = {gxj,gyj,gzj};
+  return type2grad(3,nj,xj,yj,zj,cj,g,iflag,eps,ms,mt,mu,fk,opts);
+}
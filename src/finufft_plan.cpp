@@ -0,0 +1,385 @@
+// Plan interface for repeated type-1 or type-2 transforms: the kernel Fourier
+// series, FFTW plan and fine grid are made once per plan (finufft_makeplan),
+// the NU pts are checked and sorted once per set of pts (finufft_setpts), and
+// then any number of transforms with new strengths or coefficients are done
+// (finufft_execute), as needed by iterative solvers. Pts that move a little
+// between steps can be set by finufft_updatepts, which patches the previous
+// sort rather than redoing it. Optionally
+// (opts.spread_kerprecomp=1) setpts also stores the kernel values at each NU
+// pt, so that execute does no kernel evaluations at all.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct finufft_plan_s {   // (opaque to the user; see finufft.h)
+  int type, dim, iflag;
+  FLT eps;
+  BIGINT ms, mt, mu;      // # modes in each dim (1 for unused dims)
+  BIGINT nf1, nf2, nf3;   // fine grid sizes (1 for unused dims)
+  nufft_opts opts;        // copy of user's opts (upsampfac resolved)
+  spread_opts spopts;     // spreader opts, tuned at setpts
+  FLT *fwkerhalf[3];      // kernel Fourier series per dim (NULL if unused)
+  FFTW_CPX *fw;           // fine grid
+  FFTW_PLAN fftwplan;     // in-place on fw
+  int fftw_nth;           // # threads fftwplan was made with
+  BIGINT M;               // # NU pts (-1 before setpts)
+  FLT *X, *Y, *Z;         // user's NU pt coords (not copied)
+  BIGINT *sort_indices;   // size-M bin-sort permutation from setpts
+  FLT *kr;                // size dim*M rescaled coords in sorted order, or
+                          //   NULL if not sorted (see spreadchecksort)
+  int did_sort;
+  int direct;             // 1: execute by direct summation
+  spread_kerprecomp kp;   // kernel values at NU pts (if opts.spread_kerprecomp)
+};
+
+static void plan_fine_fft(finufft_plan p, int nth)
+// makes p's FFTW plan, in-place on its fine grid, for nth threads
+{
+  BIGINT nf[3] = {p->nf1,p->nf2,p->nf3};
+  int n[3];
+  for (int d=0; d<p->dim; ++d) n[d] = (int)nf[p->dim-1-d];  // (row-major)
+  p->fftwplan = plan_fftw(p->dim,n,1,p->fw,(p->iflag>=0) ? 1 : -1,
+			  p->opts.fftw,nth);
+  p->fftw_nth = nth;
+}
+
+int finufft_makeplan(int type, int dim, BIGINT ms, BIGINT mt, BIGINT mu,
+		     int iflag, FLT eps, finufft_plan *plan, nufft_opts opts)
+/* Creates a plan for repeated dim-dimensional type-1 (or type-2) NUFFTs with
+   ms,mt,mu modes (as in finufft?d1, finufft?d2; mt, mu ignored in lower dims),
+   sign iflag, tolerance eps and options opts, writing its handle to *plan.
+   This does all the work that does not depend on the NU pts: kernel Fourier
+   series, fine grid allocation, and FFTW plan (so opts.fftw=FFTW_MEASURE is
+   worthwhile for many executes). upsampfac=0 chooses sigma as if the number
+   of NU pts equalled the number of modes. Then call finufft_setpts and
+   finufft_execute (any number of times each), and finally finufft_destroy.
+   A plan holds one fine grid, so may be used by only one thread at a time;
+   different plans may be used concurrently. If opts.stats is set, it is
+   filled by this and each later call on the plan with that call's timings.
+   Returns 0 on success, ERR_PLAN_ARGS if type (only 1 or 2) or dim is
+   invalid, else as finufft?d1 (see ../docs/usage.rst); *plan is then NULL.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  *plan = NULL;
+  if ((type!=1 && type!=2) || dim<1 || dim>3 || ms<0 ||
+      (dim>1 && mt<0) || (dim>2 && mu<0)) {
+    fprintf(stderr,"finufft_makeplan: invalid type=%d, dim=%d or mode counts\n",type,dim);
+    return ERR_PLAN_ARGS;
+  }
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (dim<2) mt = 1;
+  if (dim<3) mu = 1;
+  if (opts.upsampfac==0.0)              // auto: assume M is of order N
+    opts.upsampfac = choose_upsampfac(type,dim,eps,ms*mt*mu,ms,mt,mu,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts);
+  if (ier_set) return ier_set;
+  BIGINT m[3] = {ms,mt,mu}, nf[3] = {1,1,1};
+  for (int d=0; d<dim; ++d)
+    set_nf_type12(m[d],opts,spopts,&nf[d]);
+  BIGINT nft = nf[0]*nf[1]*nf[2];
+  if (nft>MAX_NF) {
+    fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nft,(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  nufft_stats st; start_stats(st,spopts,nf[0],nf[1],nf[2]);
+  if (opts.debug) printf("makeplan %dd%d: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld)\n",dim,type,(long long)ms,(long long)mt,(long long)mu,(long long)nf[0],(long long)nf[1],(long long)nf[2]);
+
+  finufft_plan p = (finufft_plan)malloc(sizeof(struct finufft_plan_s));
+  p->type = type; p->dim = dim; p->iflag = iflag; p->eps = eps;
+  p->ms = ms; p->mt = mt; p->mu = mu;
+  p->nf1 = nf[0]; p->nf2 = nf[1]; p->nf3 = nf[2];
+  p->opts = opts;
+  p->spopts = spopts;
+  p->spopts.spread_direction = type;
+  p->M = -1; p->X = p->Y = p->Z = NULL;
+  p->sort_indices = NULL; p->kr = NULL; p->did_sort = 0; p->direct = 0;
+  p->kp.M = 0; p->kp.ker = NULL; p->kp.i0 = NULL;
+
+  CNTime timer; timer.start();
+  for (int d=0; d<3; ++d) {
+    p->fwkerhalf[d] = NULL;
+    if (d<dim) {
+      p->fwkerhalf[d] = (FLT*)malloc(sizeof(FLT)*(nf[d]/2+1));
+      st.bytes_alloc += sizeof(FLT)*(nf[d]/2+1);
+      onedim_fseries_kernel(nf[d],p->fwkerhalf[d],spopts);
+    }
+  }
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n",spopts.nspread,st.t_kerfser);
+
+  timer.restart();
+  p->fw = alloc_fine_grid(nft,opts);
+  st.bytes_alloc += sizeof(FFTW_CPX)*nft;
+  plan_fine_fft(p,MY_OMP_GET_MAX_THREADS());
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
+
+  *plan = p;
+  finish_stats(st,totaltimer.elapsedsec(),0,opts);
+  return 0;
+}
+
+static int setpts_kerprecomp(finufft_plan plan, BIGINT M, spread_opts spopts,
+			     nufft_stats &st)
+// stores the kernel values at the plan's sorted NU pts. plan->kr is kept,
+// though executes then don't need it, for finufft_updatepts
+{
+  int dim = plan->dim;
+  BIGINT n2 = (dim>1) ? plan->nf2 : 1, n3 = (dim>2) ? plan->nf3 : 1;
+  FLT *k[3] = {plan->X,plan->Y,plan->Z};
+  if (plan->kr) {                       // (read contiguously)
+    spopts.kpresorted = 1;
+    for (int d=0; d<dim; ++d) k[d] = plan->kr + d*M;
+  }
+  int ier = spreadkerprecomp(plan->kp,plan->sort_indices,plan->nf1,n2,n3,M,
+			     k[0],k[1],k[2],spopts);
+  if (!ier)
+    st.bytes_kerprecomp = spreadkerprecomp_bytes(M,plan->kp.ndims,plan->kp.ns);
+  return ier;
+}
+
+int finufft_setpts(finufft_plan plan, BIGINT M, FLT *x, FLT *y, FLT *z)
+/* Sets (or replaces) the M NU pts x,y,z (as in finufft?d1; y, z ignored in
+   lower dims) used by subsequent executes of plan. The arrays are not copied,
+   so must not be changed or freed until the next setpts or destroy. Checks
+   bounds if opts.chkbnds, and bin-sorts the pts, storing their rescaled
+   coords in sorted order (dim*sizeof(FLT) bytes per pt) so that executes
+   read them contiguously. If the plan's
+   opts.spread_kerprecomp=1, also evaluates and stores the kernel values at
+   each NU pt, which needs dim*(nspread*sizeof(FLT)+4) bytes per pt (about
+   180 bytes per pt in 3D at eps=1e-6 in double precision), reported as
+   bytes_kerprecomp in the plan's opts.stats, which if set is filled with
+   the timings of this call (kernel precomputation counted in t_spread).
+   Returns 0 on success, else as finufft?d1 (see ../docs/usage.rst).
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = plan->opts;
+  thread_scope thrs(opts.nthreads);
+  int dim = plan->dim;
+  free(plan->sort_indices); plan->sort_indices = NULL;
+  free(plan->kr); plan->kr = NULL;
+  free_spreadkerprecomp(plan->kp);
+  plan->M = -1;
+  if (M<0) {
+    fprintf(stderr,"finufft_setpts: invalid M=%lld\n",(long long)M);
+    return ERR_PLAN_ARGS;
+  }
+  plan->X = x;
+  plan->Y = (dim>1) ? y : NULL;
+  plan->Z = (dim>2) ? z : NULL;
+  plan->direct = (opts.direct>0);       // (auto never worthwhile once planned)
+  if (!plan->direct)
+    set_spread_tuning(plan->spopts,opts,plan->nf1,plan->nf2,plan->nf3,M);
+  spread_opts spopts = plan->spopts;
+  nufft_stats st; start_stats(st,spopts,plan->nf1,plan->nf2,plan->nf3);
+  if (plan->direct) {
+    if (opts.debug) printf("setpts %dd%d: M=%lld, direct sum\n",dim,plan->type,(long long)M);
+    plan->M = M;
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),M,opts);
+    return 0;
+  }
+  if (opts.debug) printf("setpts %dd%d: M=%lld\n",dim,plan->type,(long long)M);
+  BIGINT n2 = (dim>1) ? plan->nf2 : 1, n3 = (dim>2) ? plan->nf3 : 1;
+  plan->sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*M);
+  plan->kr = (FLT*)malloc(sizeof(FLT)*dim*M);
+  int ier = spreadchecksort(plan->sort_indices,plan->kr,plan->nf1,n2,n3,M,
+			    plan->X,plan->Y,plan->Z,spopts,plan->did_sort);
+  if (!ier && !plan->did_sort) {        // (kr only written if sorted)
+    free(plan->kr); plan->kr = NULL;
+  }
+  if (!ier && opts.spread_kerprecomp)
+    ier = setpts_kerprecomp(plan,M,spopts,st);
+  if (ier) {
+    free(plan->sort_indices); plan->sort_indices = NULL;
+    free(plan->kr); plan->kr = NULL;
+    return ier;
+  }
+  st.bytes_alloc += (sizeof(BIGINT) + (plan->kr ? dim*sizeof(FLT) : 0))*M;
+  plan->M = M;
+  finish_stats(st,totaltimer.elapsedsec(),M,opts);
+  return 0;
+}
+
+int finufft_updatepts(finufft_plan plan, FLT *x, FLT *y, FLT *z)
+/* Replaces the NU pts of plan by x,y,z, the new positions of the same M pts
+   (in the same order) as in the last finufft_setpts, as when particles move a
+   little between time steps. Equivalent to finufft_setpts(plan,M,x,y,z), but
+   reuses the previous bin-sort: only pts that changed bin are re-binned and
+   merged back into the order, so that beyond one sweep over the pts the cost
+   grows with the # that moved across bins rather than with M (see
+   spreadresort). Falls back to a full setpts if the previous pts were not
+   sorted, or if many pts changed bin. Results may differ from those after
+   setpts by rounding error, as the order within bins may differ.
+   Returns 0 on success, ERR_PLAN_ARGS if setpts has not succeeded, else as
+   finufft_setpts.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = plan->opts;
+  BIGINT M = plan->M;
+  if (M<0) {
+    fprintf(stderr,"finufft_updatepts: no NU pts set (call finufft_setpts)\n");
+    return ERR_PLAN_ARGS;
+  }
+  if (plan->direct || !plan->kr)        // nothing to reuse
+    return finufft_setpts(plan,M,x,y,z);
+  thread_scope thrs(opts.nthreads);
+  int dim = plan->dim;
+  free_spreadkerprecomp(plan->kp);
+  plan->M = -1;
+  plan->X = x;
+  plan->Y = (dim>1) ? y : NULL;
+  plan->Z = (dim>2) ? z : NULL;
+  spread_opts spopts = plan->spopts;
+  nufft_stats st; start_stats(st,spopts,plan->nf1,plan->nf2,plan->nf3);
+  if (opts.debug) printf("updatepts %dd%d: M=%lld\n",dim,plan->type,(long long)M);
+  BIGINT n2 = (dim>1) ? plan->nf2 : 1, n3 = (dim>2) ? plan->nf3 : 1;
+  int ier = spreadresort(plan->sort_indices,plan->kr,plan->nf1,n2,n3,M,
+			 plan->X,plan->Y,plan->Z,spopts,plan->did_sort);
+  if (!ier && !plan->did_sort) {        // (if fell back to setpts' sort)
+    free(plan->kr); plan->kr = NULL;
+  }
+  if (!ier && opts.spread_kerprecomp)
+    ier = setpts_kerprecomp(plan,M,spopts,st);
+  if (ier) {
+    free(plan->sort_indices); plan->sort_indices = NULL;
+    free(plan->kr); plan->kr = NULL;
+    return ier;
+  }
+  plan->M = M;
+  finish_stats(st,totaltimer.elapsedsec(),M,opts);
+  return 0;
+}
+
+int finufft_execute(finufft_plan plan, CPX *c, CPX *fk)
+/* Does one transform of the plan's type at the NU pts of the last
+   finufft_setpts: type 1 reads strengths c (size M) and writes modes fk (size
+   ms*mt*mu), type 2 reads fk and writes c, each as in finufft?d1, finufft?d2.
+   Only the spread (or interp), FFT and deconvolve are done; with
+   opts.spread_kerprecomp=1, the spread or interp uses the stored kernel
+   values. The FFT uses the current OpenMP max # threads (after
+   opts.nthreads): if that differs from the # the FFTW plan was made with (eg
+   in an async worker, see finufft_async.cpp), the FFTW plan is first remade
+   for it, so executes never oversubscribe their thread budget. If the plan's
+   opts.stats is set it is filled with the timings of this call.
+   Returns 0 on success, ERR_PLAN_ARGS if setpts has not succeeded, else as
+   finufft?d1 (see ../docs/usage.rst).
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = plan->opts;
+  thread_scope thrs(opts.nthreads);
+  int dim = plan->dim, type = plan->type;
+  BIGINT M = plan->M;
+  if (M<0) {
+    fprintf(stderr,"finufft_execute: no NU pts set (call finufft_setpts)\n");
+    return ERR_PLAN_ARGS;
+  }
+  spread_opts spopts = plan->spopts;
+  nufft_stats st; start_stats(st,spopts,plan->nf1,plan->nf2,plan->nf3);
+  if (plan->direct) {
+    CNTime timer; timer.start();
+    if (type==1)
+      direct_type1(dim,M,plan->X,plan->Y,plan->Z,c,plan->iflag,plan->ms,
+		   plan->mt,plan->mu,fk,opts.modeord);
+    else
+      direct_type2(dim,M,plan->X,plan->Y,plan->Z,c,plan->iflag,plan->ms,
+		   plan->mt,plan->mu,fk,opts.modeord);
+    st.t_direct = timer.elapsedsec();
+    if (opts.debug) printf("execute %dd%d: direct sum:\t %.3g s\n",dim,type,st.t_direct);
+    st.nf1 = st.nf2 = st.nf3 = 0;
+    finish_stats(st,totaltimer.elapsedsec(),M,opts);
+    return 0;
+  }
+  if (plan->kp.ker) st.bytes_kerprecomp = spreadkerprecomp_bytes(M,plan->kp.ndims,plan->kp.ns);
+  st.did_sort = plan->did_sort;
+  BIGINT nf1 = plan->nf1, nf2 = plan->nf2, nf3 = plan->nf3;
+  BIGINT n2 = (dim>1) ? nf2 : 1, n3 = (dim>2) ? nf3 : 1;
+  FFTW_CPX *fw = plan->fw;
+  CNTime timer;
+  int nth = MY_OMP_GET_MAX_THREADS();
+  if (nth!=plan->fftw_nth) {  // remake FFTW plan (fw not yet in use)
+    timer.start();
+    destroy_fftw(plan->fftwplan);
+    plan_fine_fft(plan,nth);
+    st.t_fftwplan = timer.elapsedsec();
+    if (opts.debug) printf("fftw replan (%d threads):\t %.3g s\n",nth,st.t_fftwplan);
+  }
+  st.fft_nthreads = nth;
+  int ier = 0;
+  if (type==2) {              // amplify & copy in
+    timer.start();
+    if (dim==1)
+      deconvolveshuffle1d(2,1.0,plan->fwkerhalf[0],plan->ms,(FLT*)fk,nf1,fw,opts.modeord);
+    else if (dim==2)
+      deconvolveshuffle2d(2,1.0,plan->fwkerhalf[0],plan->fwkerhalf[1],plan->ms,
+			  plan->mt,(FLT*)fk,nf1,nf2,fw,opts.modeord);
+    else
+      deconvolveshuffle3d(2,1.0,plan->fwkerhalf[0],plan->fwkerhalf[1],
+			  plan->fwkerhalf[2],plan->ms,plan->mt,plan->mu,(FLT*)fk,
+			  nf1,nf2,nf3,fw,opts.modeord);
+    st.t_deconv = timer.elapsedsec();
+    if (opts.debug) printf("amplify & copy in:\t %.3g s\n",st.t_deconv);
+    timer.restart();
+    FFTW_EX(plan->fftwplan);
+    st.t_fft = timer.elapsedsec();
+    if (opts.debug) printf("fft (%d threads):\t %.3g s\n",MY_OMP_GET_MAX_THREADS(),st.t_fft);
+  }
+  timer.restart();            // spread (type 1) or interp (type 2)
+  if (plan->kp.ker)
+    ier = spreadwithkerprecomp(plan->kp,plan->sort_indices,nf1,n2,n3,(FLT*)fw,
+			       (FLT*)c,spopts,plan->did_sort);
+  else if (plan->kr) {        // presorted rescaled coords
+    spopts.kpresorted = 1;
+    ier = spreadwithsortidx(plan->sort_indices,nf1,n2,n3,(FLT*)fw,M,plan->kr,
+			    (dim>1) ? plan->kr+M : NULL,
+			    (dim>2) ? plan->kr+2*M : NULL,(FLT*)c,spopts,
+			    plan->did_sort);
+  } else
+    ier = spreadwithsortidx(plan->sort_indices,nf1,n2,n3,(FLT*)fw,M,plan->X,
+			    plan->Y,plan->Z,(FLT*)c,spopts,plan->did_sort);
+  if (opts.debug) printf("%s (ier=%d):\t\t %.3g s\n",(type==1) ? "spread" : "interp",ier,timer.elapsedsec());
+  if (ier) return ier;
+  if (type==1) {              // FFT, deconvolve & copy out
+    timer.restart();
+    FFTW_EX(plan->fftwplan);
+    st.t_fft = timer.elapsedsec();
+    if (opts.debug) printf("fft (%d threads):\t %.3g s\n",MY_OMP_GET_MAX_THREADS(),st.t_fft);
+    timer.restart();
+    if (dim==1)
+      deconvolveshuffle1d(1,1.0,plan->fwkerhalf[0],plan->ms,(FLT*)fk,nf1,fw,opts.modeord);
+    else if (dim==2)
+      deconvolveshuffle2d(1,1.0,plan->fwkerhalf[0],plan->fwkerhalf[1],plan->ms,
+			  plan->mt,(FLT*)fk,nf1,nf2,fw,opts.modeord);
+    else
+      deconvolveshuffle3d(1,1.0,plan->fwkerhalf[0],plan->fwkerhalf[1],
+			  plan->fwkerhalf[2],plan->ms,plan->mt,plan->mu,(FLT*)fk,
+			  nf1,nf2,nf3,fw,opts.modeord);
+    st.t_deconv = timer.elapsedsec();
+    if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n",st.t_deconv);
+  }
+  finish_stats(st,totaltimer.elapsedsec(),M,opts);
+  return 0;
+}
+
+int finufft_destroy(finufft_plan plan)
+// Frees all memory held by plan (which may be NULL). Returns 0.
+{
+  if (!plan) return 0;
+  destroy_fftw(plan->fftwplan);
+  FFTW_FR(plan->fw);
+  for (int d=0; d<3; ++d) free(plan->fwkerhalf[d]);
+  free(plan->sort_indices);
+  free(plan->kr);
+  free_spreadkerprecomp(plan->kp);
+  free(plan);
+  return 0;
+}
@@ -0,0 +1,231 @@
+// Type 1 and 2 NUFFTs with split (planar) complex storage: the strengths or
+// values and the Fourier modes hold their real parts and imaginary parts in
+// separate real arrays, so users whose data is planar need not convert it to
+// and from interleaved complex arrays. The split data is read and written
+// directly where the spreader gathers into (or writes back from) its
+// interleaved per-subproblem buffers, and where the modes are copied out of
+// (or into) the fine grid, so costs no extra pass. The fine grid itself stays
+// interleaved: FFTW's split-array plans, and spreading or interpolating
+// separate real and imag grids, both measured slower than the interleaved
+// ones at the kernel widths used here.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static void deconvolve_split(int dir, int dim, FLT **ker, const BIGINT *m,
+			     const BIGINT *nf, FLT *fr, FLT *fi, BIGINT fks,
+			     FFTW_CPX *fw, int modeord)
+// Split version of deconvolveshuffle?d: for dir=1 reads each mode from the
+// fine grid fw, divides by the kernel's Fourier coeffs ker[d], and writes it
+// to (fr,fi) in the order given by modeord, stride fks; for dir=2 the
+// reverse, zeroing the other fine grid entries first.
+{
+  FLT *w = (FLT*)fw;
+  std::vector<BIGINT> idx[3];          // fine grid index of each mode, per dim
+  std::vector<FLT> fac[3];             // 1/kernel coeff of each mode, per dim
+  for (int d=0; d<3; ++d) {
+    BIGINT md = (d<dim) ? m[d] : 1;
+    idx[d].resize(md); fac[d].resize(md);
+    for (BIGINT i=0; i<md; ++i) {
+      BIGINT k = (modeord==1) ? ((i<(md+1)/2) ? i : i-md) : i - md/2;
+      idx[d][i] = (k>=0) ? k : nf[d]+k;
+      fac[d][i] = (d<dim) ? 1.0/ker[d][(k>=0) ? k : -k] : 1.0;
+    }
+  }
+  BIGINT m1 = idx[0].size(), m2 = idx[1].size(), m3 = idx[2].size();
+  if (dir==2) {
+    BIGINT nft = nf[0]*nf[1]*nf[2];
+#pragma omp parallel for schedule(static)   // (as the spreader's zeroing)
+    for (BIGINT i=0; i<2*nft; ++i)
+      w[i] = 0.0;
+  }
+  for (BIGINT i3=0; i3<m3; ++i3)
+    for (BIGINT i2=0; i2<m2; ++i2) {
+      BIGINT o = nf[0]*(idx[1][i2] + nf[1]*idx[2][i3]);   // fine row offset
+      BIGINT q = fks*m1*(i2 + m2*i3);                   // output row offset
+      FLT f23 = fac[1][i2]*fac[2][i3];
+      if (dir==1)
+	for (BIGINT i1=0; i1<m1; ++i1) {
+	  FLT f = f23*fac[0][i1];
+	  BIGINT j = 2*(o+idx[0][i1]);
+	  fr[q+fks*i1] = f*w[j];
+	  fi[q+fks*i1] = f*w[j+1];
+	}
+      else
+	for (BIGINT i1=0; i1<m1; ++i1) {
+	  FLT f = f23*fac[0][i1];
+	  BIGINT j = 2*(o+idx[0][i1]);
+	  w[j] = f*fr[q+fks*i1];
+	  w[j+1] = f*fi[q+fks*i1];
+	}
+    }
+}
+
+static int nufft_split(int type, int dim, BIGINT nj, FLT *xj, FLT *yj,
+		       FLT *zj, FLT *cr, FLT *ci, int iflag, FLT eps,
+		       BIGINT ms, BIGINT mt, BIGINT mu, FLT *fr, FLT *fi,
+		       nufft_opts opts)
+// Does the work of finufft?d?split for type 1 or 2 in dims 1,2,3 (mt=mu=1 if
+// unused).
+{
+  CNTime totaltimer; totaltimer.start();
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (opts.modeset)                     // (no restricted mode sets here)
+    return ERR_MODESET_NOTVALID;
+  if (opts.upsampfac==0.0)              // auto: choose sigma by cost model
+    opts.upsampfac = choose_upsampfac(type,dim,eps,nj,ms,mt,mu,opts);
+  spread_opts spopts;
+  int ier_set = setup_spreader_for_nufft(spopts,eps,opts,dim);
+  if (ier_set) return ier_set;
+  int ier_st = set_spread_strides(spopts,opts);   // user's data layout
+  if (ier_st) return ier_st;
+  BIGINT m[3] = {ms,mt,mu}, nf[3] = {1,1,1};
+  for (int d=0; d<dim; ++d)
+    set_nf_type12(m[d],opts,spread_dim_opts(spopts,d),&nf[d]);
+  BIGINT nft = nf[0]*nf[1]*nf[2];
+  if (nft>MAX_NF) {
+    fprintf(stderr,"nf1*nf2*nf3=%.3g exceeds MAX_NF of %.3g\n",(double)nft,(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  nufft_stats st; start_stats(st,spopts,nf[0],nf[1],nf[2]);
+  set_spread_tuning(spopts,opts,nf[0],nf[1],nf[2],nj);
+  if (opts.debug) printf("%dd%dsplit: (ms,mt,mu)=(%lld,%lld,%lld) (nf1,nf2,nf3)=(%lld,%lld,%lld) nj=%lld ...\n",dim,type,(long long)ms,(long long)mt,(long long)mu,(long long)nf[0],(long long)nf[1],(long long)nf[2],(long long)nj);
+
+  // STEP 0: get Fourier coeffs of spread kernel in each dim:
+  CNTime timer; timer.start();
+  FLT *fwkerhalf[3] = {NULL,NULL,NULL};
+  for (int d=0; d<dim; ++d) {
+    fwkerhalf[d] = (FLT*)malloc(sizeof(FLT)*(nf[d]/2+1));
+    st.bytes_alloc += sizeof(FLT)*(nf[d]/2+1);
+    onedim_fseries_kernel(nf[d],fwkerhalf[d],spread_dim_opts(spopts,d));
+  }
+  st.t_kerfser = timer.elapsedsec();
+  if (opts.debug) printf("kernel fser (ns=%d):\t %.3g s\n",spopts.nspread,st.t_kerfser);
+
+  int nth = MY_OMP_GET_MAX_THREADS();
+  timer.restart();
+  FFTW_CPX *fw = alloc_fine_grid(nft,opts);   // working upsampled array
+  st.bytes_alloc += sizeof(FFTW_CPX)*nft;
+  int fftsign = (iflag>=0) ? 1 : -1;
+  int n[3];
+  for (int d=0; d<dim; ++d) n[d] = (int)nf[dim-1-d];  // (row-major)
+  FFTW_PLAN p = plan_fftw(dim,n,1,fw,fftsign,opts.fftw,nth);   // in-place
+  st.t_fftwplan = timer.elapsedsec();
+  if (opts.debug) printf("fftw plan (%d)    \t %.3g s\n",opts.fftw,st.t_fftwplan);
+
+  int ier = 0;
+  if (type==1) {
+    // Step 1: spread from irregular points to regular grid
+    timer.restart();
+    spopts.spread_direction = 1;
+    ier = spreadinterp_split(nf[0],nf[1],nf[2],(FLT*)fw,nj,xj,yj,zj,cr,ci,spopts);
+    if (opts.debug) printf("spread (ier=%d):\t\t %.3g s\n",ier,timer.elapsedsec());
+    if (ier==0) {
+      // Step 2:  Call FFT
+      timer.restart();
+      FFTW_EX(p);
+      st.t_fft = timer.elapsedsec();
+      if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,st.t_fft);
+      // Step 3: Deconvolve by dividing coeffs by that of kernel; shuffle out
+      timer.restart();
+      deconvolve_split(1,dim,fwkerhalf,m,nf,fr,fi,opts.fkstride,fw,
+		       opts.modeord);
+      st.t_deconv = timer.elapsedsec();
+      if (opts.debug) printf("deconvolve & copy out:\t %.3g s\n",st.t_deconv);
+    }
+  } else {
+    // STEP 1: amplify Fourier coeffs fk and copy into upsampled array fw
+    timer.restart();
+    deconvolve_split(2,dim,fwkerhalf,m,nf,fr,fi,opts.fkstride,fw,
+		     opts.modeord);
+    st.t_deconv = timer.elapsedsec();
+    if (opts.debug) printf("amplify & copy in:\t %.3g s\n",st.t_deconv);
+    // Step 2:  Call FFT
+    timer.restart();
+    FFTW_EX(p);
+    st.t_fft = timer.elapsedsec();
+    if (opts.debug) printf("fft (%d threads):\t %.3g s\n",nth,st.t_fft);
+    // Step 3: unspread (interpolate) from regular to irregular target pts
+    timer.restart();
+    spopts.spread_direction = 2;
+    ier = spreadinterp_split(nf[0],nf[1],nf[2],(FLT*)fw,nj,xj,yj,zj,cr,ci,spopts);
+    if (opts.debug) printf("unspread (ier=%d):\t %.3g s\n",ier,timer.elapsedsec());
+  }
+  destroy_fftw(p);
+  FFTW_FR(fw);
+  for (int d=0; d<dim; ++d) free(fwkerhalf[d]);
+  if (ier>0) return ier;
+  finish_stats(st,totaltimer.elapsedsec(),nj,opts);
+  return 0;
+}
+
+int finufft1d1split(BIGINT nj,FLT* xj,FLT* cr,FLT* ci,int iflag,FLT eps,
+		    BIGINT ms,FLT* fr,FLT* fi,nufft_opts opts)
+/* Type-1 1D complex nonuniform FFT with split (planar) complex storage.
+   As finufft1d1, but the strengths have real parts cr and imag parts ci
+   (each a size-nj FLT array), and the output modes real parts fr and imag
+   parts fi (each a size-ms FLT array). opts.cstride and opts.fkstride count
+   FLTs in these arrays. Never uses the direct sum, and opts.modeset must be
+   0 (else returns ERR_MODESET_NOTVALID).
+*/
+{
+  return nufft_split(1,1,nj,xj,NULL,NULL,cr,ci,iflag,eps,ms,1,1,fr,fi,opts);
+}
+
+int finufft1d2split(BIGINT nj,FLT* xj,FLT* cr,FLT* ci,int iflag,FLT eps,
+		    BIGINT ms,FLT* fr,FLT* fi,nufft_opts opts)
+/* Type-2 1D complex nonuniform FFT with split (planar) complex storage.
+   As finufft1d2, with the input modes in (fr,fi) and the output values in
+   (cr,ci); see finufft1d1split.
+*/
+{
+  return nufft_split(2,1,nj,xj,NULL,NULL,cr,ci,iflag,eps,ms,1,1,fr,fi,opts);
+}
+
+int finufft2d1split(BIGINT nj,FLT* xj,FLT* yj,FLT* cr,FLT* ci,int iflag,
+		    FLT eps,BIGINT ms,BIGINT mt,FLT* fr,FLT* fi,
+		    nufft_opts opts)
+/* Type-1 2D complex nonuniform FFT with split (planar) complex storage.
+   As finufft2d1, with the strengths in (cr,ci) and the output modes (size
+   ms*mt each) in (fr,fi); see finufft1d1split.
+*/
+{
+  return nufft_split(1,2,nj,xj,yj,NULL,cr,ci,iflag,eps,ms,mt,1,fr,fi,opts);
+}
+
+int finufft2d2split(BIGINT nj,FLT* xj,FLT* yj,FLT* cr,FLT* ci,int iflag,
+		    FLT eps,BIGINT ms,BIGINT mt,FLT* fr,FLT* fi,
+		    nufft_opts opts)
+/* Type-2 2D complex nonuniform FFT with split (planar) complex storage.
+   As finufft2d2, with the input modes in (fr,fi) and the output values in
+   (cr,ci); see finufft1d1split.
+*/
+{
+  return nufft_split(2,2,nj,xj,yj,NULL,cr,ci,iflag,eps,ms,mt,1,fr,fi,opts);
+}
+
+int finufft3d1split(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,FLT* cr,FLT* ci,
+		    int iflag,FLT eps,BIGINT ms,BIGINT mt,BIGINT mu,FLT* fr,
+		    FLT* fi,nufft_opts opts)
+/* Type-1 3D complex nonuniform FFT with split (planar) complex storage.
+   As finufft3d1, with the strengths in (cr,ci) and the output modes (size
+   ms*mt*mu each) in (fr,fi); see finufft1d1split.
+*/
+{
+  return nufft_split(1,3,nj,xj,yj,zj,cr,ci,iflag,eps,ms,mt,mu,fr,fi,opts);
+}
+
+int finufft3d2split(BIGINT nj,FLT* xj,FLT* yj,FLT* zj,FLT* cr,FLT* ci,
+		    int iflag,FLT eps,BIGINT ms,BIGINT mt,BIGINT mu,FLT* fr,
+		    FLT* fi,nufft_opts opts)
+/* Type-2 3D complex nonuniform FFT with split (planar) complex storage.
+   As finufft3d2, with the input modes in (fr,fi) and the output values in
+   (cr,ci); see finufft1d1split.
+*/
+{
+  return nufft_split(2,3,nj,xj,yj,zj,cr,ci,iflag,eps,ms,mt,mu,fr,fi,opts);
+}
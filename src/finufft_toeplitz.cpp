@@ -0,0 +1,241 @@
+// Toeplitz-embedded normal operator A^* W A, where A is the type-2 NUFFT
+// (modes to NU pts) and W a diagonal weighting at the NU pts, as applied at
+// each iteration of least-squares solvers (eg MRI reconstruction). Its matrix
+// is Toeplitz in the mode indices,
+//
+//   (A^* W A f)[k] = SUM_l T[k-l] f[l],   T[m] = SUM_j w[j] exp(-+i m.x[j]),
+//
+// so T is found once by a single type-1 NUFFT with twice the modes per dim,
+// and thereafter the operator is applied as a convolution by zero-padding to
+// a circulant of (at least) twice the size per dim and using FFTs. No
+// spreading or interpolation is done when applying it.
+
+#include "finufft.h"
+#include "common.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct finufft_toeplitz_s {  // (opaque to the user; see finufft.h)
+  int dim;
+  BIGINT m[3];            // # modes in each dim (1 for unused dims)
+  BIGINT n[3];            // circulant size in each dim (1 for unused dims)
+  nufft_opts opts;
+  FFTW_CPX *khat;         // FFT of circulant kernel, divided by its size
+  FFTW_CPX *fw;           // circulant-size work array
+  FFTW_PLAN pfwd, pbwd;   // in-place on fw
+};
+
+static inline BIGINT wrap(BIGINT k, BIGINT n)
+// index of mode k in a size-n circulant (FFT-style) array, for |k|<n
+{
+  return (k>=0) ? k : k+n;
+}
+
+int finufft_toeplitz_make(int dim, BIGINT M, FLT *x, FLT *y, FLT *z, CPX *w,
+			  int iflag, FLT eps, BIGINT ms, BIGINT mt, BIGINT mu,
+			  finufft_toeplitz *T, nufft_opts opts)
+/* Sets up the normal operator A^* W A for the dim-dimensional type-2 NUFFT A
+   with M NU pts x,y,z (y, z ignored in lower dims), sign iflag, and ms,mt,mu
+   modes (as in finufft?d2), and W the diagonal matrix of weights w (size M;
+   NULL means all ones), writing its handle to *T. A^* is then the type-1
+   NUFFT with sign -iflag, so applying the operator is equivalent to
+   finufft?d2, multiplying by w, then finufft?d1 with sign -iflag.
+   This does one type-1 NUFFT of the weights with 2*ms,2*mt,2*mu modes (to
+   tolerance eps), and the FFT of the resulting circulant kernel. The NU pts
+   and weights are not needed after this call. Needs two complex arrays of
+   the circulant size (at least 2^dim times the # modes).
+   If opts.stats is set, it is filled with this call's total timings.
+   Returns 0 on success, ERR_PLAN_ARGS if dim, M or mode counts are invalid,
+   else as finufft?d1 (see ../docs/usage.rst); *T is then NULL.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  *T = NULL;
+  if (dim<1 || dim>3 || M<0 || ms<0 || (dim>1 && mt<0) || (dim>2 && mu<0)) {
+    fprintf(stderr,"finufft_toeplitz_make: invalid dim=%d, M or mode counts\n",dim);
+    return ERR_PLAN_ARGS;
+  }
+  thread_scope thrs(opts.nthreads);     // (restores # threads on return)
+  if (dim<2) mt = 1;
+  if (dim<3) mu = 1;
+  BIGINT m[3] = {ms,mt,mu}, n[3] = {1,1,1}, ntot = 1;
+  for (int d=0; d<dim; ++d) {
+    if (m[d]>0) n[d] = next_fine_size(2*m[d],opts); // >=2m-1 for linear conv
+    ntot *= n[d];
+  }
+  if (ntot>MAX_NF) {
+    fprintf(stderr,"circulant size %.3g exceeds MAX_NF of %.3g\n",(double)ntot,(double)MAX_NF);
+    return ERR_MAXNALLOC;
+  }
+  nufft_stats st; memset(&st,0,sizeof(nufft_stats));
+  st.nf1 = n[0]; st.nf2 = n[1]; st.nf3 = n[2];
+  if (opts.debug) printf("toeplitz %dd: (ms,mt,mu)=(%lld,%lld,%lld) circulant (%lld,%lld,%lld) M=%lld\n",dim,(long long)ms,(long long)mt,(long long)mu,(long long)n[0],(long long)n[1],(long long)n[2],(long long)M);
+
+  finufft_toeplitz t = (finufft_toeplitz)malloc(sizeof(struct finufft_toeplitz_s));
+  t->dim = dim;
+  for (int d=0; d<3; ++d) { t->m[d] = m[d]; t->n[d] = n[d]; }
+  t->opts = opts;
+  t->khat = alloc_fine_grid(ntot,opts);
+  t->fw = alloc_fine_grid(ntot,opts);
+  st.bytes_alloc += 2*sizeof(FFTW_CPX)*ntot;
+
+  // kernel T[k], k in [-m,m-1] per dim, by type-1 of weights (FFT order)...
+  BIGINT m2[3] = {2*ms,(dim>1) ? 2*mt : 1,(dim>2) ? 2*mu : 1};
+  BIGINT nk = m2[0]*m2[1]*m2[2];
+  CPX *tk = (CPX*)malloc(sizeof(CPX)*nk);
+  CPX *c = w;
+  if (!w) {                             // unit weights
+    c = (CPX*)malloc(sizeof(CPX)*M);
+    for (BIGINT j=0; j<M; ++j) c[j] = 1.0;
+  }
+  st.bytes_alloc += sizeof(CPX)*(nk + (w ? 0 : M));
+  nufft_opts o1 = opts;
+  nufft_stats st1;
+  o1.modeord = 1;
+  o1.modeset = 0; o1.modelines = NULL;  // (the whole 2N kernel grid)
+  o1.xstride = o1.cstride = o1.fkstride = 1;   // (own contiguous arrays)
+  o1.stats = &st1;
+  int ier = 0;
+  if (nk>0) {
+    if (dim==1)
+      ier = finufft1d1(M,x,c,-iflag,eps,m2[0],tk,o1);
+    else if (dim==2)
+      ier = finufft2d1(M,x,y,c,-iflag,eps,m2[0],m2[1],tk,o1);
+    else
+      ier = finufft3d1(M,x,y,z,c,-iflag,eps,m2[0],m2[1],m2[2],tk,o1);
+    if (!ier) add_stats(st,st1);
+  }
+  if (!w) free(c);
+  if (ier) {
+    free(tk); FFTW_FR(t->khat); FFTW_FR(t->fw); free(t);
+    return ier;
+  }
+
+  // ...placed in circulant (|k|<m only; the rest are zero), and FFT'd
+  CNTime timer; timer.start();
+  int nn[3];
+  for (int d=0; d<dim; ++d) nn[d] = (int)n[dim-1-d];  // (row-major)
+  int nth = MY_OMP_GET_MAX_THREADS();
+  t->pfwd = plan_fftw(dim,nn,1,t->fw,FFTW_FORWARD,opts.fftw,nth);
+  t->pbwd = plan_fftw(dim,nn,1,t->fw,FFTW_BACKWARD,opts.fftw,nth);
+  st.t_fftwplan = timer.elapsedsec();
+  timer.restart();
+  FLT *kh = (FLT*)t->khat;
+  for (BIGINT i=0; i<2*ntot; ++i) kh[i] = 0.0;
+  if (nk>0) {
+    for (BIGINT i3=0; i3<m2[2]; ++i3) {
+      BIGINT k3 = mode_k(i3,m2[2],1);
+      if (k3<=-m[2]) continue;            // (k=-m is never needed)
+      for (BIGINT i2=0; i2<m2[1]; ++i2) {
+	BIGINT k2 = mode_k(i2,m2[1],1);
+	if (k2<=-m[1]) continue;
+	BIGINT o = n[0]*(wrap(k2,n[1]) + n[1]*wrap(k3,n[2]));
+	for (BIGINT i1=0; i1<m2[0]; ++i1) {
+	  BIGINT k1 = mode_k(i1,m2[0],1);
+	  if (k1<=-m[0]) continue;
+	  CPX v = tk[i1 + m2[0]*(i2 + m2[1]*i3)] / (FLT)ntot;
+	  kh[2*(o+wrap(k1,n[0]))] = real(v);
+	  kh[2*(o+wrap(k1,n[0]))+1] = imag(v);
+	}
+      }
+    }
+    FFTW_EX_DFT(t->pfwd,t->khat,t->khat);
+  }
+  free(tk);
+  st.t_fft = timer.elapsedsec();
+  if (opts.debug) printf("toeplitz kernel FFT (incl plan):\t %.3g s\n",st.t_fftwplan+st.t_fft);
+  *T = t;
+  finish_stats(st,totaltimer.elapsedsec(),M,opts);
+  return 0;
+}
+
+int finufft_toeplitz_apply(finufft_toeplitz T, CPX *fk, CPX *gk)
+/* Applies the normal operator set up by finufft_toeplitz_make to the modes
+   fk, writing gk = A^* W A fk. fk and gk are size ms*mt*mu arrays ordered as
+   in finufft?d1 (according to the opts.modeord given to make), and may be
+   the same array. Costs two FFTs of the circulant size, and no spreading.
+   Uses the threads and stats settings of the opts given to make. A handle
+   may be applied by only one thread at a time.
+   Returns 0.
+*/
+{
+  CNTime totaltimer; totaltimer.start();
+  nufft_opts &opts = T->opts;
+  thread_scope thrs(opts.nthreads);
+  BIGINT *m = T->m, *n = T->n;
+  BIGINT ntot = n[0]*n[1]*n[2], mtot = m[0]*m[1]*m[2];
+  nufft_stats st; memset(&st,0,sizeof(nufft_stats));
+  st.nf1 = n[0]; st.nf2 = n[1]; st.nf3 = n[2];
+  if (mtot==0) {
+    finish_stats(st,totaltimer.elapsedsec(),0,opts);
+    return 0;
+  }
+  int modeord = opts.modeord;
+  FLT *fw = (FLT*)T->fw;
+
+  // zero-pad fk into circulant array...
+  CNTime timer; timer.start();
+  for (BIGINT i=0; i<2*ntot; ++i) fw[i] = 0.0;
+  for (BIGINT i3=0; i3<m[2]; ++i3) {
+    BIGINT o3 = n[0]*n[1]*wrap(mode_k(i3,m[2],modeord),n[2]);
+    for (BIGINT i2=0; i2<m[1]; ++i2) {
+      BIGINT o = o3 + n[0]*wrap(mode_k(i2,m[1],modeord),n[1]);
+      CPX *f = fk + m[0]*(i2 + m[1]*i3);
+      for (BIGINT i1=0; i1<m[0]; ++i1) {
+	BIGINT j = o + wrap(mode_k(i1,m[0],modeord),n[0]);
+	fw[2*j] = real(f[i1]);
+	fw[2*j+1] = imag(f[i1]);
+      }
+    }
+  }
+  st.t_deconv = timer.elapsedsec();
+
+  // convolve with kernel via FFTs...
+  timer.restart();
+  FFTW_EX_DFT(T->pfwd,T->fw,T->fw);
+  st.t_fft = timer.elapsedsec();
+  timer.restart();
+  const FLT *kh = (const FLT*)T->khat;
+#pragma omp parallel for schedule(static)
+  for (BIGINT i=0; i<ntot; ++i) {
+    FLT re = fw[2*i]*kh[2*i] - fw[2*i+1]*kh[2*i+1];
+    fw[2*i+1] = fw[2*i]*kh[2*i+1] + fw[2*i+1]*kh[2*i];
+    fw[2*i] = re;
+  }
+  st.t_deconv += timer.elapsedsec();
+  timer.restart();
+  FFTW_EX_DFT(T->pbwd,T->fw,T->fw);
+  st.t_fft += timer.elapsedsec();
+
+  // ...and crop to output
+  timer.restart();
+  for (BIGINT i3=0; i3<m[2]; ++i3) {
+    BIGINT o3 = n[0]*n[1]*wrap(mode_k(i3,m[2],modeord),n[2]);
+    for (BIGINT i2=0; i2<m[1]; ++i2) {
+      BIGINT o = o3 + n[0]*wrap(mode_k(i2,m[1],modeord),n[1]);
+      CPX *g = gk + m[0]*(i2 + m[1]*i3);
+      for (BIGINT i1=0; i1<m[0]; ++i1) {
+	BIGINT j = o + wrap(mode_k(i1,m[0],modeord),n[0]);
+	g[i1] = CPX(fw[2*j],fw[2*j+1]);
+      }
+    }
+  }
+  st.t_deconv += timer.elapsedsec();
+  if (opts.debug) printf("toeplitz apply: fft %.3g s, pad/mult/crop %.3g s\n",st.t_fft,st.t_deconv);
+  finish_stats(st,totaltimer.elapsedsec(),0,opts);
+  return 0;
+}
+
+int finufft_toeplitz_destroy(finufft_toeplitz T)
+// Frees all memory held by T (which may be NULL). Returns 0.
+{
+  if (!T) return 0;
+  destroy_fftw(T->pfwd);
+  destroy_fftw(T->pbwd);
+  FFTW_FR(T->khat);
+  FFTW_FR(T->fw);
+  free(T);
+  return 0;
+}
@@ -1,16 +1,21 @@
 #include "spreadinterp.h"
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
 #include <math.h>
 
 // declarations of internal functions...
 static inline void set_kernel_args(FLT *args, FLT x, const spread_opts& opts);
 static inline void evaluate_kernel_vector(FLT *ker, FLT *args, const spread_opts& opts, const int N);
 static inline void eval_kernel_vec_Horner(FLT *ker, const FLT z, const int w, const spread_opts &opts);
+static inline void eval_kernel_block_Horner(FLT *ker, const FLT *xj, const int n, const int w, const spread_opts &opts);
+static FLT* get_horner_coeffs(int w, FLT beta, int *d);
 void interp_line(FLT *out,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns);
-void interp_square(FLT *out,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns);
+void interp_square(FLT *out,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns1,int ns2);
 void interp_cube(FLT *out,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
-		 BIGINT i1,BIGINT i2,BIGINT i3,BIGINT N1,BIGINT N2,BIGINT N3,int ns);
+		 BIGINT i1,BIGINT i2,BIGINT i3,BIGINT N1,BIGINT N2,BIGINT N3,
+		 int ns1,int ns2,int ns3);
 void spread_subproblem_1d(BIGINT N1,FLT *du0,BIGINT M0,FLT *kx0,FLT *dd0,
 			  const spread_opts& opts);
 void spread_subproblem_2d(BIGINT N1,BIGINT N2,FLT *du0,BIGINT M0,
@@ -21,15 +26,32 @@ void spread_subproblem_3d(BIGINT N1,BIGINT N2,BIGINT N3,FLT *du0,BIGINT M0,
 void add_wrapped_subgrid(BIGINT offset1,BIGINT offset2,BIGINT offset3,
 			 BIGINT size1,BIGINT size2,BIGINT size3,BIGINT N1,
 			 BIGINT N2,BIGINT N3,FLT *data_uniform, FLT *du0);
+static int spreadinterp_gen(BIGINT N1, BIGINT N2, BIGINT N3,
+			    FLT *data_uniform, BIGINT M, FLT *kx, FLT *ky,
+			    FLT *kz, FLT *dre, FLT *dim, BIGINT cs,
+			    spread_opts opts);
+static int spreadwithsortidx_gen(BIGINT* sort_indices, BIGINT N1, BIGINT N2,
+				 BIGINT N3, FLT *data_uniform, BIGINT M,
+				 FLT *kx, FLT *ky, FLT *kz, FLT *dre, FLT *dim,
+				 BIGINT cs, spread_opts opts, int did_sort);
 void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
+	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,BIGINT ks,
 	      double bin_size_x,double bin_size_y,double bin_size_z, int debug);
 void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
+	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,BIGINT ks,
 	      double bin_size_x,double bin_size_y,double bin_size_z, int debug);
 void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,
 		 BIGINT &size2,BIGINT &size3,BIGINT M0,FLT* kx0,FLT* ky0,
-		 FLT* kz0,int ns, int ndims);
+		 FLT* kz0,const int *ns, int ndims);
+int ndims_from_Ns(BIGINT N1, BIGINT N2, BIGINT N3);
+static int sort_nthreads(BIGINT M, BIGINT N1, BIGINT N2, BIGINT N3,
+			 const spread_opts &opts);
+
+static inline int dim_ns(const spread_opts &opts, int d)
+// kernel width in dim d (d=0,1,2 for x,y,z)
+{
+  return opts.aniso ? opts.dimker[d].nspread : opts.nspread;
+}
 
 
 int spreadinterp(
@@ -51,7 +73,8 @@ int spreadinterp(
 
    In each case phi is the spreading kernel, which has support
    [-opts.nspread/2,opts.nspread/2]. In 2D or 3D, the generalization with
-   product of 1D kernels is performed.
+   product of 1D kernels is performed. If opts.aniso (set up by
+   setup_spreader_dims), each dim's 1D kernel and width is its own.
    For 1D set N2=N3=1; for 2D set N3=1; for 3D set N1,N2,N3>0.
 
    Notes:
@@ -90,6 +113,9 @@ int spreadinterp(
 	pirange = 0: kx,ky,kz coords in [0,N]. 1: coords in [-pi,pi].
                 (due to +-1 box folding these can be out to [-N,2N] and
                 [-3pi/2,3pi/2] respectively).
+	kstride = stride (in FLTs) between successive pts in each of kx,ky,kz
+	          (default 1; eg 3 for packed xyz structs).
+	cstride = stride (in complex entries) of data_nonuniform (default 1).
 	sort = 0,1,2: whether to sort NU points using natural yz-grid
 	       ordering. 0: don't, 1: do, 2: use heuristic choice (default)
         sort_threads = 0, 1,... : if >0, set # sorting threads; if 0
@@ -100,6 +126,7 @@ int spreadinterp(
 	           (each NU pt)
 	chkbnds = 0: don't check incoming NU pts for bounds (but still fold +-1)
                   1: do, and stop with error if any found outside valid bnds
+	nthreads = # threads to use (0: OpenMP's max # threads), restored after
 	flags = integer with binary bits determining various timing options
                 (set to 0 unless expert; see cnufftspread.h)
 
@@ -122,20 +149,57 @@ int spreadinterp(
    kereval, kerpad 4/24/18
    Melody Shih split into 3 routines: check, sort, spread. Jun 2018, making
    this routine just a caller to them. Name change, Barnett 7/27/18
+   Check & sort fused (spreadchecksort), presorted coords when spreading.
 */
 {
-  int ier_spreadcheck = spreadcheck(N1, N2, N3, M, kx, ky, kz, opts);
-  if (ier_spreadcheck != 0) return ier_spreadcheck;
+  return spreadinterp_gen(N1,N2,N3,data_uniform,M,kx,ky,kz,data_nonuniform,
+			  data_nonuniform+1,2*opts.cstride,opts);
+}
 
-  BIGINT* sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*M);
-  int did_sort = spreadsort(sort_indices, N1, N2, N3, M, kx, ky, kz, opts);
-  int ier_spread = spreadwithsortidx(sort_indices, N1, N2, N3, data_uniform,
-                                           M, kx, ky, kz, data_nonuniform,
-                                           opts,did_sort);
-  if (ier_spread != 0) return ier_spread;
+int spreadinterp_split(BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
+		       BIGINT M, FLT *kx, FLT *ky, FLT *kz, FLT *dr, FLT *di,
+		       spread_opts opts)
+/* As spreadinterp, but with the NU data in split (planar) form: real parts
+   dr[opts.cstride*j] and imag parts di[opts.cstride*j], j=0..M-1. They are
+   gathered into (or written back from) the interleaved per-subproblem
+   buffers that the spreader already uses, so cost no extra pass.
+*/
+{
+  return spreadinterp_gen(N1,N2,N3,data_uniform,M,kx,ky,kz,dr,di,
+			  opts.cstride,opts);
+}
 
+static int spreadinterp_gen(BIGINT N1, BIGINT N2, BIGINT N3,
+			    FLT *data_uniform, BIGINT M, FLT *kx, FLT *ky,
+			    FLT *kz, FLT *dre, FLT *dim, BIGINT cs,
+			    spread_opts opts)
+// spreadinterp with the real and imag NU data at dre[cs*j] and dim[cs*j]
+{
+  thread_scope thrs(opts.nthreads);        // scope opts.nthreads to this call
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT* sort_indices = (BIGINT*)malloc(sizeof(BIGINT)*M);
+  // rescaled sorted coords, if sorting: for a single call the extra gather
+  // pass in spreadchecksort only pays off when spreading in 2D or 3D...
+  FLT *kr = NULL;
+  if (opts.spread_direction==1 && ndims>1 && sort_nthreads(M,N1,N2,N3,opts))
+    kr = (FLT*)malloc(sizeof(FLT)*ndims*M);
+  if (opts.stats) opts.stats->bytes_alloc += sizeof(BIGINT)*M + (kr ? sizeof(FLT)*ndims*M : 0);
+  int did_sort;
+  int ier = spreadchecksort(sort_indices, kr, N1, N2, N3, M, kx, ky, kz,
+                            opts, did_sort);
+  if (ier == 0) {
+    if (did_sort && kr) {             // use the presorted coords
+      opts.kpresorted = 1;
+      kx = kr;
+      ky = (ndims>1) ? kr+M : NULL;
+      kz = (ndims>2) ? kr+2*M : NULL;
+    }
+    ier = spreadwithsortidx_gen(sort_indices, N1, N2, N3, data_uniform, M,
+                                kx, ky, kz, dre, dim, cs, opts, did_sort);
+  }
   free(sort_indices);
-  return 0;
+  free(kr);
+  return ier;
 }
 
 int ndims_from_Ns(BIGINT N1, BIGINT N2, BIGINT N3)
@@ -160,8 +224,8 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
 {
   CNTime timer;
   // INPUT CHECKING & REPORTING .... cuboid not too small for spreading?
-  int minN = 2*opts.nspread;
-  if (N1<minN || (N2>1 && N2<minN) || (N3>1 && N3<minN)) {
+  if (N1<2*dim_ns(opts,0) || (N2>1 && N2<2*dim_ns(opts,1)) ||
+      (N3>1 && N3<2*dim_ns(opts,2))) {
     fprintf(stderr,"error: one or more non-trivial box dims is less than 2.nspread!\n");
     return ERR_SPREAD_BOX_SMALL;
   }
@@ -177,7 +241,7 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
   if (opts.chkbnds) {
     timer.start();
     for (BIGINT i=0; i<M; ++i) {
-      FLT x=RESCALE(kx[i],N1,opts.pirange);  // this includes +-1 box folding
+      FLT x=RESCALE(kx[opts.kstride*i],N1,opts.pirange);  // this includes +-1 box folding
       if (x<0 || x>N1 || !isfinite(x)) {     // note isfinite() breaks with -Ofast
         fprintf(stderr,"NU pt not in valid range (central three periods): kx=%g, N1=%lld (pirange=%d)\n",x,(long long)N1,opts.pirange);
         return ERR_SPREAD_PTS_OUT_RANGE;
@@ -185,7 +249,7 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
     }
     if (ndims>1)
       for (BIGINT i=0; i<M; ++i) {
-        FLT y=RESCALE(ky[i],N2,opts.pirange);
+        FLT y=RESCALE(ky[opts.kstride*i],N2,opts.pirange);
         if (y<0 || y>N2 || !isfinite(y)) {
           fprintf(stderr,"NU pt not in valid range (central three periods): ky=%g, N2=%lld (pirange=%d)\n",y,(long long)N2,opts.pirange);
           return ERR_SPREAD_PTS_OUT_RANGE;
@@ -193,7 +257,7 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
       }
     if (ndims>2)
       for (BIGINT i=0; i<M; ++i) {
-        FLT z=RESCALE(kz[i],N3,opts.pirange);
+        FLT z=RESCALE(kz[opts.kstride*i],N3,opts.pirange);
         if (z<0 || z>N3 || !isfinite(z)) {
           fprintf(stderr,"NU pt not in valid range (central three periods): kz=%g, N3=%lld (pirange=%d)\n",z,(long long)N3,opts.pirange);
           return ERR_SPREAD_PTS_OUT_RANGE;
@@ -204,6 +268,22 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
   return 0; 
 }
 
+static int sort_nthreads(BIGINT M, BIGINT N1, BIGINT N2, BIGINT N3,
+			 const spread_opts &opts)
+// # threads with which to bin-sort M NU pts for a N1*N2*N3 grid, or 0 if
+// better not to sort (heuristic unless opts.sort=0 or 1)
+{
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT N=N1*N2*N3;
+  int better_to_sort = !(ndims==1 && (opts.spread_direction==2 || (M > 1000*N1))); // 1D small-N or dir=2 case: don't sort
+  if (!(opts.sort==1 || (opts.sort==2 && better_to_sort)))
+    return 0;
+  int sort_nthr = opts.sort_threads;   // choose # threads for sorting
+  if (sort_nthr==0)   // auto choice: when N>>M, one thread is better!
+    sort_nthr = (10*M>N) ? MY_OMP_GET_MAX_THREADS() : 1;      // heuristic
+  return sort_nthr;
+}
+
 int spreadsort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
                FLT *kx, FLT *ky, FLT *kz, spread_opts opts)
 /* This makes a decision whether to sort the NU pts, and if so, calls either
@@ -213,28 +293,24 @@ int spreadsort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M,
    Split out by Melody Shih, Jun 2018.
 */
 {
+  thread_scope thrs(opts.nthreads);
   CNTime timer;
-  int ndims = ndims_from_Ns(N1,N2,N3);
-  BIGINT N=N1*N2*N3;            // output array size
   
   // NONUNIFORM POINT SORTING .....
-  // heuristic binning box size for U grid... affects performance:
-  double bin_size_x = 16, bin_size_y = 4, bin_size_z = 4;
-  // put in heuristics based on L3 size (only useful for single-thread) ?
-  int better_to_sort = !(ndims==1 && (opts.spread_direction==2 || (M > 1000*N1))); // 1D small-N or dir=2 case: don't sort
+  // binning box size for U grid... affects performance (see autotune.cpp):
+  double bin_size_x = opts.bin_size_x, bin_size_y = opts.bin_size_y;
+  double bin_size_z = opts.bin_size_z;
 
   timer.start();                 // if needed, sort all the NU pts...
   int did_sort=0;
-  if (opts.sort==1 || (opts.sort==2 && better_to_sort)) {
+  int sort_nthr = sort_nthreads(M,N1,N2,N3,opts);
+  if (sort_nthr) {
     // store a good permutation ordering of all NU pts (dim=1,2 or 3)
     int sort_debug = (opts.debug>=2);    // show timing output?
-    int sort_nthr = opts.sort_threads;   // choose # threads for sorting
-    if (sort_nthr==0)   // auto choice: when N>>M, one thread is better!
-      sort_nthr = (10*M>N) ? MY_OMP_GET_MAX_THREADS() : 1;      // heuristic
     if (sort_nthr==1)
-      bin_sort_singlethread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bin_size_x,bin_size_y,bin_size_z,sort_debug);
+      bin_sort_singlethread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,opts.kstride,bin_size_x,bin_size_y,bin_size_z,sort_debug);
     else
-      bin_sort_multithread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,bin_size_x,bin_size_y,bin_size_z,sort_debug);
+      bin_sort_multithread(sort_indices,M,kx,ky,kz,N1,N2,N3,opts.pirange,opts.kstride,bin_size_x,bin_size_y,bin_size_z,sort_debug);
     if (opts.debug) 
       printf("\tsorted (%d threads):\t%.3g s\n",sort_nthr,timer.elapsedsec());
     did_sort=1;
@@ -245,9 +321,507 @@ int spreadsort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M,
     if (opts.debug)
       printf("\tnot sorted (sort=%d): \t%.3g s\n",(int)opts.sort,timer.elapsedsec());
   }
+  if (opts.stats) {
+    opts.stats->t_sort += timer.elapsedsec();
+    opts.stats->did_sort = did_sort;
+  }
   return did_sort;
 }
 
+static void report_bad_pt(BIGINT i, FLT **ks, const BIGINT *Ns, int ndims,
+			  const spread_opts &opts)
+// prints which coord of NU pt i is out of range, as spreadcheck would
+{
+  const char *c = "xyz";
+  for (int d=0; d<ndims; ++d) {
+    FLT x = RESCALE(ks[d][opts.kstride*i],Ns[d],opts.pirange);
+    if (x<0 || x>Ns[d] || !isfinite(x)) {
+      fprintf(stderr,"NU pt not in valid range (central three periods): k%c=%g, N%d=%lld (pirange=%d)\n",c[d],x,d+1,(long long)Ns[d],opts.pirange);
+      break;
+    }
+  }
+}
+
+static int presort_fixup(BIGINT *sort_indices, const BIGINT *key, BIGINT M,
+			 BIGINT maxout)
+/* Bin-sort for NU pts that are nearly in bin order already: splits the pts
+   into those that keep the running max of key (a sorted subsequence) and the
+   rest, sorts the latter, and merges. Writes the same permutation as the
+   counting sort in spreadchecksort, ie stable, to sort_indices, unless more
+   than maxout pts are out of order, in which case it returns 0 (sort_indices
+   then garbage), otherwise 1. Single-threaded; cost O(M + maxout log maxout)
+   with sequential memory access, vs the random writes of the counting sort.
+*/
+{
+  std::vector< std::pair<BIGINT,BIGINT> > out;   // (key,index) of the rest
+  out.reserve(maxout+1);
+  BIGINT nk = 0, rmax = 0;
+  for (BIGINT i=0; i<M; i++)
+    if (key[i]>=rmax) {
+      rmax = key[i];
+      sort_indices[nk++] = i;      // in-order pts packed at the start
+    } else {
+      if ((BIGINT)out.size()==maxout) return 0;
+      out.push_back(std::make_pair(key[i],i));
+    }
+  std::sort(out.begin(),out.end());   // (ties by index, hence stable)
+  BIGINT j = nk-1, l = (BIGINT)out.size()-1;  // merge from the back, in place
+  for (BIGINT p=M-1; l>=0; p--)
+    if (j>=0 && (key[sort_indices[j]]>out[l].first ||
+                 (key[sort_indices[j]]==out[l].first &&
+                  sort_indices[j]>out[l].second)))
+      sort_indices[p] = sort_indices[j--];
+    else
+      sort_indices[p] = out[l--].second;
+  return 1;
+}
+
+int spreadchecksort(BIGINT* sort_indices, FLT *kr, BIGINT N1, BIGINT N2,
+		    BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		    spread_opts opts, int &did_sort)
+/* Fused spreadcheck and spreadsort: in a single multithreaded sweep over the
+   NU pt coords, rescales each pt, checks it (if opts.chkbnds) and finds its
+   bin; a second sweep then writes the bin-sort permutation to sort_indices
+   (or the identity, if not sorting, as decided by spreadsort's heuristic).
+   The first sweep also counts descents in bin order, so that pts already in
+   bin order (eg trajectories) get the identity without sorting, and nearly
+   sorted ones a cheap merge fix-up (presort_fixup) instead.
+   If a sort was done and kr is not NULL (size ndims*M), also writes the
+   rescaled coords there in sorted order, ie kr[d*M+i] is coord d of the i'th
+   sorted pt; these may then be passed as kx,ky,kz to spreadwithsortidx etc
+   with opts.kpresorted=1, which read them contiguously rather than gathering
+   and rescaling them again on every call.
+   Sets did_sort as returned by spreadsort.
+   Returns as spreadcheck.
+*/
+{
+  thread_scope thrs(opts.nthreads);
+  did_sort = 0;
+  spread_opts copts = opts;      // box & direction checks only; pts below
+  copts.chkbnds = 0;
+  int ier = spreadcheck(N1,N2,N3,M,kx,ky,kz,copts);
+  if (ier) return ier;
+  CNTime timer; timer.start();
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int sort_nthr = sort_nthreads(M,N1,N2,N3,opts);
+  int nt = sort_nthr ? sort_nthr : MY_OMP_GET_MAX_THREADS();
+  nt = (int)std::max((BIGINT)1,std::min(M,(BIGINT)nt));
+  BIGINT nbins1=N1/opts.bin_size_x+1, nbins2=1, nbins3=1;
+  if (ndims>1) nbins2 = N2/opts.bin_size_y+1;
+  if (ndims>2) nbins3 = N3/opts.bin_size_z+1;
+  BIGINT nbins = sort_nthr ? nbins1*nbins2*nbins3 : 0;
+  BIGINT Ns[3] = {N1,N2,N3};
+  FLT *ks[3] = {kx,ky,kz};
+  std::vector<BIGINT> brk(nt+1);   // start NU pt indices per thread
+  for (int t=0; t<=nt; ++t)
+    brk[t] = (BIGINT)(0.5 + M*t/(double)nt);
+  BIGINT *key = NULL;              // bin of each NU pt, if sorting
+  if (sort_nthr) key = (BIGINT*)malloc(sizeof(BIGINT)*M);
+  std::vector< std::vector<BIGINT> > ct(nt,std::vector<BIGINT>(nbins,0));
+  std::vector<BIGINT> bad(nt,M);   // first invalid NU pt per thread, or M
+  std::vector<BIGINT> ndesc(nt,0); // # i with key[i]<key[i-1], per thread
+
+#pragma omp parallel num_threads(nt)
+  {
+    int t = MY_OMP_GET_THREAD_NUM();
+    if (t<nt && (sort_nthr || opts.chkbnds)) {  // (else no need to read pts)
+      BIGINT *cnt = sort_nthr ? &ct[t][0] : NULL;
+      BIGINT prev = 0, nd = 0;
+      for (BIGINT i=brk[t]; i<brk[t+1]; i++) {
+        BIGINT ik = opts.kstride*i;
+        FLT x = RESCALE(kx[ik],N1,opts.pirange), y = 0.0, z = 0.0;
+        if (ndims>1) y = RESCALE(ky[ik],N2,opts.pirange);
+        if (ndims>2) z = RESCALE(kz[ik],N3,opts.pirange);
+        if (opts.chkbnds && (x<0 || x>N1 || !isfinite(x) ||
+                             y<0 || y>N2 || !isfinite(y) ||
+                             z<0 || z>N3 || !isfinite(z))) {
+          bad[t] = i;
+          break;
+        }
+        if (sort_nthr) {
+          BIGINT bin = (BIGINT)(x/opts.bin_size_x) +
+            nbins1*((BIGINT)(y/opts.bin_size_y) +
+                    nbins2*(BIGINT)(z/opts.bin_size_z));
+          key[i] = bin;
+          cnt[bin]++;                 // no clash btw threads
+          nd += (bin<prev);
+          prev = bin;
+        }
+      }
+      ndesc[t] = nd;
+    }
+    if (t<nt && !sort_nthr)           // identity order
+      for (BIGINT i=brk[t]; i<brk[t+1]; i++)
+        sort_indices[i] = i;
+  }
+  BIGINT ibad = *std::min_element(bad.begin(),bad.end());
+  if (ibad<M) {
+    report_bad_pt(ibad,ks,Ns,ndims,opts);
+    free(key);
+    return ERR_SPREAD_PTS_OUT_RANGE;
+  }
+  const char *how = "not sorted";
+  if (sort_nthr) {
+    BIGINT D = 0;                   // total # descents in bin order
+    for (int t=0; t<nt; ++t)
+      D += ndesc[t] + (t>0 && brk[t]<M && key[brk[t]]<key[brk[t]-1]);
+    how = "sorted";
+    if (D==0) {                     // already in bin order: identity
+#pragma omp parallel for num_threads(nt) schedule(static)
+      for (BIGINT i=0; i<M; i++)
+        sort_indices[i] = i;
+      how = "already sorted";
+    } else if (D*PRESORT_FIXUP_FRAC<=M && nt<=PRESORT_FIXUP_MAXTHR &&
+               presort_fixup(sort_indices,key,M,M/PRESORT_FIXUP_FRAC))
+      how = "nearly sorted, merged";
+    else {
+      // offsets per thread & bin: cumsum over bins, then along t (as in
+      // bin_sort_multithread), reusing ct...
+      BIGINT off = 0;
+      for (BIGINT b=0; b<nbins; ++b)
+        for (int t=0; t<nt; ++t) {
+          BIGINT c = ct[t][b];
+          ct[t][b] = off;
+          off += c;
+        }
+#pragma omp parallel num_threads(nt)
+      {
+        int t = MY_OMP_GET_THREAD_NUM();
+        if (t<nt) {
+          BIGINT *off = &ct[t][0];
+          for (BIGINT i=brk[t]; i<brk[t+1]; i++)
+            key[i] = off[key[i]]++;    // key now the sorted position
+        }
+      }
+      // invert the map (writing pattern is random)
+#pragma omp parallel for num_threads(nt) schedule(static)
+      for (BIGINT i=0; i<M; i++)
+        sort_indices[key[i]] = i;
+    }
+    free(key);
+    if (kr)                         // gather rescaled coords in sorted order
+      for (int d=0; d<ndims; ++d) {
+        FLT *k = ks[d], *kd = kr+d*M;
+        BIGINT n = Ns[d];
+#pragma omp parallel for num_threads(nt) schedule(static)
+        for (BIGINT p=0; p<M; p++)
+          kd[p] = RESCALE(k[opts.kstride*sort_indices[p]],n,opts.pirange);
+      }
+    did_sort = 1;
+  }
+  if (opts.debug)
+    printf("\tchecked & %s (%d threads):\t%.3g s\n",how,nt,timer.elapsedsec());
+  if (opts.stats) {
+    opts.stats->t_sort += timer.elapsedsec();
+    opts.stats->did_sort = did_sort;
+  }
+  return 0;
+}
+
+static inline BIGINT bin_of(const FLT *kr, BIGINT M, BIGINT p, int ndims,
+			    BIGINT nbins1, BIGINT nbins2,
+			    const spread_opts &opts)
+// bin index (as in spreadchecksort) of the p'th pt, given rescaled coords kr
+{
+  BIGINT b = (BIGINT)(kr[p]/opts.bin_size_x);
+  if (ndims>1) b += nbins1*(BIGINT)(kr[M+p]/opts.bin_size_y);
+  if (ndims>2) b += nbins1*nbins2*(BIGINT)(kr[2*M+p]/opts.bin_size_z);
+  return b;
+}
+
+static BIGINT next_kept(BIGINT m, const std::vector<BIGINT> &mvpos)
+// first position >=m not in the sorted list mvpos (may be the end)
+{
+  size_t a = std::lower_bound(mvpos.begin(),mvpos.end(),m) - mvpos.begin();
+  while (a<mvpos.size() && mvpos[a]==m) { m++; a++; }
+  return m;
+}
+
+static void shift_segments(char *v, size_t sz,
+			   const std::vector<BIGINT> &seg)
+// moves each segment [seg[3s],seg[3s+1]) of array v (element size sz) by
+// seg[3s+2] elements, in an order safe given that they keep their order
+{
+  BIGINT ns = seg.size()/3;
+  for (BIGINT s=0; s<ns; ++s)        // left moves, left to right
+    if (seg[3*s+2]<0)
+      memmove(v+(seg[3*s]+seg[3*s+2])*sz,v+seg[3*s]*sz,(seg[3*s+1]-seg[3*s])*sz);
+  for (BIGINT s=ns-1; s>=0; --s)     // right moves, right to left
+    if (seg[3*s+2]>0)
+      memmove(v+(seg[3*s]+seg[3*s+2])*sz,v+seg[3*s]*sz,(seg[3*s+1]-seg[3*s])*sz);
+}
+
+int spreadresort(BIGINT* sort_indices, FLT *kr, BIGINT N1, BIGINT N2,
+		 BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		 spread_opts opts, int &did_sort)
+/* Incremental version of spreadchecksort for NU pts that have moved a little
+   since sort_indices was made (by spreadchecksort, with a sort done, or by
+   this routine) for the same M pts and grid. In a multithreaded sweep in the
+   old sorted order, gathers, rescales and checks (if opts.chkbnds) the new
+   pts kx,ky,kz, and lists those whose bin differs from that of the old pt,
+   whose rescaled coords kr (size ndims*M, as written by spreadchecksort)
+   must hold on input; kr is overwritten by those of the new pts. The others
+   are still in order, so the moved pts are sorted, their places among the
+   others found by binary search, and sort_indices and kr patched by shifting
+   just the stretches between old and new places. So beyond the sweep the
+   cost grows only with the # pts that changed bin (and how far they moved in
+   the order). If more than M/RESORT_PATCH_FRAC did, does a full
+   spreadchecksort instead. The order within each bin may differ from that of
+   spreadchecksort, hence results to rounding error.
+   Sets did_sort as spreadchecksort. Returns as spreadcheck.
+*/
+{
+  thread_scope thrs(opts.nthreads);
+  did_sort = 0;
+  spread_opts copts = opts;      // box & direction checks only
+  copts.chkbnds = 0;
+  int ier = spreadcheck(N1,N2,N3,M,kx,ky,kz,copts);
+  if (ier) return ier;
+  CNTime timer; timer.start();
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int nt = (int)std::max((BIGINT)1,std::min(M,(BIGINT)MY_OMP_GET_MAX_THREADS()));
+  BIGINT nbins1=N1/opts.bin_size_x+1, nbins2=1;
+  if (ndims>1) nbins2 = N2/opts.bin_size_y+1;
+  BIGINT Ns[3] = {N1,N2,N3};
+  FLT *ks[3] = {kx,ky,kz};
+  std::vector<BIGINT> brk(nt+1);   // start sorted positions per thread
+  for (int t=0; t<=nt; ++t)
+    brk[t] = (BIGINT)(0.5 + M*t/(double)nt);
+  std::vector<BIGINT> bad(nt,M);   // first invalid NU pt per thread, or M
+  char *moved = (char*)malloc(M);  // whether p'th sorted pt changed bin
+  int bs[3] = {opts.bin_size_x,opts.bin_size_y,opts.bin_size_z};
+  for (int d=0; d<ndims; ++d) {    // (one dim at a time: faster gathers)
+    FLT *k = ks[d], *kd = kr+d*M;
+    BIGINT n = Ns[d];
+#pragma omp parallel num_threads(nt)
+    {
+      int t = MY_OMP_GET_THREAD_NUM();
+      if (t<nt)
+        for (BIGINT p=brk[t]; p<brk[t+1]; p++) {
+          FLT x = RESCALE(k[opts.kstride*sort_indices[p]],n,opts.pirange);
+          if (opts.chkbnds && (x<0 || x>n || !isfinite(x))) {
+            bad[t] = std::min(bad[t],sort_indices[p]);
+            break;
+          }
+          char c = ((BIGINT)(x/bs[d])!=(BIGINT)(kd[p]/bs[d]));
+          moved[p] = d ? (moved[p] | c) : c;
+          kd[p] = x;
+        }
+    }
+  }
+  BIGINT ibad = *std::min_element(bad.begin(),bad.end());
+  if (ibad<M) {
+    report_bad_pt(ibad,ks,Ns,ndims,opts);
+    free(moved);
+    return ERR_SPREAD_PTS_OUT_RANGE;
+  }
+  std::vector<BIGINT> mvpos;       // sorted posns of pts that changed bin
+  for (BIGINT p=0; p<M; p++)
+    if (moved[p]) mvpos.push_back(p);
+  free(moved);
+  BIGINT D = mvpos.size();
+  if (D*RESORT_PATCH_FRAC>M) {
+    if (opts.debug)
+      printf("\tre-sort: %lld pts changed bin, full sort instead\n",(long long)D);
+    return spreadchecksort(sort_indices,kr,N1,N2,N3,M,kx,ky,kz,opts,did_sort);
+  }
+  if (D) {
+    std::vector< std::pair<BIGINT,BIGINT> > mk(D);  // (new bin, old posn)
+    for (BIGINT j=0; j<D; ++j)
+      mk[j] = std::make_pair(bin_of(kr,M,mvpos[j],ndims,nbins1,nbins2,opts),
+                             mvpos[j]);
+    std::sort(mk.begin(),mk.end());
+    std::vector<BIGINT> ins(D);    // kept posn each moved pt goes before
+    for (BIGINT j=0; j<D; ++j) {   // (binary search, skipping moved posns)
+      BIGINT lo = 0, hi = M;
+      while (lo<hi) {
+        BIGINT mid = lo + (hi-lo)/2, m = next_kept(mid,mvpos);
+        if (m==M || std::make_pair(bin_of(kr,M,m,ndims,nbins1,nbins2,opts),m)>mk[j])
+          hi = mid;
+        else
+          lo = m+1;
+      }
+      ins[j] = next_kept(lo,mvpos);
+    }
+    // stretches of kept pts between removal and insertion posns, with shifts
+    std::vector<BIGINT> seg;
+    BIGINT nrem = 0, nins = 0, cur = 0, a = 0, b = 0;
+    while (a<D || b<D) {
+      BIGINT e = std::min(a<D ? mvpos[a] : M, b<D ? ins[b] : M);
+      if (e>cur && nins!=nrem) {
+        seg.push_back(cur); seg.push_back(e); seg.push_back(nins-nrem);
+      }
+      cur = std::max(cur,e);
+      while (b<D && ins[b]==e) { nins++; b++; }
+      if (a<D && mvpos[a]==e) { nrem++; a++; cur = e+1; }
+    }
+    std::vector<BIGINT> msi(D), newpos(D);   // moved pts' indices & new posns
+    std::vector<FLT> mkr(ndims*D);
+    for (BIGINT j=0; j<D; ++j) {
+      BIGINT p = mk[j].second;
+      msi[j] = sort_indices[p];
+      for (int d=0; d<ndims; ++d)
+        mkr[d*D+j] = kr[d*M+p];
+      newpos[j] = ins[j] - (std::lower_bound(mvpos.begin(),mvpos.end(),ins[j])
+                            - mvpos.begin()) + j;
+    }
+    shift_segments((char*)sort_indices,sizeof(BIGINT),seg);
+    for (int d=0; d<ndims; ++d)
+      shift_segments((char*)(kr+d*M),sizeof(FLT),seg);
+    for (BIGINT j=0; j<D; ++j) {
+      sort_indices[newpos[j]] = msi[j];
+      for (int d=0; d<ndims; ++d)
+        kr[d*M+newpos[j]] = mkr[d*D+j];
+    }
+  }
+  did_sort = 1;
+  if (opts.debug)
+    printf("\tchecked & re-sorted (%lld pts changed bin, %d threads):\t%.3g s\n",(long long)D,nt,timer.elapsedsec());
+  if (opts.stats) {
+    opts.stats->t_sort += timer.elapsedsec();
+    opts.stats->did_sort = did_sort;
+  }
+  return 0;
+}
+
+static int choose_nsubprobs(BIGINT M, BIGINT N, int did_sort,
+			    const spread_opts &opts)
+// number of subproblems into which to split M sorted NU pts for spreading
+// (dir=1) onto a size-N grid
+{
+  int nb = MIN(4*MY_OMP_GET_MAX_THREADS(),M);     // Choose # subprobs
+  if (nb*opts.max_subproblem_size<M)
+    nb = (M+opts.max_subproblem_size-1)/opts.max_subproblem_size;  // int div
+  if (M*1000<N) {         // low-density heuristic: one thread per NU pt!
+    nb = M;
+    if (opts.debug) printf("\tusing low-density speed rescue nb=M...\n");
+  }
+  if (!did_sort && MY_OMP_GET_MAX_THREADS()==1) {
+    nb = 1;
+    if (opts.debug) printf("\tforcing single subproblem...\n");
+  }
+  return nb;
+}
+
+static inline FLT sorted_coord(const FLT *k, BIGINT i,
+				const BIGINT *sort_indices, BIGINT N,
+				const spread_opts &opts)
+// rescaled coord, from the array k (stride opts.kstride), of the i'th NU pt
+// in sort_indices order; if opts.kpresorted, k already holds such coords,
+// contiguously (see spreadchecksort)
+{
+  return opts.kpresorted ? k[i] :
+    RESCALE(k[opts.kstride*sort_indices[i]],N,opts.pirange);
+}
+
+static inline BIGINT sorted_bin(BIGINT i, BIGINT *sort_indices, FLT *kx,
+				FLT *ky, FLT *kz, BIGINT N1, BIGINT N2, BIGINT N3,
+				BIGINT nbins1, BIGINT nbins2, const spread_opts &opts)
+// bin index (as in bin_sort_singlethread) of the i'th sorted NU pt
+{
+  BIGINT i1 = sorted_coord(kx,i,sort_indices,N1,opts)/opts.bin_size_x;
+  BIGINT i2 = 0, i3 = 0;
+  if (N2>1) i2 = sorted_coord(ky,i,sort_indices,N2,opts)/opts.bin_size_y;
+  if (N3>1) i3 = sorted_coord(kz,i,sort_indices,N3,opts)/opts.bin_size_z;
+  return i1 + nbins1*(i2 + nbins2*i3);
+}
+
+static double subprob_cost(BIGINT a, BIGINT b, BIGINT* sort_indices,
+			   BIGINT N1, BIGINT N2, BIGINT N3, FLT *kx, FLT *ky,
+			   FLT *kz, int ndims, const spread_opts &opts)
+/* Estimated cost of spreading the subproblem of sorted NU pts a<=i<b: its #
+   pts times the kernel box volume, plus the volume of its subgrid (which is
+   allocated, zeroed and added to the output), from the bounding box (as in
+   get_subgrid) of a sample of at most 64 of its pts, including the first and
+   last, so that the effort is O(1).
+*/
+{
+  BIGINT *N[3] = {&N1,&N2,&N3};
+  FLT *k[3] = {kx,ky,kz};
+  BIGINT nsamp = std::min(b-a,(BIGINT)64);
+  double vol = 1.0, kervol = 1.0;
+  for (int d=0; d<ndims; ++d) {
+    int ns = dim_ns(opts,d);
+    FLT lo = (FLT)*N[d], hi = 0.0;
+    for (BIGINT s=0; s<nsamp; ++s) {
+      BIGINT i = (nsamp>1) ? a + s*(b-1-a)/(nsamp-1) : a;
+      FLT x = sorted_coord(k[d],i,sort_indices,*N[d],opts);
+      lo = std::min(lo,x); hi = std::max(hi,x);
+    }
+    vol *= (hi-lo) + ns;
+    kervol *= ns;
+  }
+  return (b-a)*kervol + vol;
+}
+
+static void balance_subprobs(std::vector<BIGINT> &brk,
+			     std::vector<double> &cost, BIGINT* sort_indices,
+			     BIGINT N1, BIGINT N2, BIGINT N3, FLT *kx, FLT *ky,
+			     FLT *kz, const spread_opts &opts)
+/* Refines the breakpoints brk of equal-count subproblems of bin-sorted NU pts
+   (indices into sort_indices) so that no subproblem costs more than twice
+   the mean (see subprob_cost). This happens for clustered pts, where a
+   subproblem straddling sparse regions has a huge subgrid. Such subproblems
+   are split in two at the bin boundary nearest their middle, recursively,
+   until under the cap or within a single bin. Writes the estimated cost of
+   each final subproblem to cost. O(nb log M) effort.
+*/
+{
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  BIGINT nbins1 = N1/opts.bin_size_x+1, nbins2 = (N2>1) ? N2/opts.bin_size_y+1 : 1;
+  int nb = brk.size()-1;
+  std::vector<double> c0(nb);
+  double mean = 0.0, max0 = 0.0;
+  for (int p=0; p<nb; ++p) {
+    c0[p] = subprob_cost(brk[p],brk[p+1],sort_indices,N1,N2,N3,kx,ky,kz,ndims,opts);
+    mean += c0[p]/nb;
+    max0 = std::max(max0,c0[p]);
+  }
+  double cap = 2.0*mean;
+  std::vector<BIGINT> newbrk(1,0);
+  cost.clear();
+  std::vector<BIGINT> stack;           // pending [a,b) ranges, as pairs
+  std::vector<double> stackcost;       // (their costs)
+  for (int p=nb-1; p>=0; --p) {        // (pushed in reverse, so done in order)
+    stack.push_back(brk[p]); stack.push_back(brk[p+1]);
+    stackcost.push_back(c0[p]);
+  }
+  while (!stack.empty()) {
+    BIGINT b = stack.back(); stack.pop_back();
+    BIGINT a = stack.back(); stack.pop_back();
+    double c = stackcost.back(); stackcost.pop_back();
+    BIGINT ba = sorted_bin(a,sort_indices,kx,ky,kz,N1,N2,N3,nbins1,nbins2,opts);
+    BIGINT bb = sorted_bin(b-1,sort_indices,kx,ky,kz,N1,N2,N3,nbins1,nbins2,opts);
+    if (c<=cap || ba==bb) {            // keep this subproblem
+      newbrk.push_back(b);
+      cost.push_back(c);
+      continue;
+    }
+    BIGINT mid = a+(b-a)/2;            // split at a bin boundary near mid:
+    BIGINT bm = sorted_bin(mid,sort_indices,kx,ky,kz,N1,N2,N3,nbins1,nbins2,opts);
+    if (bm==ba) bm++;                  // (a bin after the first)
+    BIGINT lo = a, hi = b;             // find first index in [a,b) w/ bin>=bm
+    while (lo<hi) {
+      BIGINT m = lo+(hi-lo)/2;
+      if (sorted_bin(m,sort_indices,kx,ky,kz,N1,N2,N3,nbins1,nbins2,opts)<bm)
+	lo = m+1;
+      else
+	hi = m;
+    }                                  // (a<lo<b, since ba<bm<=bb)
+    if (lo<=a || lo>=b) {              // (unless bins not monotone; keep)
+      newbrk.push_back(b);
+      cost.push_back(c);
+      continue;
+    }
+    stack.push_back(lo); stack.push_back(b);
+    stackcost.push_back(subprob_cost(lo,b,sort_indices,N1,N2,N3,kx,ky,kz,ndims,opts));
+    stack.push_back(a); stack.push_back(lo);
+    stackcost.push_back(subprob_cost(a,lo,sort_indices,N1,N2,N3,kx,ky,kz,ndims,opts));
+  }
+  if (opts.debug) printf("\tbalanced subprobs: %d -> %d, max/mean cost %.3g -> %.3g\n",nb,(int)cost.size(),max0/mean,*std::max_element(cost.begin(),cost.end())/mean);
+  brk.swap(newbrk);
+}
+
 int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 		      FLT *data_nonuniform, spread_opts opts, int did_sort)
@@ -257,18 +831,39 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
    Split out by Melody Shih, Jun 2018.
 */
 {
+  return spreadwithsortidx_gen(sort_indices,N1,N2,N3,data_uniform,M,kx,ky,kz,
+			       data_nonuniform,data_nonuniform+1,
+			       2*opts.cstride,opts,did_sort);
+}
+
+static int spreadwithsortidx_gen(BIGINT* sort_indices, BIGINT N1, BIGINT N2,
+				 BIGINT N3, FLT *data_uniform, BIGINT M,
+				 FLT *kx, FLT *ky, FLT *kz, FLT *dre, FLT *dim,
+				 BIGINT cs, spread_opts opts, int did_sort)
+// Does the work of spreadwithsortidx, with the real and imag NU data at
+// dre[cs*j] and dim[cs*j] (FLT stride cs).
+{
+  thread_scope thrs(opts.nthreads);
   CNTime timer;
   int ndims = ndims_from_Ns(N1,N2,N3);
   BIGINT N=N1*N2*N3;            // output array size
   int ns=opts.nspread;          // abbrev. for w, kernel width
-  FLT ns2 = (FLT)ns/2;          // half spread width, used as stencil shift
+  // per-dim kernels (differ only if opts.aniso) and their widths...
+  spread_opts o[3] = {spread_dim_opts(opts,0), spread_dim_opts(opts,1),
+		       spread_dim_opts(opts,2)};
+  int ns1 = ns, ns2 = o[1].nspread, ns3 = o[2].nspread;
+  int nsd[3] = {ns1,ns2,ns3};
 
   if (opts.spread_direction==1) { // ========= direction 1 (spreading) =======
 
     timer.start();
-    for (BIGINT i=0; i<2*N; i++) // zero the output array. std::fill is no faster
-      data_uniform[i]=0.0;
-    if (opts.debug) printf("\tzero output array\t%.3g s\n",timer.elapsedsec());
+    if (!opts.accumulate) {     // zero the output array, static partition to
+#pragma omp parallel for schedule(static)   // match first touch & FFTW threads
+      for (BIGINT i=0; i<2*N; i++)
+        data_uniform[i]=0.0;
+      if (opts.debug) printf("\tzero output array\t%.3g s\n",timer.elapsedsec());
+    }
+    if (opts.stats) opts.stats->t_spread += timer.elapsedsec();
     if (M==0)                     // no NU pts, we're done
       return 0;
 
@@ -283,23 +878,30 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
 
     } else {               // ------- Fancy multi-core blocked t1 spreading ----
       // Split sorted inds (jfm's advanced2), could double RAM
-      int nb = MIN(4*MY_OMP_GET_MAX_THREADS(),M);     // Choose # subprobs
-      if (nb*opts.max_subproblem_size<M)
-        nb = (M+opts.max_subproblem_size-1)/opts.max_subproblem_size;  // int div
-      if (M*1000<N) {         // low-density heuristic: one thread per NU pt!
-        nb = M;
-        if (opts.debug) printf("\tusing low-density speed rescue nb=M...\n");
-      }
-      if (!did_sort && MY_OMP_GET_MAX_THREADS()==1) {
-        nb = 1;
-        if (opts.debug) printf("\tforcing single subproblem...\n");
-      }
+      int nb = choose_nsubprobs(M,N,did_sort,opts);
       std::vector<BIGINT> brk(nb+1); // NU index breakpoints defining subproblems
       for (int p=0;p<=nb;++p)
         brk[p] = (BIGINT)(0.5 + M*p/(double)nb);
+      std::vector<int> order(nb);    // order in which to do the subproblems
+      for (int p=0;p<nb;++p)
+        order[p] = p;
+      if (did_sort && nb>1 && nb<M) {  // split by spatial extent too, and
+        std::vector<double> cost;      // do largest first, to balance threads
+        balance_subprobs(brk,cost,sort_indices,N1,N2,N3,kx,ky,kz,opts);
+        nb = cost.size();
+        std::vector<std::pair<double,int> > byc(nb);  // (-cost, index)
+        for (int p=0;p<nb;++p)
+          byc[p] = std::make_pair(-cost[p],p);
+        std::sort(byc.begin(),byc.end());
+        order.resize(nb);
+        for (int p=0;p<nb;++p)
+          order[p] = byc[p].second;
+      }
+      double subbytes = 0.0;        // total bytes malloc'ed by subprobs
       
-#pragma omp parallel for schedule(dynamic,1)
-      for (int isub=0; isub<nb; isub++) {    // Main loop through the subproblems
+#pragma omp parallel for schedule(dynamic,1) reduction(+:subbytes)
+      for (int iord=0; iord<nb; iord++) {    // Main loop through the subproblems
+        int isub = order[iord];
         BIGINT M0 = brk[isub+1]-brk[isub];   // # NU pts in this subproblem
         // copy the location and data vectors for the nonuniform points
         FLT *kx0=(FLT*)malloc(sizeof(FLT)*M0), *ky0=NULL, *kz0=NULL;
@@ -310,15 +912,15 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
         FLT *dd0=(FLT*)malloc(sizeof(FLT)*M0*2);    // complex strength data
         for (BIGINT j=0; j<M0; j++) {           // todo: can avoid this copying?
           BIGINT kk=sort_indices[j+brk[isub]];  // NU pt from subprob index list
-          kx0[j]=RESCALE(kx[kk],N1,opts.pirange);
-          if (N2>1) ky0[j]=RESCALE(ky[kk],N2,opts.pirange);
-          if (N3>1) kz0[j]=RESCALE(kz[kk],N3,opts.pirange);
-          dd0[j*2]=data_nonuniform[kk*2];     // real part
-          dd0[j*2+1]=data_nonuniform[kk*2+1]; // imag part
+          kx0[j]=sorted_coord(kx,j+brk[isub],sort_indices,N1,opts);
+          if (N2>1) ky0[j]=sorted_coord(ky,j+brk[isub],sort_indices,N2,opts);
+          if (N3>1) kz0[j]=sorted_coord(kz,j+brk[isub],sort_indices,N3,opts);
+          dd0[j*2]=dre[kk*cs];                  // real part
+          dd0[j*2+1]=dim[kk*cs];                // imag part
         }
         // get the subgrid which will include padding by roughly nspread/2
         BIGINT offset1,offset2,offset3,size1,size2,size3; // get_subgrid sets
-        get_subgrid(offset1,offset2,offset3,size1,size2,size3,M0,kx0,ky0,kz0,ns,ndims);  // sets offsets and sizes
+        get_subgrid(offset1,offset2,offset3,size1,size2,size3,M0,kx0,ky0,kz0,nsd,ndims);  // sets offsets and sizes
         if (opts.debug>1) { // verbose
           if (ndims==1)
             printf("\tsubgrid: off %lld\t siz %lld\t #NU %lld\n",(long long)offset1,(long long)size1,(long long)M0);
@@ -334,6 +936,7 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
         }
         // allocate output data for this subgrid
         FLT *du0=(FLT*)malloc(sizeof(FLT)*2*size1*size2*size3); // complex
+        subbytes += sizeof(FLT)*((ndims+2)*M0 + 2*size1*size2*size3);
         
         // Spread to subgrid without need for bounds checking or wrapping
         if (!(opts.flags & TF_OMIT_SPREADING)) {
@@ -359,95 +962,122 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
         if (N3>1) free(kz0); 
       }     // end main loop over subprobs
       if (opts.debug) printf("\tt1 fancy spread: \t%.3g s (%d subprobs)\n",timer.elapsedsec(), nb);
+      if (opts.stats) {
+        opts.stats->nsubprobs += nb;
+        opts.stats->bytes_alloc += subbytes;
+      }
     }   // end of choice of which t1 spread type to use
     
   } else {          // ================= direction 2 (interpolation) ===========
     timer.start();
+#define CHUNKSIZE 16     // Chunks of Type 2 targets (Ludvig found by expt)
+    bool blk = (opts.kerevalmeth==1 && o[0].kerblock &&  // block kernel
+		(ndims<2 || o[1].kerblock) && (ndims<3 || o[2].kerblock));  // evals?
+    int chunk = blk ? KERBLOCK : CHUNKSIZE;     // (KERBLOCK>=CHUNKSIZE)
 #pragma omp parallel
     {
-#define CHUNKSIZE 16     // Chunks of Type 2 targets (Ludvig found by expt)
-      BIGINT jlist[CHUNKSIZE];
-      FLT xjlist[CHUNKSIZE], yjlist[CHUNKSIZE], zjlist[CHUNKSIZE];
-      FLT outbuf[2*CHUNKSIZE];
+      BIGINT jlist[KERBLOCK];
+      FLT xjlist[KERBLOCK], yjlist[KERBLOCK], zjlist[KERBLOCK];
+      FLT outbuf[2*KERBLOCK];
       // Kernels: static alloc is faster, so we do it for up to 3D...
-      FLT kernel_args[3*MAX_NSPREAD];
-      FLT kernel_values[3*MAX_NSPREAD];
+      FLT kernel_args[3*MAX_NSPREAD+4];     // (room for kerpad)
+      FLT kernel_values[3*MAX_NSPREAD+4];
       FLT *ker1 = kernel_values;
-      FLT *ker2 = kernel_values + ns;
-      FLT *ker3 = kernel_values + 2*ns;       
+      FLT *ker2 = kernel_values + ns1;
+      FLT *ker3 = kernel_values + ns1 + ns2;
+      FLT kerblk[3*KERBLOCK*KERBLOCK_MAXW];  // per-dim kernels for a chunk
 
       // Loop over interpolation chunks
 #pragma omp for schedule(dynamic) // assign threads to NU targ pts:
-      for (BIGINT i=0; i<M; i+=CHUNKSIZE)  // main loop over NU targs, interp each from U
+      for (BIGINT i=0; i<M; i+=chunk)  // main loop over NU targs, interp each from U
       {
         // Setup buffers for this chunk
-        int bufsize = (i+CHUNKSIZE > M) ? M-i : CHUNKSIZE;
+        int bufsize = (i+chunk > M) ? M-i : chunk;
         for (int ibuf=0; ibuf<bufsize; ibuf++) {
           BIGINT j = sort_indices[i+ibuf];
           jlist[ibuf] = j;
-          xjlist[ibuf] = RESCALE(kx[j],N1,opts.pirange);
+          xjlist[ibuf] = sorted_coord(kx,i+ibuf,sort_indices,N1,opts);
         }
         if (ndims==3) {
           for (int ibuf=0; ibuf<bufsize; ibuf++) {
-            BIGINT j = jlist[ibuf];
-            yjlist[ibuf] = RESCALE(ky[j],N2,opts.pirange);
-            zjlist[ibuf] = RESCALE(kz[j],N3,opts.pirange);                              
+            yjlist[ibuf] = sorted_coord(ky,i+ibuf,sort_indices,N2,opts);
+            zjlist[ibuf] = sorted_coord(kz,i+ibuf,sort_indices,N3,opts);
           }
         } else if (ndims==2) {
-          for (int ibuf=0; ibuf<bufsize; ibuf++) {
-            BIGINT j = jlist[ibuf];
-            yjlist[ibuf] = RESCALE(ky[j],N2,opts.pirange);
-          }
+          for (int ibuf=0; ibuf<bufsize; ibuf++)
+            yjlist[ibuf] = sorted_coord(ky,i+ibuf,sort_indices,N2,opts);
+        }
+        if (blk && !(opts.flags & TF_OMIT_SPREADING)) {   // kernels for chunk
+          eval_kernel_block_Horner(kerblk,xjlist,bufsize,ns1,o[0]);
+          if (ndims>1)
+            eval_kernel_block_Horner(kerblk+KERBLOCK*ns1,yjlist,bufsize,ns2,o[1]);
+          if (ndims>2)
+            eval_kernel_block_Horner(kerblk+KERBLOCK*(ns1+ns2),zjlist,bufsize,ns3,o[2]);
         }
         // Loop over targets in chunk
         for (int ibuf=0; ibuf<bufsize; ibuf++) {
           FLT xj = xjlist[ibuf];
           FLT *target = outbuf+2*ibuf;
+          if (blk) {                  // point to this targ's block kernels
+            ker1 = kerblk + ibuf*ns1;
+            ker2 = kerblk + KERBLOCK*ns1 + ibuf*ns2;
+            ker3 = kerblk + KERBLOCK*(ns1+ns2) + ibuf*ns3;
+          }
         
           // coords (x,y,z), spread block corner index (i1,i2,i3) of current NU targ
-          BIGINT i1=(BIGINT)std::ceil(xj-ns2); // leftmost grid index
+          BIGINT i1=(BIGINT)std::ceil(xj-(FLT)ns1/2); // leftmost grid index
           FLT x1=(FLT)i1-xj;           // shift of ker center, in [-w/2,-w/2+1]
           // eval kernel values patch and use to interpolate from uniform data...
           if (!(opts.flags & TF_OMIT_SPREADING)) {
             if (ndims==1) {                                          // 1D
               if (opts.kerevalmeth==0) {               // choose eval method
                 set_kernel_args(kernel_args, x1, opts);
-                evaluate_kernel_vector(kernel_values, kernel_args, opts, ns);
-              } else
-                eval_kernel_vec_Horner(ker1,x1,ns,opts);
-              interp_line(target,data_uniform,ker1,i1,N1,ns);
+                evaluate_kernel_vector(kernel_values, kernel_args, opts, ns1);
+              } else if (!blk)
+                eval_kernel_vec_Horner(ker1,x1,ns1,opts);
+              interp_line(target,data_uniform,ker1,i1,N1,ns1);
 
             } else if (ndims==2) {                                   // 2D
               FLT yj=yjlist[ibuf];
-              BIGINT i2=(BIGINT)std::ceil(yj-ns2); // min y grid index
+              BIGINT i2=(BIGINT)std::ceil(yj-(FLT)ns2/2); // min y grid index
               FLT x2=(FLT)i2-yj;
               if (opts.kerevalmeth==0) {               // choose eval method
-                set_kernel_args(kernel_args, x1, opts);
-                set_kernel_args(kernel_args+ns, x2, opts);
-                evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
-              } else {
-                eval_kernel_vec_Horner(ker1,x1,ns,opts);
-                eval_kernel_vec_Horner(ker2,x2,ns,opts);
+                set_kernel_args(kernel_args, x1, o[0]);
+                set_kernel_args(kernel_args+ns1, x2, o[1]);
+                if (opts.aniso) {                      // different betas
+                  evaluate_kernel_vector(ker1, kernel_args, o[0], ns1);
+                  evaluate_kernel_vector(ker2, kernel_args+ns1, o[1], ns2);
+                } else
+                  evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
+              } else if (!blk) {
+                eval_kernel_vec_Horner(ker1,x1,ns1,o[0]);
+                eval_kernel_vec_Horner(ker2,x2,ns2,o[1]);
               }
-              interp_square(target,data_uniform,ker1,ker2,i1,i2,N1,N2,ns);
+              interp_square(target,data_uniform,ker1,ker2,i1,i2,N1,N2,ns1,ns2);
             } else {                                                 // 3D
               FLT yj=yjlist[ibuf];
               FLT zj=zjlist[ibuf];
-              BIGINT i2=(BIGINT)std::ceil(yj-ns2); // min y grid index
-              BIGINT i3=(BIGINT)std::ceil(zj-ns2); // min z grid index
+              BIGINT i2=(BIGINT)std::ceil(yj-(FLT)ns2/2); // min y grid index
+              BIGINT i3=(BIGINT)std::ceil(zj-(FLT)ns3/2); // min z grid index
               FLT x2=(FLT)i2-yj;
               FLT x3=(FLT)i3-zj;
               if (opts.kerevalmeth==0) {               // choose eval method
-                set_kernel_args(kernel_args, x1, opts);
-                set_kernel_args(kernel_args+ns, x2, opts);
-                set_kernel_args(kernel_args+2*ns, x3, opts);
-                evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
-              } else {
-                eval_kernel_vec_Horner(ker1,x1,ns,opts);
-                eval_kernel_vec_Horner(ker2,x2,ns,opts);
-                eval_kernel_vec_Horner(ker3,x3,ns,opts);
+                set_kernel_args(kernel_args, x1, o[0]);
+                set_kernel_args(kernel_args+ns1, x2, o[1]);
+                set_kernel_args(kernel_args+ns1+ns2, x3, o[2]);
+                if (opts.aniso) {                      // different betas
+                  evaluate_kernel_vector(ker1, kernel_args, o[0], ns1);
+                  evaluate_kernel_vector(ker2, kernel_args+ns1, o[1], ns2);
+                  evaluate_kernel_vector(ker3, kernel_args+ns1+ns2, o[2], ns3);
+                } else
+                  evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
+              } else if (!blk) {
+                eval_kernel_vec_Horner(ker1,x1,ns1,o[0]);
+                eval_kernel_vec_Horner(ker2,x2,ns2,o[1]);
+                eval_kernel_vec_Horner(ker3,x3,ns3,o[2]);
               }
-              interp_cube(target,data_uniform,ker1,ker2,ker3,i1,i2,i3,N1,N2,N3,ns);
+              interp_cube(target,data_uniform,ker1,ker2,ker3,i1,i2,i3,N1,N2,N3,
+			  ns1,ns2,ns3);
             }
 	  }
         } // end loop over targets in chunk
@@ -455,14 +1085,407 @@ int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3,
         // Copy result buffer to output array
         for (int ibuf=0; ibuf<bufsize; ibuf++) {
           BIGINT j = jlist[ibuf];
-          data_nonuniform[2*j] = outbuf[2*ibuf];
-          data_nonuniform[2*j+1] = outbuf[2*ibuf+1];              
+          dre[cs*j] = outbuf[2*ibuf];
+          dim[cs*j] = outbuf[2*ibuf+1];
         }         
         
       }    // end NU targ loop
     } // end parallel section
     if (opts.debug) printf("\tt2 spreading loop: \t%.3g s\n",timer.elapsedsec());
+    if (opts.stats) opts.stats->nsubprobs += (M+chunk-1)/chunk;
+  }                           // ================= end direction choice ========
+  if (opts.stats) opts.stats->t_spread += timer.elapsedsec();
+  return 0;
+}
+
+double spreadkerprecomp_bytes(BIGINT M, int ndims, int ns)
+// RAM needed by spreadkerprecomp for M NU pts in ndims dims, kernel width ns
+{
+  return (double)M*ndims*(ns*sizeof(FLT) + sizeof(int));
+}
+
+int spreadkerprecomp(spread_kerprecomp &kp, BIGINT* sort_indices, BIGINT N1,
+		     BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		     spread_opts opts)
+/* Evaluates the kernel once at the M NU pts, for repeated spreads and/or
+   interps with spreadwithkerprecomp at the same pts. For each pt, in the
+   order given by sort_indices (as written by spreadsort), stores in kp its
+   ns kernel values in each dim and the leftmost grid index of its kernel
+   box, so that later calls do no kernel evaluation, just streaming
+   multiply-adds. The NU pts must already have been checked by spreadcheck.
+   See cnufftspread() for other input arguments.
+   Uses spreadkerprecomp_bytes(M,ndims,ns) bytes, which are added to
+   opts.stats->bytes_alloc (the time to t_spread). Free with
+   free_spreadkerprecomp. Isotropic kernels only (opts.aniso=0).
+   Returns 0, or ERR_SPREAD_ALLOC if could not allocate.
+*/
+{
+  thread_scope thrs(opts.nthreads);
+  CNTime timer; timer.start();
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int ns=opts.nspread;
+  FLT ns2 = (FLT)ns/2;
+  kp.M = M; kp.ndims = ndims; kp.ns = ns;
+  kp.ker = (FLT*)malloc(sizeof(FLT)*M*ndims*ns);
+  kp.i0 = (int*)malloc(sizeof(int)*M*ndims);
+  if (M>0 && (!kp.ker || !kp.i0)) {
+    fprintf(stderr,"spreadkerprecomp: could not allocate %.3g GB\n",spreadkerprecomp_bytes(M,ndims,ns)/1e9);
+    free_spreadkerprecomp(kp);
+    return ERR_SPREAD_ALLOC;
+  }
+  BIGINT Ns[3] = {N1,N2,N3};
+  FLT *ks[3] = {kx,ky,kz};
+  bool blk = (opts.kerevalmeth==1 && opts.kerblock);   // as the spreader
+#pragma omp parallel
+  {
+    FLT kernel_args[2*MAX_NSPREAD];      // (room for padding)
+    FLT kernel_values[2*MAX_NSPREAD];
+    FLT xjlist[KERBLOCK], kerblk[KERBLOCK*KERBLOCK_MAXW];
+#pragma omp for schedule(static)
+    for (BIGINT ib=0; ib<M; ib+=KERBLOCK) {       // blocks of pts
+      int n = std::min((BIGINT)KERBLOCK,M-ib);
+      for (int d=0; d<ndims; ++d) {
+        for (int b=0; b<n; b++)
+          xjlist[b] = sorted_coord(ks[d],ib+b,sort_indices,Ns[d],opts);
+        if (blk)
+          eval_kernel_block_Horner(kerblk,xjlist,n,ns,opts);
+        for (int b=0; b<n; b++) {
+          BIGINT i = ib+b;
+          FLT xj = xjlist[b];
+          BIGINT i1=(BIGINT)std::ceil(xj-ns2);  // leftmost grid index
+          FLT x1=(FLT)i1-xj;           // shift of ker center, in [-w/2,-w/2+1]
+          FLT *kv = kernel_values;
+          if (opts.kerevalmeth==0) {
+            set_kernel_args(kernel_args, x1, opts);
+            evaluate_kernel_vector(kernel_values, kernel_args, opts, ns);
+          } else if (blk)
+            kv = kerblk + b*ns;
+          else
+            eval_kernel_vec_Horner(kernel_values,x1,ns,opts);
+          FLT *ker = kp.ker + (i*ndims+d)*ns;
+          for (int dx=0; dx<ns; ++dx)
+            ker[dx] = kv[dx];
+          kp.i0[i*ndims+d] = (int)i1;
+        }
+      }
+    }
+  }
+  double bytes = spreadkerprecomp_bytes(M,ndims,ns);
+  if (opts.debug) printf("\tkernel precompute:\t%.3g s (%.3g MB)\n",timer.elapsedsec(),bytes/1e6);
+  if (opts.stats) {
+    opts.stats->t_spread += timer.elapsedsec();
+    opts.stats->bytes_alloc += bytes;
+  }
+  return 0;
+}
+
+void free_spreadkerprecomp(spread_kerprecomp &kp)
+{
+  free(kp.ker); free(kp.i0);
+  kp.ker = NULL; kp.i0 = NULL;
+  kp.M = 0;
+}
+
+static void spread_subproblem_kerprecomp(BIGINT N1, BIGINT N2, FLT *du,
+					 BIGINT M, const FLT *ker,
+					 const int *i0, const BIGINT *o,
+					 int ndims, int ns, const FLT *dd)
+/* spreader from NU strengths dd (size M complex, in sorted order) to du
+   (uniform subgrid of size N1*N2*N3, whose lowest corner is at o[] in the
+   output grid) without wrapping, using their precomputed kernel values ker
+   and leftmost grid indices i0 (as stored by spreadkerprecomp). Works in all
+   dims. du must be zeroed by the caller.
+*/
+{
+  for (BIGINT i=0; i<M; i++) {           // loop over NU pts
+    FLT re0 = dd[2*i];
+    FLT im0 = dd[2*i+1];
+    const FLT *ker1 = ker + i*ndims*ns;
+    const int *b = i0 + i*ndims;
+    BIGINT i1 = b[0] - o[0];             // subgrid-relative corner
+    // Combine kernel with complex source value to simplify inner loop
+    FLT ker1val[2*MAX_NSPREAD];
+    for (int dx=0; dx<ns; dx++) {
+      ker1val[2*dx] = re0*ker1[dx];
+      ker1val[2*dx+1] = im0*ker1[dx];
+    }
+    // critical inner loops:
+    if (ndims==1) {
+      FLT *trg = du+2*i1;
+      for (int dx=0; dx<2*ns; ++dx)
+	trg[dx] += ker1val[dx];
+    } else if (ndims==2) {
+      const FLT *ker2 = ker1 + ns;
+      BIGINT i2 = b[1] - o[1];
+      for (int dy=0; dy<ns; ++dy) {
+	FLT kerval = ker2[dy];
+	FLT *trg = du+2*(N1*(i2+dy) + i1);
+	for (int dx=0; dx<2*ns; ++dx)
+	  trg[dx] += kerval*ker1val[dx];
+      }
+    } else {
+      const FLT *ker2 = ker1 + ns, *ker3 = ker1 + 2*ns;
+      BIGINT i2 = b[1] - o[1], i3 = b[2] - o[2];
+      for (int dz=0; dz<ns; ++dz) {
+	BIGINT oz = N1*N2*(i3+dz);        // offset due to z
+	for (int dy=0; dy<ns; ++dy) {
+	  FLT kerval = ker2[dy]*ker3[dz];
+	  FLT *trg = du+2*(oz + N1*(i2+dy) + i1);
+	  for (int dx=0; dx<2*ns; ++dx)
+	    trg[dx] += kerval*ker1val[dx];
+	}
+      }
+    }
+  }
+}
+
+int spreadwithkerprecomp(const spread_kerprecomp &kp, BIGINT* sort_indices,
+			 BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
+			 FLT *data_nonuniform, spread_opts opts, int did_sort)
+/* As spreadwithsortidx, spreading (dir=1) or interpolating (dir=2), but
+   using the kernel values and grid indices stored by spreadkerprecomp for
+   the same NU pts, sort_indices and grid sizes N1,N2,N3, so that the NU pt
+   coords are not needed.
+   Return value should always be 0.
+*/
+{
+  thread_scope thrs(opts.nthreads);
+  CNTime timer;
+  int ndims = kp.ndims, ns = kp.ns;
+  BIGINT M = kp.M;
+  BIGINT cs = 2*opts.cstride;   // FLT stride of data_nonuniform
+  BIGINT N=N1*N2*N3;            // output array size
+
+  if (opts.spread_direction==1) { // ========= direction 1 (spreading) =======
+    timer.start();
+    if (!opts.accumulate)
+#pragma omp parallel for schedule(static)   // (as in spreadwithsortidx)
+      for (BIGINT i=0; i<2*N; i++)  // zero the output array
+        data_uniform[i]=0.0;
+    if (M==0) {                   // no NU pts, we're done
+      if (opts.stats) opts.stats->t_spread += timer.elapsedsec();
+      return 0;
+    }
+    int nb = choose_nsubprobs(M,N,did_sort,opts);
+    std::vector<BIGINT> brk(nb+1); // NU index breakpoints defining subproblems
+    for (int p=0;p<=nb;++p)
+      brk[p] = (BIGINT)(0.5 + M*p/(double)nb);
+    double subbytes = 0.0;        // total bytes malloc'ed by subprobs
+
+#pragma omp parallel for schedule(dynamic,1) reduction(+:subbytes)
+    for (int isub=0; isub<nb; isub++) {    // Main loop through the subproblems
+      BIGINT b0 = brk[isub], M0 = brk[isub+1]-b0;
+      // subgrid is the bounding box of the pts' kernel boxes
+      BIGINT o[3] = {0,0,0}, size[3] = {1,1,1};
+      for (int d=0; d<ndims; ++d) {
+        int lo = kp.i0[b0*ndims+d], hi = lo;
+        for (BIGINT i=1; i<M0; i++) {
+          int c = kp.i0[(b0+i)*ndims+d];
+          if (c<lo) lo = c;
+          if (c>hi) hi = c;
+        }
+        o[d] = lo;
+        size[d] = hi-lo+ns;
+      }
+      FLT *dd0=(FLT*)malloc(sizeof(FLT)*M0*2);    // complex strength data
+      for (BIGINT j=0; j<M0; j++) {      // (gathering first is faster)
+        BIGINT kk=sort_indices[j+b0];
+        dd0[j*2]=data_nonuniform[kk*cs];
+        dd0[j*2+1]=data_nonuniform[kk*cs+1];
+      }
+      BIGINT nsub = size[0]*size[1]*size[2];
+      FLT *du0=(FLT*)calloc(2*nsub,sizeof(FLT)); // complex, zeroed
+      subbytes += sizeof(FLT)*2*(M0+nsub);
+      if (!(opts.flags & TF_OMIT_SPREADING))
+        spread_subproblem_kerprecomp(size[0],size[1],du0,M0,kp.ker+b0*ndims*ns,
+				     kp.i0+b0*ndims,o,ndims,ns,dd0);
+#pragma omp critical
+      {  // do the adding of subgrid to output; only here threads cannot clash
+        if (!(opts.flags & TF_OMIT_WRITE_TO_GRID))
+          add_wrapped_subgrid(o[0],o[1],o[2],size[0],size[1],size[2],N1,N2,N3,data_uniform,du0);
+      }
+      free(dd0);
+      free(du0);
+    }     // end main loop over subprobs
+    if (opts.debug) printf("\tt1 precomp spread: \t%.3g s (%d subprobs)\n",timer.elapsedsec(), nb);
+    if (opts.stats) {
+      opts.stats->nsubprobs += nb;
+      opts.stats->bytes_alloc += subbytes;
+    }
+
+  } else {          // ================= direction 2 (interpolation) ===========
+    timer.start();
+#pragma omp parallel for schedule(dynamic,CHUNKSIZE)
+    for (BIGINT i=0; i<M; i++) {        // loop over NU targs in sorted order
+      BIGINT j = sort_indices[i];
+      FLT *ker1 = kp.ker + i*ndims*ns;
+      const int *b = kp.i0 + i*ndims;
+      FLT *target = data_nonuniform + cs*j;
+      if (!(opts.flags & TF_OMIT_SPREADING)) {
+        if (ndims==1)
+          interp_line(target,data_uniform,ker1,b[0],N1,ns);
+        else if (ndims==2)
+          interp_square(target,data_uniform,ker1,ker1+ns,b[0],b[1],N1,N2,ns,ns);
+        else
+          interp_cube(target,data_uniform,ker1,ker1+ns,ker1+2*ns,b[0],b[1],b[2],
+		      N1,N2,N3,ns,ns,ns);
+      }
+    }
+    if (opts.debug) printf("\tt2 precomp interp: \t%.3g s\n",timer.elapsedsec());
+    if (opts.stats) opts.stats->nsubprobs += (M+CHUNKSIZE-1)/CHUNKSIZE;
   }                           // ================= end direction choice ========
+  if (opts.stats) opts.stats->t_spread += timer.elapsedsec();
+  return 0;
+}
+
+static inline void interp_multi(FLT *out, FLT *du, FLT *ker1, FLT *ker2,
+				FLT *ker3, BIGINT i1, BIGINT i2, BIGINT i3,
+				BIGINT N1, BIGINT N2, BIGINT N3, int ns,
+				int ndims, int ndata)
+// Interpolates ndata complex values from ndata interleaved grids du (ie
+// complex element j of grid d is du[2*(j*ndata+d)], real then imag) to out
+// (size 2*ndata), using the tensor product of real weights ker1,ker2,ker3
+// (only the first ndims used) on the box with left-most indices i1,i2,i3,
+// with periodic wrapping. Each weight is formed once for all the grids, whose
+// values at a grid point are adjacent in memory. Called with literal ndata so
+// that, once inlined, acc is held in registers and the d loop vectorizes.
+{
+  int nd2 = 2*ndata;
+  FLT acc[2*MAX_INTERP_NDATA];     // (local, so not aliased with du)
+  for (int d=0; d<nd2; ++d) acc[d] = 0.0;
+  int ns2 = (ndims>1) ? ns : 1, ns3 = (ndims>2) ? ns : 1;
+  if (ndims<2) i2 = 0;
+  if (ndims<3) i3 = 0;
+  BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD], j3[MAX_NSPREAD];   // 1d ptr lists
+  BIGINT x=i1, y=i2, z=i3;
+  for (int d=0; d<ns; d++) {          // set up ptr lists (wrapped indices)
+    if (x<0) x+=N1;
+    if (x>=N1) x-=N1;
+    j1[d] = x++;
+  }
+  for (int d=0; d<ns2; d++) {
+    if (y<0) y+=N2;
+    if (y>=N2) y-=N2;
+    j2[d] = y++;
+  }
+  for (int d=0; d<ns3; d++) {
+    if (z<0) z+=N3;
+    if (z>=N3) z-=N3;
+    j3[d] = z++;
+  }
+  int nowrap = (i1>=0 && i1+ns<=N1);        // x rows contiguous in du
+  for (int dz=0; dz<ns3; dz++) {
+    BIGINT oz = N1*N2*j3[dz];               // offset due to z
+    FLT k3 = (ndims>2) ? ker3[dz] : 1.0;
+    for (int dy=0; dy<ns2; dy++) {
+      BIGINT oy = oz + N1*j2[dy];           // offset due to y & z
+      FLT ker23 = (ndims>1) ? ker2[dy]*k3 : k3;
+      if (nowrap) {
+	FLT *p = du + nd2*(oy + i1);
+	for (int dx=0; dx<ns; dx++) {
+	  FLT k = ker1[dx]*ker23;
+#pragma omp simd
+	  for (int d=0; d<nd2; ++d)
+	    acc[d] += p[d] * k;
+	  p += nd2;
+	}
+      } else
+	for (int dx=0; dx<ns; dx++) {
+	  FLT k = ker1[dx]*ker23;
+	  FLT *p = du + nd2*(oy + j1[dx]);
+#pragma omp simd
+	  for (int d=0; d<nd2; ++d)
+	    acc[d] += p[d] * k;
+	}
+    }
+  }
+  for (int d=0; d<nd2; ++d) out[d] = acc[d];
+}
+
+int interpmultiwithsortidx(BIGINT* sort_indices, BIGINT N1, BIGINT N2,
+			   BIGINT N3, int ndata, FLT *data_uniform, BIGINT M,
+			   FLT *kx, FLT *ky, FLT *kz, FLT **data_nonuniform,
+			   spread_opts opts)
+/* Interpolation (as spreadwithsortidx with dir=2) from ndata uniform grids at
+   the same NU pts in a single pass, so that the kernel is evaluated, and each
+   tensor-product weight formed, only once per NU pt and grid point for all
+   the grids. The ndata grids are interleaved in data_uniform (size
+   2*ndata*N1*N2*N3, ie the ndata complex values at each grid point are
+   adjacent), and the output values from grid d are written to
+   data_nonuniform[d] (each complex of size M). sort_indices is as written by
+   spreadsort. See cnufftspread() for other input arguments. Isotropic
+   kernels only (opts.aniso=0).
+   Returns 0, or ERR_NDATA_NOTVALID if ndata is not in [1,MAX_INTERP_NDATA].
+*/
+{
+  if (ndata<1 || ndata>MAX_INTERP_NDATA) {
+    fprintf(stderr,"interpmultiwithsortidx: ndata=%d not in [1,%d]\n",ndata,MAX_INTERP_NDATA);
+    return ERR_NDATA_NOTVALID;
+  }
+  thread_scope thrs(opts.nthreads);
+  CNTime timer; timer.start();
+  int ndims = ndims_from_Ns(N1,N2,N3);
+  int ns=opts.nspread;          // abbrev. for w, kernel width
+  FLT ns2 = (FLT)ns/2;          // half spread width, used as stencil shift
+  BIGINT Ns[3] = {N1,N2,N3};
+  FLT *ks[3] = {kx,ky,kz};
+  bool blk = (opts.kerevalmeth==1 && opts.kerblock);   // as interp
+#pragma omp parallel
+  {
+    FLT kernel_args[3*MAX_NSPREAD];
+    FLT kernel_values[3*MAX_NSPREAD];
+    FLT xjlist[KERBLOCK], kerblk[3*KERBLOCK*KERBLOCK_MAXW];
+    FLT out[2*MAX_INTERP_NDATA];
+#pragma omp for schedule(dynamic)
+    for (BIGINT ib=0; ib<M; ib+=KERBLOCK) {   // blocks of NU targs, sorted order
+      int n = std::min((BIGINT)KERBLOCK,M-ib);
+      if (blk)                          // kernels for whole block, each dim
+        for (int d=0; d<ndims; ++d) {
+          for (int b=0; b<n; b++)
+            xjlist[b] = sorted_coord(ks[d],ib+b,sort_indices,Ns[d],opts);
+          eval_kernel_block_Horner(kerblk+d*KERBLOCK*ns,xjlist,n,ns,opts);
+        }
+      for (BIGINT i=ib; i<ib+n; i++) {
+        BIGINT j = sort_indices[i];
+        BIGINT i0[3] = {0,0,0};         // leftmost grid index in each dim
+        FLT *ker[3] = {kernel_values, kernel_values+ns, kernel_values+2*ns};
+        for (int d=0; d<ndims; ++d) {
+          FLT xj = sorted_coord(ks[d],i,sort_indices,Ns[d],opts);
+          i0[d] = (BIGINT)std::ceil(xj-ns2);
+          FLT x1 = (FLT)i0[d]-xj;
+          if (opts.kerevalmeth==0) {
+            set_kernel_args(kernel_args+d*ns, x1, opts);
+            evaluate_kernel_vector(kernel_values+d*ns, kernel_args+d*ns, opts, ns);
+          } else if (blk)
+            ker[d] = kerblk + (d*KERBLOCK + i-ib)*ns;
+          else
+            eval_kernel_vec_Horner(kernel_values+d*ns,x1,ns,opts);
+        }
+        if (opts.flags & TF_OMIT_SPREADING) continue;
+        if (ndata==1)
+          interp_multi(out,data_uniform,ker[0],ker[1],ker[2],i0[0],i0[1],
+                       i0[2],N1,N2,N3,ns,ndims,1);
+        else if (ndata==2)
+          interp_multi(out,data_uniform,ker[0],ker[1],ker[2],i0[0],i0[1],
+                       i0[2],N1,N2,N3,ns,ndims,2);
+        else if (ndata==3)
+          interp_multi(out,data_uniform,ker[0],ker[1],ker[2],i0[0],i0[1],
+                       i0[2],N1,N2,N3,ns,ndims,3);
+        else
+          interp_multi(out,data_uniform,ker[0],ker[1],ker[2],i0[0],i0[1],
+                       i0[2],N1,N2,N3,ns,ndims,4);
+        for (int d=0; d<ndata; ++d) {
+          data_nonuniform[d][2*j] = out[2*d];
+          data_nonuniform[d][2*j+1] = out[2*d+1];
+        }
+      }
+    }
+  }
+  if (opts.debug) printf("\tt2 multi interp (%d grids):\t%.3g s\n",ndata,timer.elapsedsec());
+  if (opts.stats) {
+    opts.stats->nsubprobs += (M+KERBLOCK-1)/KERBLOCK;
+    opts.stats->t_spread += timer.elapsedsec();
+  }
   return 0;
 }
 
@@ -481,10 +1504,7 @@ int setup_spreader(spread_opts &opts,FLT eps,FLT upsampfac, int kerevalmeth)
     return ERR_EPS_TOO_SMALL;
   }
   if (upsampfac!=2.0 && upsampfac!=1.25) {   // nonstandard sigma
-    if (kerevalmeth==1) {
-      fprintf(stderr,"setup_spreader: nonstandard upsampfac=%.3g cannot be handled by kerevalmeth=1\n",(double)upsampfac);
-      return HORNER_WRONG_BETA;
-    }
+    // (kerevalmeth=1 then uses Horner coeffs fitted below, not generated code)
     if (upsampfac<=1.0) {
       fprintf(stderr,"setup_spreader: error, upsampfac=%.3g is <=1.0\n",(double)upsampfac);
       return ERR_UPSAMPFAC_TOO_SMALL;
@@ -496,6 +1516,10 @@ int setup_spreader(spread_opts &opts,FLT eps,FLT upsampfac, int kerevalmeth)
     
   // defaults... (user can change after this function called)
   opts.spread_direction = 1;    // user should always set to 1 or 2 as desired
+  opts.accumulate = 0;          // 0: spreading overwrites output array
+  opts.kpresorted = 0;          // 0: NU coords are the user's, unsorted
+  opts.kstride = 1;             // NU coords and strengths contiguous
+  opts.cstride = 1;
   opts.pirange = 1;             // user also should always set this
   opts.chkbnds = 1;
   opts.sort = 2;                // 2:auto-choice
@@ -503,9 +1527,14 @@ int setup_spreader(spread_opts &opts,FLT eps,FLT upsampfac, int kerevalmeth)
   opts.kerevalmeth = kerevalmeth;
   opts.upsampfac = upsampfac;
   opts.sort_threads = 0;        // 0:auto-choice
+  opts.nthreads = 0;            // 0:all available
   opts.max_subproblem_size = (BIGINT)1e4;  // was larger (1e5, slightly worse)
+  opts.bin_size_x = 16;         // bin sizes tuned on 2017 i7; see autotune.cpp
+  opts.bin_size_y = 4;
+  opts.bin_size_z = 4;
   opts.flags = 0;               // 0:no timing flags
   opts.debug = 0;               // 0:no debug output
+  opts.stats = NULL;            // NULL:no stats accumulated
 
   // Set kernel width w (aka ns) and ES kernel beta parameter, in opts...
   int ns = std::ceil(-log10(eps/(FLT)10.0));   // 1 digit per power of ten
@@ -530,10 +1559,59 @@ int setup_spreader(spread_opts &opts,FLT eps,FLT upsampfac, int kerevalmeth)
     betaoverns = gamma*PI*(1-1/(2*upsampfac));  // formula based on cutoff
   }
   opts.ES_beta = betaoverns * (FLT)ns;    // set the kernel beta parameter
+  opts.horner_coeffs = NULL;
+  opts.horner_degree = 0;
+  opts.kerblock = (kerevalmeth==1 && ns<=KERBLOCK_MAXW);  // needs coeff table
+  if (kerevalmeth==1 && (opts.kerblock || (upsampfac!=2.0 && upsampfac!=1.25)))
+    opts.horner_coeffs = get_horner_coeffs(ns,opts.ES_beta,&opts.horner_degree);
   //fprintf(stderr,"setup_spreader: eps=%.3g sigma=%.6f, chose ns=%d beta=%.6f\n",(double)eps,(double)upsampfac,ns,(double)opts.ES_beta); // user hasn't set debug yet
+  spread_kernel k = {ns, upsampfac, opts.ES_beta, opts.ES_halfwidth, opts.ES_c,
+		     opts.horner_coeffs, opts.horner_degree, opts.kerblock};
+  opts.aniso = 0;               // same kernel in all dims
+  for (int d=0; d<3; ++d) opts.dimker[d] = k;
   return 0;
 }
 
+int setup_spreader_dims(spread_opts &opts, FLT eps, const FLT *upsampfacs,
+			int ndims, int kerevalmeth)
+/* As setup_spreader, but with upsampling factor upsampfacs[d] in each dim
+   d<ndims, each dim getting the kernel width and beta which that sigma needs
+   to reach eps. Used for anisotropic (eg high aspect ratio) problems, where a
+   smaller sigma, and so a wider kernel, in a long dim can cut the fine grid
+   size and so the FFT cost more than the spreading cost grows. The x kernel
+   is that in the usual fields of opts; all are in opts.dimker, and opts.aniso
+   is set if they differ. Unused dims get the x kernel.
+   Returns as setup_spreader.
+*/
+{
+  int ier = setup_spreader(opts,eps,upsampfacs[0],kerevalmeth);
+  for (int d=1; d<ndims && !ier; ++d)
+    if (upsampfacs[d]!=upsampfacs[0]) {
+      spread_opts o;
+      ier = setup_spreader(o,eps,upsampfacs[d],kerevalmeth);
+      opts.dimker[d] = o.dimker[0];
+      opts.aniso = 1;
+    }
+  return ier;
+}
+
+spread_opts spread_dim_opts(const spread_opts &opts, int d)
+// Copy of opts whose kernel fields (nspread, beta, etc) are those of dim d,
+// for evaluating that dim's kernel with the usual routines. If anisotropic,
+// kerpad is turned off, since per-dim kernel vectors are packed contiguously.
+{
+  spread_opts o = opts;
+  if (opts.aniso) {
+    o.kerpad = 0;
+    const spread_kernel &k = opts.dimker[d];
+    o.nspread = k.nspread; o.upsampfac = k.upsampfac;
+    o.ES_beta = k.ES_beta; o.ES_halfwidth = k.ES_halfwidth; o.ES_c = k.ES_c;
+    o.horner_coeffs = k.horner_coeffs; o.horner_degree = k.horner_degree;
+    o.kerblock = k.kerblock;
+  }
+  return o;
+}
+
 FLT evaluate_kernel(FLT x, const spread_opts &opts)
 /* ES ("exp sqrt") kernel evaluation at single real argument:
       phi(x) = exp(beta.sqrt(1 - (2x/n_s)^2)),    for |x| < nspread/2
@@ -610,7 +1688,9 @@ static inline void eval_kernel_vec_Horner(FLT *ker, const FLT x, const int w,
 /* Fill ker[] with Horner piecewise poly approx to [-w/2,w/2] ES kernel eval at
    x_j = x + j,  for j=0,..,w-1.  Thus x in [-w/2,-w/2+1].   w is aka ns.
    This is the current evaluation method, since it's faster (except i7 w=16).
-   Two upsampfacs implemented. Params must match ref formula. Barnett 4/24/18 */
+   Two upsampfacs implemented. Params must match ref formula. Barnett 4/24/18
+   Other upsampfacs use coeffs fitted by setup_spreader (get_horner_coeffs).
+   For w<=KERBLOCK_MAXW (opts.kerblock) eval_kernel_block_Horner is used. */
 {
   if (!(opts.flags & TF_OMIT_EVALUATE_KERNEL)) {
     FLT z = 2*x + w - 1.0;         // scale so local grid offset z in [-1,1]
@@ -619,11 +1699,142 @@ static inline void eval_kernel_vec_Horner(FLT *ker, const FLT x, const int w,
 #include "ker_horner_allw_loop.c"
     } else if (opts.upsampfac==1.25) {
 #include "ker_lowupsampfac_horner_allw_loop.c"
+    } else if (opts.horner_coeffs) {         // coeffs fitted in setup_spreader
+      int d = opts.horner_degree, wpad = 4*(1+(w-1)/4);
+      const FLT *c = opts.horner_coeffs;
+      for (int i=0; i<wpad; i++) ker[i] = c[d*wpad+i];
+      for (int n=d-1; n>=0; n--)               // Horner, vectorized over i
+	for (int i=0; i<wpad; i++) ker[i] = c[n*wpad+i] + z*ker[i];
     } else
       fprintf(stderr,"eval_kernel_vec_Horner: unknown upsampfac, failed!\n");
   }
 }
 
+static inline void eval_kernel_block_w(FLT *ker, const FLT *z, const FLT *c,
+				       const int w, const int d)
+/* Horner for a block of KERBLOCK pts with local offsets z, writing ker[j*w+i].
+   Called with literal w and d so that, once inlined, the loops over offsets i
+   and powers are fully unrolled and only the loop over pts j is vectorized. */
+{
+  int wpad = 4*(1+(w-1)/4);
+  for (int i=0; i<w; i++) {
+    FLT k[KERBLOCK];
+    for (int j=0; j<KERBLOCK; j++) k[j] = c[d*wpad+i];
+    for (int m=d-1; m>=0; m--) {
+      FLT cm = c[m*wpad+i];
+      for (int j=0; j<KERBLOCK; j++) k[j] = cm + z[j]*k[j];
+    }
+    for (int j=0; j<KERBLOCK; j++) ker[j*w+i] = k[j];
+  }
+}
+
+static inline void eval_kernel_block_Horner(FLT *ker, const FLT *xj,
+					    const int n, const int w,
+					    const spread_opts &opts)
+/* Fill ker[j*w+i] with Horner piecewise poly approx to [-w/2,w/2] ES kernel
+   eval at x_j + i, for i=0,..,w-1, where x_j = ceil(xj[j]-w/2) - xj[j] is the
+   shift of the kernel center of NU pt coord xj[j], for each of the n<=KERBLOCK
+   pts j=0,..,n-1. ker must have room for KERBLOCK*w values. Same as n calls to
+   eval_kernel_vec_Horner using the fitted coeffs opts.horner_coeffs, but
+   vectorized across pts (one SIMD lane per pt), so that for small w no lanes
+   are spent on the zero padding of w to 4 or 8.
+*/
+{
+  if (opts.flags & TF_OMIT_EVALUATE_KERNEL) return;
+  int d = opts.horner_degree;
+  const FLT *c = opts.horner_coeffs;
+  FLT w2 = (FLT)w/2;
+  FLT z[KERBLOCK];
+  for (int j=0; j<n; j++) {        // local offset z in [-1,1], as in vec_Horner
+    FLT x = (FLT)(BIGINT)std::ceil(xj[j]-w2) - xj[j];
+    z[j] = 2*x + w - 1.0;
+  }
+  for (int j=n; j<KERBLOCK; j++) z[j] = 0.0;
+  if (d==w+3)                      // the degree get_horner_coeffs uses for w<=8
+    switch (w) {
+    case 2: eval_kernel_block_w(ker,z,c,2,5); return;
+    case 3: eval_kernel_block_w(ker,z,c,3,6); return;
+    case 4: eval_kernel_block_w(ker,z,c,4,7); return;
+    case 5: eval_kernel_block_w(ker,z,c,5,8); return;
+    case 6: eval_kernel_block_w(ker,z,c,6,9); return;
+    }
+  eval_kernel_block_w(ker,z,c,w,d);           // generic (not unrolled)
+}
+
+struct horner_fit {           // one cached set of fitted coeffs
+  int w, d;
+  FLT beta;
+  FLT *c;
+};
+static std::vector<horner_fit> horner_cache;
+
+static FLT* get_horner_coeffs(int w, FLT beta, int *d)
+/* Returns coeffs for Horner piecewise poly approx to the width-w ES kernel with
+   parameter beta, as used by eval_kernel_vec_Horner, and the degree in *d.
+   This does at run time what devel/gen_all_horner_C_code.m does offline, so
+   that kerevalmeth=1 works for any upsampfac. For each of the w unit-width
+   segments, the degree-d interpolant at d+1 Chebyshev nodes in the local
+   variable z in [-1,1] is found by solving the Vandermonde system by Gaussian
+   elimination (backward stable, so values are accurate even though the
+   monomial coeffs may not be). Output array is c[n*wpad+i] for power n and
+   segment i, with wpad = w padded to a multiple of 4 (padding coeffs zero).
+   Results are cached per (w,beta), and the array is never freed. Thread-safe.
+*/
+{
+  *d = w + 2 + (w<=8);                      // as for sigma=2 generated code
+  int n = *d + 1, wpad = 4*(1+(w-1)/4);
+  FLT *c = NULL;
+#pragma omp critical (finufft_horner)
+  {
+    for (size_t k=0; k<horner_cache.size(); ++k)
+      if (horner_cache[k].w==w && horner_cache[k].beta==beta) {
+        c = horner_cache[k].c; *d = horner_cache[k].d;
+      }
+    if (!c) {
+      std::vector<double> V(n*n), R(n*w), z(n);
+      for (int j=0; j<n; ++j) z[j] = cos(M_PI*(j+0.5)/n);  // Chebyshev nodes
+      for (int j=0; j<n; ++j) {             // Vandermonde V[j][k] = z_j^k
+	V[j*n] = 1.0;
+	for (int k=1; k<n; ++k) V[j*n+k] = V[j*n+k-1]*z[j];
+      }
+      double h = 1.0/w;                     // half a grid spacing, t units
+      for (int i=0; i<w; ++i)               // RHS: kernel at t = xi + z h
+	for (int j=0; j<n; ++j) {
+	  double t = -1.0 + h*(2*i+1) + h*z[j];
+	  double s = 1.0 - t*t;
+	  R[j*w+i] = exp((double)beta*sqrt(s>0.0 ? s : 0.0));
+	}
+      for (int k=0; k<n; ++k) {             // GE with partial pivoting
+	int p = k;
+	for (int j=k+1; j<n; ++j)
+	  if (fabs(V[j*n+k])>fabs(V[p*n+k])) p = j;
+	if (p!=k) {
+	  for (int l=0; l<n; ++l) std::swap(V[k*n+l],V[p*n+l]);
+	  for (int i=0; i<w; ++i) std::swap(R[k*w+i],R[p*w+i]);
+	}
+	for (int j=k+1; j<n; ++j) {
+	  double f = V[j*n+k]/V[k*n+k];
+	  for (int l=k; l<n; ++l) V[j*n+l] -= f*V[k*n+l];
+	  for (int i=0; i<w; ++i) R[j*w+i] -= f*R[k*w+i];
+	}
+      }
+      for (int k=n-1; k>=0; --k)            // back-substitute, all RHS
+	for (int i=0; i<w; ++i) {
+	  double r = R[k*w+i];
+	  for (int l=k+1; l<n; ++l) r -= V[k*n+l]*R[l*w+i];
+	  R[k*w+i] = r/V[k*n+k];
+	}
+      c = (FLT*)calloc(n*wpad,sizeof(FLT));
+      for (int k=0; k<n; ++k)
+	for (int i=0; i<w; ++i)
+	  c[k*wpad+i] = (FLT)R[k*w+i];
+      horner_fit f = {w, *d, beta, c};
+      horner_cache.push_back(f);
+    }
+  }
+  return c;
+}
+
 void interp_line(FLT *target,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns)
 // 1D interpolate complex values from du array to out, using real weights
 // ker[0] through ker[ns-1]. out must be size 2 (real,imag), and du
@@ -670,21 +1881,21 @@ void interp_line(FLT *target,FLT *du, FLT *ker,BIGINT i1,BIGINT N1,int ns)
   target[1] = out[1];
 }
 
-void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns)
+void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i2,BIGINT N1,BIGINT N2,int ns1,int ns2)
 // 2D interpolate complex values from du (uniform grid data) array to out value,
-// using ns*ns square of real weights
+// using ns1*ns2 rectangle of real weights
 // in ker. out must be size 2 (real,imag), and du
 // of size 2*N1*N2 (alternating real,imag). i1 is the left-most index in [0,N1)
 // and i2 the bottom index in [0,N2).
-// Periodic wrapping in the du array is applied, assuming N1,N2>=ns.
+// Periodic wrapping in the du array is applied, assuming N1>=ns1, N2>=ns2.
 // dx,dy indices into ker array, j index in complex du array.
-// Barnett 6/16/17
+// Barnett 6/16/17; per-dim widths ns1,ns2 for anisotropic kernels.
 {
   FLT out[] = {0.0, 0.0};
-  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2) {  // no wrapping: avoid ptrs
-    for (int dy=0; dy<ns; dy++) {
+  if (i1>=0 && i1+ns1<=N1 && i2>=0 && i2+ns2<=N2) {  // no wrapping: avoid ptrs
+    for (int dy=0; dy<ns2; dy++) {
       BIGINT j = N1*(i2+dy) + i1;
-      for (int dx=0; dx<ns; dx++) {
+      for (int dx=0; dx<ns1; dx++) {
 	FLT k = ker1[dx]*ker2[dy];
 	out[0] += du[2*j] * k;
 	out[1] += du[2*j+1] * k;
@@ -694,17 +1905,19 @@ void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i
   } else {                         // wraps somewhere: use ptr list (slower)
     BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD];   // 1d ptr lists
     BIGINT x=i1, y=i2;                 // initialize coords
-    for (int d=0; d<ns; d++) {         // set up ptr lists
+    for (int d=0; d<ns1; d++) {        // set up ptr lists
       if (x<0) x+=N1;
       if (x>=N1) x-=N1;
       j1[d] = x++;
+    }
+    for (int d=0; d<ns2; d++) {
       if (y<0) y+=N2;
       if (y>=N2) y-=N2;
       j2[d] = y++;
     }
-    for (int dy=0; dy<ns; dy++) {      // use the pts lists
+    for (int dy=0; dy<ns2; dy++) {      // use the pts lists
       BIGINT oy = N1*j2[dy];           // offset due to y
-      for (int dx=0; dx<ns; dx++) {
+      for (int dx=0; dx<ns1; dx++) {
 	FLT k = ker1[dx]*ker2[dy];
 	BIGINT j = oy + j1[dx];
 	out[0] += du[2*j] * k;
@@ -717,25 +1930,26 @@ void interp_square(FLT *target,FLT *du, FLT *ker1, FLT *ker2, BIGINT i1,BIGINT i
 }
 
 void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
-		 BIGINT i1,BIGINT i2,BIGINT i3, BIGINT N1,BIGINT N2,BIGINT N3,int ns)
+		 BIGINT i1,BIGINT i2,BIGINT i3, BIGINT N1,BIGINT N2,BIGINT N3,
+		 int ns1,int ns2,int ns3)
 // 3D interpolate complex values from du (uniform grid data) array to out value,
-// using ns*ns*ns cube of real weights
+// using ns1*ns2*ns3 box of real weights
 // in ker. out must be size 2 (real,imag), and du
 // of size 2*N1*N2*N3 (alternating real,imag). i1 is the left-most index in
 // [0,N1), i2 the bottom index in [0,N2), i3 lowest in [0,N3).
-// Periodic wrapping in the du array is applied, assuming N1,N2,N3>=ns.
+// Periodic wrapping in the du array is applied, assuming each Nd>=nsd.
 // dx,dy,dz indices into ker array, j index in complex du array.
-// Barnett 6/16/17
+// Barnett 6/16/17; per-dim widths for anisotropic kernels.
 {
   FLT out[] = {0.0, 0.0};  
-  if (i1>=0 && i1+ns<=N1 && i2>=0 && i2+ns<=N2 && i3>=0 && i3+ns<=N3) {
+  if (i1>=0 && i1+ns1<=N1 && i2>=0 && i2+ns2<=N2 && i3>=0 && i3+ns3<=N3) {
     // no wrapping: avoid ptrs
-    for (int dz=0; dz<ns; dz++) {
+    for (int dz=0; dz<ns3; dz++) {
       BIGINT oz = N1*N2*(i3+dz);        // offset due to z
-      for (int dy=0; dy<ns; dy++) {
+      for (int dy=0; dy<ns2; dy++) {
 	BIGINT j = oz + N1*(i2+dy) + i1;
 	FLT ker23 = ker2[dy]*ker3[dz];
-	for (int dx=0; dx<ns; dx++) {
+	for (int dx=0; dx<ns1; dx++) {
 	  FLT k = ker1[dx]*ker23;
 	  out[0] += du[2*j] * k;
 	  out[1] += du[2*j+1] * k;
@@ -746,23 +1960,27 @@ void interp_cube(FLT *target,FLT *du, FLT *ker1, FLT *ker2, FLT *ker3,
   } else {                         // wraps somewhere: use ptr list (slower)
     BIGINT j1[MAX_NSPREAD], j2[MAX_NSPREAD], j3[MAX_NSPREAD];   // 1d ptr lists
     BIGINT x=i1, y=i2, z=i3;         // initialize coords
-    for (int d=0; d<ns; d++) {          // set up ptr lists
+    for (int d=0; d<ns1; d++) {         // set up ptr lists
       if (x<0) x+=N1;
       if (x>=N1) x-=N1;
       j1[d] = x++;
+    }
+    for (int d=0; d<ns2; d++) {
       if (y<0) y+=N2;
       if (y>=N2) y-=N2;
       j2[d] = y++;
+    }
+    for (int d=0; d<ns3; d++) {
       if (z<0) z+=N3;
       if (z>=N3) z-=N3;
       j3[d] = z++;
     }
-    for (int dz=0; dz<ns; dz++) {             // use the pts lists
+    for (int dz=0; dz<ns3; dz++) {             // use the pts lists
       BIGINT oz = N1*N2*j3[dz];               // offset due to z
-      for (int dy=0; dy<ns; dy++) {
+      for (int dy=0; dy<ns2; dy++) {
 	BIGINT oy = oz + N1*j2[dy];           // offset due to y & z
 	FLT ker23 = ker2[dy]*ker3[dz];	
-	for (int dx=0; dx<ns; dx++) {
+	for (int dx=0; dx<ns1; dx++) {
 	  FLT k = ker1[dx]*ker23;
 	  BIGINT j = oy + j1[dx];
 	  out[0] += du[2*j] * k;
@@ -791,7 +2009,10 @@ void spread_subproblem_1d(BIGINT N1,FLT *du,BIGINT M,
   for (BIGINT i=0;i<2*N1;++i)
     du[i] = 0.0;
   FLT kernel_args[MAX_NSPREAD];
-  FLT ker[MAX_NSPREAD];
+  FLT kernel_values[MAX_NSPREAD];
+  FLT kerblk[KERBLOCK*KERBLOCK_MAXW];    // kernels for a block of pts
+  bool blk = (opts.kerevalmeth==1 && opts.kerblock);
+  FLT *ker = kernel_values;
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
     FLT re0 = dd[2*i];
     FLT im0 = dd[2*i+1];
@@ -800,6 +2021,11 @@ void spread_subproblem_1d(BIGINT N1,FLT *du,BIGINT M,
     if (opts.kerevalmeth==0) {
       set_kernel_args(kernel_args, x1, opts);
       evaluate_kernel_vector(ker, kernel_args, opts, ns);
+    } else if (blk) {
+      int b = i % KERBLOCK;              // new block: eval its kernels
+      if (b==0)
+        eval_kernel_block_Horner(kerblk,kx+i,std::min((BIGINT)KERBLOCK,M-i),ns,opts);
+      ker = kerblk + b*ns;
     } else
       eval_kernel_vec_Horner(ker,x1,ns,opts);
     // critical inner loop: 
@@ -820,30 +2046,48 @@ void spread_subproblem_2d(BIGINT N1,BIGINT N2,FLT *du,BIGINT M,
    kx,ky (size M) are NU locations in [0,N1],[0,N2]
    dd (size M complex) are source strengths
    du (size N1*N2) is uniform output array
+   If opts.aniso, the y kernel is opts.dimker[1] (see spread_dim_opts).
  */
 {
-  int ns=opts.nspread;
-  FLT ns2 = (FLT)ns/2;          // half spread width
+  spread_opts opx = spread_dim_opts(opts,0);  // x,y kernels (=opts if
+  spread_opts opy = spread_dim_opts(opts,1);  //   isotropic)
+  int ns=opts.nspread, nsy=opy.nspread;
+  FLT ns2 = (FLT)ns/2, nsy2 = (FLT)nsy/2;     // half spread widths
   for (BIGINT i=0;i<2*N1*N2;++i)
     du[i] = 0.0;
-  FLT kernel_args[2*MAX_NSPREAD];
-  FLT kernel_values[2*MAX_NSPREAD];
+  FLT kernel_args[2*MAX_NSPREAD+4];           // (room for kerpad)
+  FLT kernel_values[2*MAX_NSPREAD+4];
   FLT *ker1 = kernel_values;
   FLT *ker2 = kernel_values + ns;  
+  FLT kerblk[2*KERBLOCK*KERBLOCK_MAXW];  // kernels for a block of pts
+  bool blk = (opts.kerevalmeth==1 && opts.kerblock && opy.kerblock);
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
     FLT re0 = dd[2*i];
     FLT im0 = dd[2*i+1];
     BIGINT i1 = (BIGINT)std::ceil(kx[i] - ns2);
-    BIGINT i2 = (BIGINT)std::ceil(ky[i] - ns2);
+    BIGINT i2 = (BIGINT)std::ceil(ky[i] - nsy2);
     FLT x1 = (FLT)i1 - kx[i];
     FLT x2 = (FLT)i2 - ky[i];
     if (opts.kerevalmeth==0) {
       set_kernel_args(kernel_args, x1, opts);
-      set_kernel_args(kernel_args+ns, x2, opts);
-      evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
+      set_kernel_args(kernel_args+ns, x2, opy);
+      if (opts.aniso) {                  // different betas
+        evaluate_kernel_vector(ker1, kernel_args, opx, ns);
+        evaluate_kernel_vector(ker2, kernel_args+ns, opy, nsy);
+      } else
+        evaluate_kernel_vector(kernel_values, kernel_args, opts, 2*ns);
+    } else if (blk) {
+      int b = i % KERBLOCK;              // new block: eval its kernels
+      if (b==0) {
+	int n = std::min((BIGINT)KERBLOCK,M-i);
+	eval_kernel_block_Horner(kerblk,kx+i,n,ns,opts);
+	eval_kernel_block_Horner(kerblk+KERBLOCK*ns,ky+i,n,nsy,opy);
+      }
+      ker1 = kerblk + b*ns;
+      ker2 = kerblk + KERBLOCK*ns + b*nsy;
     } else {
       eval_kernel_vec_Horner(ker1,x1,ns,opts);
-      eval_kernel_vec_Horner(ker2,x2,ns,opts);
+      eval_kernel_vec_Horner(ker2,x2,nsy,opy);
     }
     // Combine kernel with complex source value to simplify inner loop
     FLT ker1val[2*MAX_NSPREAD];
@@ -852,7 +2096,7 @@ void spread_subproblem_2d(BIGINT N1,BIGINT N2,FLT *du,BIGINT M,
       ker1val[2*i+1] = im0*ker1[i];	
     }    
     // critical inner loop:
-    for (int dy=0; dy<ns; ++dy) {
+    for (int dy=0; dy<nsy; ++dy) {
       BIGINT j = N1*(i2+dy) + i1;
       FLT kerval = ker2[dy];
       FLT *trg = du+2*j;
@@ -870,37 +2114,59 @@ void spread_subproblem_3d(BIGINT N1,BIGINT N2,BIGINT N3,FLT *du,BIGINT M,
    kx,ky,kz (size M) are NU locations in [0,N1],[0,N2],[0,N3]
    dd (size M complex) are source strengths
    du (size N1*N2*N3) is uniform output array
+   If opts.aniso, the y,z kernels are opts.dimker[1,2] (see spread_dim_opts).
  */
 {
-  int ns=opts.nspread;
-  FLT ns2 = (FLT)ns/2;          // half spread width
+  spread_opts opx = spread_dim_opts(opts,0), opy = spread_dim_opts(opts,1);
+  spread_opts opz = spread_dim_opts(opts,2);  // (all =opts if isotropic)
+  int ns=opts.nspread, nsy=opy.nspread, nsz=opz.nspread;
+  FLT ns2 = (FLT)ns/2, nsy2 = (FLT)nsy/2, nsz2 = (FLT)nsz/2; // half widths
   for (BIGINT i=0;i<2*N1*N2*N3;++i)
     du[i] = 0.0;
-  FLT kernel_args[3*MAX_NSPREAD];
+  FLT kernel_args[3*MAX_NSPREAD+4];           // (room for kerpad)
   // Kernel values stored in consecutive memory. This allows us to compute
   // values in all three directions in a single kernel evaluation call.
-  FLT kernel_values[3*MAX_NSPREAD];
+  FLT kernel_values[3*MAX_NSPREAD+4];
   FLT *ker1 = kernel_values;
   FLT *ker2 = kernel_values + ns;
-  FLT *ker3 = kernel_values + 2*ns;  
+  FLT *ker3 = kernel_values + ns + nsy;
+  FLT kerblk[3*KERBLOCK*KERBLOCK_MAXW];  // kernels for a block of pts
+  bool blk = (opts.kerevalmeth==1 && opts.kerblock && opy.kerblock &&
+	      opz.kerblock);
   for (BIGINT i=0; i<M; i++) {           // loop over NU pts
     FLT re0 = dd[2*i];
     FLT im0 = dd[2*i+1];
     BIGINT i1 = (BIGINT)std::ceil(kx[i] - ns2);
-    BIGINT i2 = (BIGINT)std::ceil(ky[i] - ns2);
-    BIGINT i3 = (BIGINT)std::ceil(kz[i] - ns2);
+    BIGINT i2 = (BIGINT)std::ceil(ky[i] - nsy2);
+    BIGINT i3 = (BIGINT)std::ceil(kz[i] - nsz2);
     FLT x1 = (FLT)i1 - kx[i];
     FLT x2 = (FLT)i2 - ky[i];
     FLT x3 = (FLT)i3 - kz[i];
     if (opts.kerevalmeth==0) {
       set_kernel_args(kernel_args, x1, opts);
-      set_kernel_args(kernel_args+ns, x2, opts);
-      set_kernel_args(kernel_args+2*ns, x3, opts);
-      evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
+      set_kernel_args(kernel_args+ns, x2, opy);
+      set_kernel_args(kernel_args+ns+nsy, x3, opz);
+      if (opts.aniso) {                  // different betas
+        evaluate_kernel_vector(ker1, kernel_args, opx, ns);
+        evaluate_kernel_vector(ker2, kernel_args+ns, opy, nsy);
+        evaluate_kernel_vector(ker3, kernel_args+ns+nsy, opz, nsz);
+      } else
+        evaluate_kernel_vector(kernel_values, kernel_args, opts, 3*ns);
+    } else if (blk) {
+      int b = i % KERBLOCK;              // new block: eval its kernels
+      if (b==0) {
+	int n = std::min((BIGINT)KERBLOCK,M-i);
+	eval_kernel_block_Horner(kerblk,kx+i,n,ns,opts);
+	eval_kernel_block_Horner(kerblk+KERBLOCK*ns,ky+i,n,nsy,opy);
+	eval_kernel_block_Horner(kerblk+KERBLOCK*(ns+nsy),kz+i,n,nsz,opz);
+      }
+      ker1 = kerblk + b*ns;
+      ker2 = kerblk + KERBLOCK*ns + b*nsy;
+      ker3 = kerblk + KERBLOCK*(ns+nsy) + b*nsz;
     } else {
       eval_kernel_vec_Horner(ker1,x1,ns,opts);
-      eval_kernel_vec_Horner(ker2,x2,ns,opts);
-      eval_kernel_vec_Horner(ker3,x3,ns,opts);
+      eval_kernel_vec_Horner(ker2,x2,nsy,opy);
+      eval_kernel_vec_Horner(ker3,x3,nsz,opz);
     }
     // Combine kernel with complex source value to simplify inner loop
     FLT ker1val[2*MAX_NSPREAD];
@@ -909,9 +2175,9 @@ void spread_subproblem_3d(BIGINT N1,BIGINT N2,BIGINT N3,FLT *du,BIGINT M,
       ker1val[2*i+1] = im0*ker1[i];	
     }    
     // critical inner loop:
-    for (int dz=0; dz<ns; ++dz) {
+    for (int dz=0; dz<nsz; ++dz) {
       BIGINT oz = N1*N2*(i3+dz);        // offset due to z
-      for (int dy=0; dy<ns; ++dy) {
+      for (int dy=0; dy<nsy; ++dy) {
 	BIGINT j = oz + N1*(i2+dy) + i1;
 	FLT kerval = ker2[dy]*ker3[dz];
 	FLT *trg = du+2*j;
@@ -969,7 +2235,7 @@ void add_wrapped_subgrid(BIGINT offset1,BIGINT offset2,BIGINT offset3,
 }
 
 void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
+	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,BIGINT ks,
 	      double bin_size_x,double bin_size_y,double bin_size_z, int debug)
 /* Returns permutation of all nonuniform points with good RAM access,
  * ie less cache misses for spreading, in 1D, 2D, or 3D. Singe-threaded version.
@@ -983,6 +2249,7 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
  *         kx,ky,kz - length-M arrays of real coords of NU pts, in the valid
  *                    range for RESCALE, which includes [0,N1], [0,N2], [0,N3]
  *                    respectively, if pirange=0; or [-pi,pi] if pirange=1.
+ *         ks - stride (in FLTs) between successive pts in each of kx,ky,kz.
  *         N1,N2,N3 - ranges of NU coords (set N2=N3=1 for 1D, N3=1 for 2D)
  *         bin_size_x,y,z - what binning box size to use in each dimension
  *                    (in rescaled coords where ranges are [0,Ni] ).
@@ -1008,9 +2275,9 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
   std::vector<BIGINT> counts(nbins,0);  // count how many pts in each bin
   for (BIGINT i=0; i<M; i++) {
     // find the bin index in however many dims are needed
-    BIGINT i1=RESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
-    if (isky) i2 = RESCALE(ky[i],N2,pirange)/bin_size_y;
-    if (iskz) i3 = RESCALE(kz[i],N3,pirange)/bin_size_z;
+    BIGINT i1=RESCALE(kx[ks*i],N1,pirange)/bin_size_x, i2=0, i3=0;
+    if (isky) i2 = RESCALE(ky[ks*i],N2,pirange)/bin_size_y;
+    if (iskz) i3 = RESCALE(kz[ks*i],N3,pirange)/bin_size_z;
     BIGINT bin = i1+nbins1*(i2+nbins2*i3);
     counts[bin]++;
   }
@@ -1022,9 +2289,9 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
   std::vector<BIGINT> inv(M);           // fill inverse map
   for (BIGINT i=0; i<M; i++) {
     // find the bin index (again! but better than using RAM)
-    BIGINT i1=RESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
-    if (isky) i2 = RESCALE(ky[i],N2,pirange)/bin_size_y;
-    if (iskz) i3 = RESCALE(kz[i],N3,pirange)/bin_size_z;
+    BIGINT i1=RESCALE(kx[ks*i],N1,pirange)/bin_size_x, i2=0, i3=0;
+    if (isky) i2 = RESCALE(ky[ks*i],N2,pirange)/bin_size_y;
+    if (iskz) i3 = RESCALE(kz[ks*i],N3,pirange)/bin_size_z;
     BIGINT bin = i1+nbins1*(i2+nbins2*i3);
     BIGINT offset=offsets[bin];
     offsets[bin]++;
@@ -1036,7 +2303,7 @@ void bin_sort_singlethread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 }
 
 void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
-	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,
+	      BIGINT N1,BIGINT N2,BIGINT N3,int pirange,BIGINT ks,
 	      double bin_size_x,double bin_size_y,double bin_size_z, int debug)
 /* Mostly-OpenMP'ed version of bin_sort.
    For documentation see: bin_sort_singlethread.
@@ -1068,9 +2335,9 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 	//printf("\tt=%d: [%d,%d]\n",t,jlo[t],jhi[t]);
 	for (BIGINT i=brk[t]; i<brk[t+1]; i++) {
 	  // find the bin index in however many dims are needed
-	  BIGINT i1=RESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
-	  if (isky) i2 = RESCALE(ky[i],N2,pirange)/bin_size_y;
-	  if (iskz) i3 = RESCALE(kz[i],N3,pirange)/bin_size_z;
+	  BIGINT i1=RESCALE(kx[ks*i],N1,pirange)/bin_size_x, i2=0, i3=0;
+	  if (isky) i2 = RESCALE(ky[ks*i],N2,pirange)/bin_size_y;
+	  if (iskz) i3 = RESCALE(kz[ks*i],N3,pirange)/bin_size_z;
 	  BIGINT bin = i1+nbins1*(i2+nbins2*i3);
 	  ct[t][bin]++;               // no clash btw threads
 	}
@@ -1104,9 +2371,9 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
     if (t<nt) {                      // could be nt < actual # threads
       for (BIGINT i=brk[t]; i<brk[t+1]; i++) {
 	// find the bin index (again! but better than using RAM)
-	BIGINT i1=RESCALE(kx[i],N1,pirange)/bin_size_x, i2=0, i3=0;
-	if (isky) i2 = RESCALE(ky[i],N2,pirange)/bin_size_y;
-	if (iskz) i3 = RESCALE(kz[i],N3,pirange)/bin_size_z;
+	BIGINT i1=RESCALE(kx[ks*i],N1,pirange)/bin_size_x, i2=0, i3=0;
+	if (isky) i2 = RESCALE(ky[ks*i],N2,pirange)/bin_size_y;
+	if (iskz) i3 = RESCALE(kz[ks*i],N3,pirange)/bin_size_z;
 	BIGINT bin = i1+nbins1*(i2+nbins2*i3);
 	inv[i]=ot[t][bin];   // get the offset for this NU pt and thread
 	ot[t][bin]++;               // no clash
@@ -1120,28 +2387,28 @@ void bin_sort_multithread(BIGINT *ret, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 }
 
 
-void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,BIGINT &size2,BIGINT &size3,BIGINT M,FLT* kx,FLT* ky,FLT* kz,int ns,int ndims)
+void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,BIGINT &size2,BIGINT &size3,BIGINT M,FLT* kx,FLT* ky,FLT* kz,const int *ns,int ndims)
 /* Writes out the offsets and sizes of the subgrid defined by the
-   nonuniform points and the spreading diameter approx ns/2.
+   nonuniform points and the spreading diameter approx ns[d]/2 in dim d.
    Requires O(M) effort to find the k array bnds. Works in all dims 1,2,3.
    Must return offset 0 and size 1 for each unused dimension.
    Grid has been made tight to the kernel point choice using identical ceil
    operations.  6/16/17
 */
 {
-  FLT ns2 = (FLT)ns/2;
+  FLT ns2 = (FLT)ns[0]/2;
   // compute the min/max of the k-space locations of the nonuniform points
   FLT min_kx,max_kx;
   arrayrange(M,kx,&min_kx,&max_kx);
   BIGINT a1=std::ceil(min_kx-ns2);
-  BIGINT a2=std::ceil(max_kx-ns2)+ns-1;
+  BIGINT a2=std::ceil(max_kx-ns2)+ns[0]-1;
   offset1=a1;
   size1=a2-a1+1;
   if (ndims>1) {
-    FLT min_ky,max_ky;
+    FLT min_ky,max_ky, nsy2 = (FLT)ns[1]/2;
     arrayrange(M,ky,&min_ky,&max_ky);
-    BIGINT b1=std::ceil(min_ky-ns2);
-    BIGINT b2=std::ceil(max_ky-ns2)+ns-1;
+    BIGINT b1=std::ceil(min_ky-nsy2);
+    BIGINT b2=std::ceil(max_ky-nsy2)+ns[1]-1;
     offset2=b1;
     size2=b2-b1+1;
   } else {
@@ -1149,10 +2416,10 @@ void get_subgrid(BIGINT &offset1,BIGINT &offset2,BIGINT &offset3,BIGINT &size1,B
     size2=1;
   }
   if (ndims>2) {
-    FLT min_kz,max_kz;
+    FLT min_kz,max_kz, nsz2 = (FLT)ns[2]/2;
     arrayrange(M,kz,&min_kz,&max_kz);
-    BIGINT c1=std::ceil(min_kz-ns2);
-    BIGINT c2=std::ceil(max_kz-ns2)+ns-1;
+    BIGINT c1=std::ceil(min_kz-nsz2);
+    BIGINT c2=std::ceil(max_kz-nsz2)+ns[2]-1;
     offset3=c1;
     size3=c2-c1+1;
   } else {
@@ -11,23 +11,60 @@
 #include "defs.h"
 #include "utils.h"
 
+#define MAX_INTERP_NDATA 4   // max # grids interpolated by interpmultiwithsortidx
+
+struct spread_kernel {    // one dim's kernel params (see spread_opts.dimker)
+  int nspread;
+  FLT upsampfac, ES_beta, ES_halfwidth, ES_c;
+  FLT *horner_coeffs;
+  int horner_degree, kerblock;
+};
+
 struct spread_opts {      // see cnufftspread:setup_spreader for defaults.
   int nspread;            // w, the kernel width in grid pts
   int spread_direction;   // 1 means spread NU->U, 2 means interpolate U->NU
+  int accumulate;         // dir=1: 0 overwrites the uniform data, 1 adds to it
+  int kpresorted;         // 1: kx,ky,kz are rescaled & in sort_indices order,
+                          //   as written by spreadchecksort
   int pirange;            // 0: coords in [0,N), 1 coords in [-pi,pi)
+  BIGINT kstride;         // FLTs between successive NU pt coords in each of
+                          //   kx,ky,kz (eg 3 for packed xyz structs)
+  BIGINT cstride;         // complex entries btw successive NU pt strengths
   int chkbnds;            // 0: don't check NU pts are in range; 1: do
   int sort;               // 0: don't sort NU pts, 1: do, 2: heuristic choice
   int kerevalmeth;        // 0: exp(sqrt()), old, or 1: Horner ppval, fastest
   int kerpad;             // 0: no pad to mult of 4, 1: do (helps i7 kereval=0)
   int sort_threads;       // 0: auto-choice, >0: fix number of sort threads
+  int nthreads;           // 0: OpenMP's max # threads, >0: use this many
   BIGINT max_subproblem_size; // sets extra RAM per thread
+  int bin_size_x;         // NU pt sorting bin sizes in fine grid pts,
+  int bin_size_y;         //   per dim (only the first ndims are used)
+  int bin_size_z;
   int flags;              // binary flags for timing only (may give wrong ans!)
   int debug;              // 0: silent, 1: small text output, 2: verbose
   FLT upsampfac;          // sigma, upsampling factor, default 2.0
+  nufft_stats *stats;     // NULL, or struct to which timings etc are added
   // ES kernel specific...
   FLT ES_beta;
   FLT ES_halfwidth;
   FLT ES_c;
+  // Horner piecewise poly coeffs fitted at setup (NULL if using the generated
+  // code for sigma=2.0 or 1.25, unless kerblock); see setup_spreader...
+  FLT *horner_coeffs;     // (horner_degree+1)*padded-w array, not to be freed
+  int horner_degree;
+  int kerblock;           // 1: Horner kernel eval'd for blocks of pts (small
+                          //   nspread; set by setup_spreader), 0: per pt
+  // per-dim kernels, for anisotropic problems (see setup_spreader_dims)...
+  int aniso;              // 0: all dims use the kernel above, 1: dim d uses
+  spread_kernel dimker[3];//   dimker[d] (dimker[0] is always the one above)
+};
+
+struct spread_kerprecomp { // kernel values at fixed NU pts; see spreadkerprecomp
+  BIGINT M;               // # NU pts
+  int ndims, ns;          // # dims, kernel width
+  FLT *ker;               // size M*ndims*ns: ns values per dim, per sorted pt
+  int *i0;                // size M*ndims: leftmost (unwrapped) grid index per
+                          //   dim, per sorted pt
 };
 
 // NU coord handling macro: if p is true, rescales from [-pi,pi] to [0,N], then
@@ -65,12 +102,38 @@ int spreadcheck(BIGINT N1, BIGINT N2, BIGINT N3,
 int spreadsort(BIGINT* sort_indices, BIGINT N1, BIGINT N2, BIGINT N3, BIGINT M, 
                FLT *kx, FLT *ky, FLT *kz, spread_opts opts);
 
+int spreadchecksort(BIGINT* sort_indices, FLT *kr, BIGINT N1, BIGINT N2,
+		    BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		    spread_opts opts, int &did_sort);
+int spreadresort(BIGINT* sort_indices, FLT *kr, BIGINT N1, BIGINT N2,
+		 BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		 spread_opts opts, int &did_sort);
+
 int spreadwithsortidx(BIGINT* sort_indices,BIGINT N1, BIGINT N2, BIGINT N3, 
 		      FLT *data_uniform,BIGINT M, FLT *kx, FLT *ky, FLT *kz,
 		      FLT *data_nonuniform, spread_opts opts, int did_sort);
+int spreadinterp_split(BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
+		       BIGINT M, FLT *kx, FLT *ky, FLT *kz, FLT *dr, FLT *di,
+		       spread_opts opts);
+
+int spreadkerprecomp(spread_kerprecomp &kp, BIGINT* sort_indices, BIGINT N1,
+		     BIGINT N2, BIGINT N3, BIGINT M, FLT *kx, FLT *ky, FLT *kz,
+		     spread_opts opts);
+int spreadwithkerprecomp(const spread_kerprecomp &kp, BIGINT* sort_indices,
+			 BIGINT N1, BIGINT N2, BIGINT N3, FLT *data_uniform,
+			 FLT *data_nonuniform, spread_opts opts, int did_sort);
+void free_spreadkerprecomp(spread_kerprecomp &kp);
+int interpmultiwithsortidx(BIGINT* sort_indices, BIGINT N1, BIGINT N2,
+			   BIGINT N3, int ndata, FLT *data_uniform, BIGINT M,
+			   FLT *kx, FLT *ky, FLT *kz, FLT **data_nonuniform,
+			   spread_opts opts);
+double spreadkerprecomp_bytes(BIGINT M, int ndims, int ns);
 
 FLT evaluate_kernel(FLT x,const spread_opts &opts);
 FLT evaluate_kernel_noexp(FLT x,const spread_opts &opts);
 int setup_spreader(spread_opts &opts,FLT eps,FLT upsampfac,int kerevalmeth);
+int setup_spreader_dims(spread_opts &opts, FLT eps, const FLT *upsampfacs,
+			int ndims, int kerevalmeth);
+spread_opts spread_dim_opts(const spread_opts &opts, int d);
 
 #endif  // SPREADINTERP_H
@@ -1,6 +1,6 @@
 // A little library of low-level array manipulations and timers.
 // For its embryonic self-test see ../test/testutils.cpp, which only tests
-// the next235 for now.
+// the smooth number search for now.
 
 #include "utils.h"
 
@@ -85,23 +85,43 @@ void arraywidcen(BIGINT n, FLT* a, FLT *w, FLT *c)
   }
 }
 
+static void smooth_search(BIGINT o, int i, int np, const int *primes, BIGINT n,
+			  BIGINT *best)
+// recursive helper for next_smooth_even: o is an odd smooth number built from
+// primes[0..i], tries all 2^k o >= n, then o times each of primes[i..np-1].
+{
+  BIGINT m = 2*o;
+  while (m<n) m *= 2;
+  if (m<*best) *best = m;
+  for (int j=i; j<np; ++j) {
+    if (2*o*primes[j] >= *best) break;      // can't improve (primes increase)
+    smooth_search(o*primes[j],j,np,primes,n,best);
+  }
+}
+
+BIGINT next_smooth_even(BIGINT n, int maxprime)
+// finds even integer not less than n, with prime factors no larger than
+// maxprime (ie, "smooth"), where primes above 13 are not used. Searches over
+// the odd smooth numbers o, taking the smallest 2^k o >= n, rather than
+// testing each even integer in turn; there are only thousands of odd 7-smooth
+// numbers below MAX_NF, so runtime is well under 1 ms for any n.
+{
+  static const int primes[5] = {3,5,7,11,13};
+  if (n<=2) return 2;
+  int np = 0;
+  while (np<5 && primes[np]<=maxprime) ++np;
+  BIGINT best = 2;
+  while (best<n) best *= 2;                 // a power of 2 always qualifies
+  smooth_search(1,0,np,primes,n,&best);
+  return best;
+}
+
 BIGINT next235even(BIGINT n)
 // finds even integer not less than n, with prime factors no larger than 5
-// (ie, "smooth"). Adapted from fortran in hellskitchen.  Barnett 2/9/17
-// changed INT64 type 3/28/17. Runtime is around n*1e-11 sec for big n.
+// (ie, "smooth"). Was adapted from fortran in hellskitchen (Barnett 2/9/17),
+// a linear search taking n*1e-11 sec; now a wrapper to next_smooth_even.
 {
-  if (n<=2) return 2;
-  if (n%2 == 1) n+=1;   // even
-  BIGINT nplus = n-2;   // to cancel out the +=2 at start of loop
-  BIGINT numdiv = 2;    // a dummy that is >1
-  while (numdiv>1) {
-    nplus += 2;         // stays even
-    numdiv = nplus;
-    while (numdiv%2 == 0) numdiv /= 2;  // remove all factors of 2,3,5...
-    while (numdiv%3 == 0) numdiv /= 3;
-    while (numdiv%5 == 0) numdiv /= 5;
-  }
-  return nplus;
+  return next_smooth_even(n,5);
 }
 
 // ----------------------- helpers for timing (always stay double prec)...
@@ -15,6 +15,7 @@ void arrayrange(BIGINT n, FLT* a, FLT *lo, FLT *hi);
 void indexedarrayrange(BIGINT n, BIGINT* i, FLT* a, FLT *lo, FLT *hi);
 void arraywidcen(BIGINT n, FLT* a, FLT *w, FLT *c);
 BIGINT next235even(BIGINT n);
+BIGINT next_smooth_even(BIGINT n, int maxprime);
 
 // jfm's timer class
 #include <sys/time.h>
@@ -27,4 +28,19 @@ class CNTime {
   struct timeval initial;
 };
 
+
+// Sets the # OpenMP threads for the calling thread's later parallel regions to
+// nthreads (if >0) for the lifetime of this object, then restores the previous
+// value. Since this is a per-thread setting, it does not affect other threads.
+class thread_scope {
+ public:
+  thread_scope(int nthreads) {
+    saved = MY_OMP_GET_MAX_THREADS();
+    if (nthreads>0) MY_OMP_SET_NUM_THREADS(nthreads);
+  }
+  ~thread_scope() { MY_OMP_SET_NUM_THREADS(saved); }
+ private:
+  int saved;
+};
+
 #endif  // UTILS_H
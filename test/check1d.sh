@@ -1,3 +1,7 @@
 #!/bin/bash
 # Standard checker for all 1d routines. Sed removes the timing lines (w/ "NU")
 ./finufft1d_test 1e3 1e3 $FINUFFT_REQ_TOL 0 | sed '/NU/d'
+# nonstandard upsampfac, using Horner coeffs fitted at run time...
+./finufft1d_test 1e3 1e3 $FINUFFT_REQ_TOL 0 2 1.5 | sed '/NU/d'
+# tiny problem, done by direct summation for types 1,2 (and type 3's inner 2)...
+./finufft1d_test 1e2 1e2 $FINUFFT_REQ_TOL 0 | sed '/NU/d'
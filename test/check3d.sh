@@ -1,3 +1,5 @@
 #!/bin/bash
 # Standard checker for all 1d routines. Sed removes the timing lines (w/ "NU")
 ./finufft3d_test 5 10 20 1e3 $FINUFFT_REQ_TOL 0 | sed '/NU/d'
+# anisotropic: per-dim upsampfac, so per-dim kernel widths (types 1,2)
+./finufft3d_test 5 10 40 1e3 $FINUFFT_REQ_TOL 0 2 2.0 2.0 1.5 1.5 | sed '/NU/d'
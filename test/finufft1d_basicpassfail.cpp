@@ -14,6 +14,8 @@ int main()
   BIGINT M = 1e3, N = 1e3;   // defaults: M = # srcs, N = # modes out
   double tol = 1e-5;         // req tol, covers both single & double prec cases
   nufft_opts opts; finufft_default_opts(&opts);     // set default opts
+  nufft_stats stats; opts.stats = &stats;   // also check stats get filled
+  opts.nthreads = 1;         // and that per-call # threads is used
   int isign = +1;            // exponential sign for NUFFT
   static const CPX I = CPX(0.0,1.0);      // imaginary unit. Note: avoid (CPX)
   CPX* F = (CPX*)malloc(sizeof(CPX)*N);   // alloc output mode coeffs
@@ -31,6 +33,11 @@ int main()
     printf("basicpassfail: finufft1d1 error (ier=%d)!",ier);
     exit(ier);
   }
+  if (stats.nf1<N || stats.nspread<2 || stats.t_total<0.0 || stats.nthreads!=1 ||
+      stats.bytes_alloc<sizeof(CPX)*stats.nf1) {
+    printf("basicpassfail: finufft1d1 stats not filled!");
+    exit(1);
+  }
   // Check correct math for a single mode...................
   BIGINT n = (BIGINT)(0.37*N);   // choose some mode near the top (N/2)
   CPX Ftest = CPX(0.0,0.0);      // crude exact answer & error check...
@@ -16,12 +16,16 @@
 int main(int argc, char* argv[])
 /* Test executable for finufft in 3d, all 3 types.
 
-   Usage: finufft3d_test [Nmodes1 Nmodes2 Nmodes3 [Nsrc [tol [debug [spread_sort [upsampfac]]]]]]
+   Usage: finufft3d_test [Nmodes1 Nmodes2 Nmodes3 [Nsrc [tol [debug [spread_sort [upsampfac [upsampfac_x upsampfac_y upsampfac_z]]]]]]]
 
    debug = 0: rel errors and overall timing, 1: timing breakdowns
            2: also spreading output
 
+   upsampfac_x,y,z: per-dim sigmas for types 1,2 (anisotropic kernels; 0 means
+   upsampfac).
+
    Example: finufft3d_test 100 200 50 1e6 1e-12
+            finufft3d_test 20 20 1000 1e6 1e-9 0 2 2.0 2.0 2.0 1.25
 
    Barnett 2/2/17
 */
@@ -48,8 +52,14 @@ int main(int argc, char* argv[])
   if (argc>7) sscanf(argv[7],"%d",&opts.spread_sort);
   if (argc>8) sscanf(argv[8],"%lf",&upsampfac);
   opts.upsampfac=(FLT)upsampfac;
-   if (argc==1 || argc==2 || argc==3 || argc>9) {
-    fprintf(stderr,"Usage: finufft3d_test [N1 N2 N3 [Nsrc [tol [debug [spread_sort [upsampfac]]]]]]\n");
+  if (argc>11) {
+    double s[3];
+    for (int d=0; d<3; ++d) sscanf(argv[9+d],"%lf",&s[d]);
+    opts.upsampfac_x=(FLT)s[0]; opts.upsampfac_y=(FLT)s[1];
+    opts.upsampfac_z=(FLT)s[2];
+  }
+   if (argc==1 || argc==2 || argc==3 || argc==10 || argc==11 || argc>12) {
+    fprintf(stderr,"Usage: finufft3d_test [N1 N2 N3 [Nsrc [tol [debug [spread_sort [upsampfac [upsampfac_x upsampfac_y upsampfac_z]]]]]]]\n");
     return 1;
   }
   cout << scientific << setprecision(15);
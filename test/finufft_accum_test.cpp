@@ -0,0 +1,88 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of the streaming type 1 (finufft_accum_make, add, finalize, destroy):
+// in each dim, splits M NU pts into nchunk chunks of unequal sizes, adds them
+// to a handle one at a time, finalizes, then does it again with the chunks in
+// reverse order (to check the handle is reset), and checks each result
+// against one finufft?d1 call on all the pts. Reports the time of each.
+// Exit code 0 if all match (to rounding error, since only the order of
+// summation onto the fine grid differs), 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_accum_test [M [N [nchunk [tol]]]]
+   M = # NU pts, N = total # modes (split equally between dims), nchunk = #
+   chunks, tol = requested accuracy.
+   Example: finufft_accum_test 1e7 1e6 100 1e-6
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  int nchunk = 7;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%d",&nchunk);
+  if (argc>4) sscanf(argv[4],"%lf",&tol);
+  if (argc>5 || M<1 || N<1 || nchunk<1) {
+    fprintf(stderr,"Usage: finufft_accum_test [M [N [nchunk [tol]]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M);
+  std::vector<CPX> c(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+    c[j] = crandm11r(&se);
+  }
+  std::vector<BIGINT> brk(nchunk+1);    // chunk breakpoints, growing sizes
+  for (int p=0; p<=nchunk; ++p)
+    brk[p] = (BIGINT)(M*pow(p/(double)nchunk,2.0));
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT ms = m, mt = (dim>1) ? m : 1, mu = (dim>2) ? m : 1;
+    BIGINT Nt = ms*mt*mu;
+    std::vector<CPX> ref(Nt), f(Nt);
+    nufft_opts opts; finufft_default_opts(&opts);
+
+    CNTime timer; timer.start();        // one plain call as the reference
+    int ier;
+    if (dim==1) ier = finufft1d1(M,&x[0],&c[0],+1,tol,ms,&ref[0],opts);
+    else if (dim==2) ier = finufft2d1(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&ref[0],opts);
+    else ier = finufft3d1(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&ref[0],opts);
+    double tplain = timer.elapsedsec();
+    if (ier) {
+      printf("accum test: finufft%dd1 error (ier=%d)\n",dim,ier);
+      return 1;
+    }
+    printf("%dd1: M=%lld, N=%lld, %d chunks:\n",dim,(long long)M,(long long)Nt,nchunk);
+    printf("\tplain call:\t\t %.3g s\n",tplain);
+
+    finufft_accum A;
+    ier = finufft_accum_make(dim,ms,mt,mu,+1,tol,&A,opts);
+    for (int rev=0; rev<=1 && !ier; ++rev) {
+      timer.restart();
+      for (int p=0; p<nchunk && !ier; ++p) {
+	int q = rev ? nchunk-1-p : p;
+	BIGINT j = brk[q];
+	ier = finufft_accum_add(A,brk[q+1]-j,&x[j],&y[j],&z[j],&c[j]);
+      }
+      if (!ier) ier = finufft_accum_finalize(A,&f[0]);
+      double tacc = timer.elapsedsec();
+      if (ier) break;
+      FLT err = relerrtwonorm(Nt,&ref[0],&f[0]);
+      if (!(err<=1e3*EPSILON)) fail = 1;        // (also catches nan)
+      printf("\taccum (%s chunks):\t %.3g s, rel diff %.3g\n",rev ? "reversed" : "forward",tacc,err);
+    }
+    finufft_accum_destroy(A);
+    if (ier) {
+      printf("accum test: accum %dd error (ier=%d)\n",dim,ier);
+      return 1;
+    }
+  }
+  return fail;
+}
@@ -0,0 +1,157 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+// Test of asynchronous execution (finufft_execute_async, finufft_async_test,
+// finufft_async_wait, finufft_async_threads): makes nplan 2D plans of
+// alternating types 1 and 2, and queues nexec executes on each at once (so
+// that jobs on one plan must run in turn) on a pool of two workers. While
+// they run, the calling thread polls the handles and does its own work, as
+// an acquisition pipeline would. Checks each result against the blocking
+// finufft_execute, that a worker's FFT keeps to its share of the pool's
+// thread budget even for a plan made with more threads, that jobs queued
+// while another thread restarts the pool (finufft_async_threads) all
+// finish, and that invalid arguments give
+// ERR_ASYNC_ARGS. Reports the times of the blocking and async runs, and the
+// caller's work done.
+// Exit code 0 if all match, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_async_test [nplan [nexec [M [N [tol]]]]]
+   nplan = # plans, nexec = # executes per plan, M = # NU pts in each plan,
+   N = # modes in each dim, tol = requested accuracy.
+   Example: finufft_async_test 8 10 1e5 100 1e-6
+*/
+{
+  int nplan = 4, nexec = 3;
+  BIGINT M = 2e4, N = 64;
+  double w, tol = 1e-6;
+  if (argc>1) sscanf(argv[1],"%d",&nplan);
+  if (argc>2) sscanf(argv[2],"%d",&nexec);
+  if (argc>3) { sscanf(argv[3],"%lf",&w); M = (BIGINT)w; }
+  if (argc>4) { sscanf(argv[4],"%lf",&w); N = (BIGINT)w; }
+  if (argc>5) sscanf(argv[5],"%lf",&tol);
+  if (argc>6 || nplan<1 || nexec<1 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_async_test [nplan [nexec [M [N [tol]]]]]\n");
+    return 1;
+  }
+  BIGINT Nt = N*N;
+  int nth = MY_OMP_GET_MAX_THREADS();
+  std::vector<FLT> x(M*nplan), y(M*nplan);
+  std::vector<CPX> c(M*nplan*nexec), F(Nt*nplan*nexec);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M*nplan; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se);
+  }
+  for (BIGINT j=0; j<M*nplan*nexec; ++j) c[j] = crandm11r(&se);
+  for (BIGINT k=0; k<Nt*nplan*nexec; ++k) F[k] = crandm11r(&se);
+  std::vector<finufft_plan> plans(nplan);
+  nufft_opts opts; finufft_default_opts(&opts);
+  int ier = 0;
+  for (int p=0; p<nplan && !ier; ++p) {      // types 1,2,1,2,...
+    ier = finufft_makeplan(1+p%2,2,N,N,1,+1,tol,&plans[p],opts);
+    if (!ier) ier = finufft_setpts(plans[p],M,&x[p*M],&y[p*M],NULL);
+  }
+  if (ier) {
+    printf("async test: plan error (ier=%d)\n",ier);
+    return 1;
+  }
+  // outputs of job r on plan p: modes (type 1) or values (type 2)...
+  std::vector<CPX> ref(M*nplan*nexec+Nt*nplan*nexec), out(ref.size());
+  std::vector<CPX> cin(c), Fin(F);           // (type 2 overwrites c, etc)
+
+  CNTime timer; timer.start();               // blocking reference...
+  for (int p=0; p<nplan && !ier; ++p)
+    for (int r=0; r<nexec && !ier; ++r) {
+      BIGINT q = p*nexec+r;
+      if (p%2==0)
+	ier = finufft_execute(plans[p],&cin[q*M],&ref[q*Nt]);
+      else
+	ier = finufft_execute(plans[p],&ref[Nt*nplan*nexec+q*M],&Fin[q*Nt]);
+    }
+  double tb = timer.elapsedsec();
+  if (ier) {
+    printf("async test: execute error (ier=%d)\n",ier);
+    return 1;
+  }
+
+  ier = finufft_async_threads(2,nth);        // async...
+  timer.restart();
+  std::vector<finufft_async> h(nplan*nexec);
+  for (int r=0; r<nexec && !ier; ++r)
+    for (int p=0; p<nplan && !ier; ++p) {
+      BIGINT q = p*nexec+r;
+      if (p%2==0)
+	ier = finufft_execute_async(plans[p],&c[q*M],&out[q*Nt],&h[q]);
+      else
+	ier = finufft_execute_async(plans[p],&out[Nt*nplan*nexec+q*M],
+				    &F[q*Nt],&h[q]);
+    }
+  double tq = timer.elapsedsec();
+  if (ier) {
+    printf("async test: queue error (ier=%d)\n",ier);
+    return 1;
+  }
+  int ndone = 0, npoll = 0;                  // poll, doing caller's work
+  double work = 0.0;
+  while (ndone<nplan*nexec) {
+    for (int i=0; i<1000; ++i) work += sin((double)i);
+    ndone = 0;
+    for (int q=0; q<nplan*nexec; ++q) ndone += finufft_async_test(h[q]);
+    ++npoll;
+  }
+  int iers = 0;
+  for (int q=0; q<nplan*nexec; ++q) iers |= finufft_async_wait(h[q]);
+  double ta = timer.elapsedsec();
+  FLT err = relerrtwonorm(ref.size(),&ref[0],&out[0]);
+  printf("async test: %d plans x %d executes, M=%lld, N=%lldx%lld:\n",nplan,nexec,(long long)M,(long long)N,(long long)N);
+  printf("\tblocking %.3g s; async (2 workers, %d threads) %.3g s, queueing %.3g s\n",tb,nth,ta,tq);
+  printf("\tcaller polled %d times meanwhile (work %.3g); rel diff %.3g\n",npoll,work,err);
+  int fail = (iers!=0 || !(err<=1e3*EPSILON));   // (also nan)
+
+  nufft_stats sc;                            // FFT within thread budget
+  nufft_opts copts = opts;
+  copts.stats = &sc;
+  finufft_plan pc;
+  MY_OMP_SET_NUM_THREADS(4);                 // plan's FFTW plan: 4 threads
+  int ierc = finufft_makeplan(1,2,N,N,1,+1,tol,&pc,copts);
+  MY_OMP_SET_NUM_THREADS(nth);
+  if (!ierc) ierc = finufft_setpts(pc,M,&x[0],&y[0],NULL);
+  if (!ierc) ierc = finufft_async_threads(2,2);   // 1 thread per worker
+  finufft_async hc;
+  if (!ierc) ierc = finufft_execute_async(pc,&c[0],&out[0],&hc);
+  if (!ierc) ierc = finufft_async_wait(hc);
+  int fth_async = sc.fft_nthreads;
+  MY_OMP_SET_NUM_THREADS(3);                 // blocking, caller's count
+  if (!ierc) ierc = finufft_execute(pc,&c[0],&out[0]);
+  int fth_block = sc.fft_nthreads, fth_want = MY_OMP_GET_MAX_THREADS();
+  MY_OMP_SET_NUM_THREADS(nth);
+  finufft_destroy(pc);
+  printf("\tFFT threads: async (budget 2, 2 workers) %d, blocking %d\n",fth_async,fth_block);
+  if (ierc || fth_async!=1 || fth_block!=fth_want) fail = 1;
+
+  int nrace = 20, ierr = 0;                  // queue while pool restarts
+  for (int r=0; r<nrace; ++r) {
+    std::thread t(finufft_async_threads,2,nth);
+    finufft_async hr;
+    ierr |= finufft_execute_async(plans[0],&c[0],&out[0],&hr);
+    if (!ierr) ierr |= finufft_async_wait(hr);
+    t.join();
+  }
+  printf("\t%d jobs queued during pool restarts: ier=%d\n",nrace,ierr);
+  if (ierr) fail = 1;
+
+  finufft_async ha;                          // bad inputs
+  if (finufft_async_threads(0,1)!=ERR_ASYNC_ARGS ||
+      finufft_async_threads(1,-1)!=ERR_ASYNC_ARGS ||
+      finufft_execute_async(NULL,&c[0],&out[0],&ha)!=ERR_ASYNC_ARGS || ha) {
+    printf("async test: invalid arguments not caught\n");
+    fail = 1;
+  }
+  for (int p=0; p<nplan; ++p) finufft_destroy(plans[p]);
+  return fail;
+}
@@ -0,0 +1,444 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <map>
+
+// Unified performance benchmark for the FINUFFT library: runs a grid of cases
+// over dims, types, tolerances, M/N ratios, thread counts and NU point
+// distributions, and writes one machine-readable row per case, with per-stage
+// times and throughputs taken from opts.stats. Can compare against a stored
+// baseline CSV file and flag regressions. Replaces nuffttestnd.sh and
+// spreadbenchmark.py.
+
+static const char* usage =
+  "Usage: finufft_benchmark [options]\n"
+  "  --dims 1,2,3          dimensions to run\n"
+  "  --types 1,2,3         transform types to run\n"
+  "  --tols 1e-3,1e-6,1e-9 requested tolerances\n"
+  "  --N 1e6               total # modes (split equally over dims); for type 3\n"
+  "                        the # targets\n"
+  "  --ratios 0.1,1,10     M/N ratios (M = # NU pts)\n"
+  "  --threads 0           # threads list (0 means all available)\n"
+  "  --dists uniform,clustered,radial   NU pt distributions\n"
+  "  --reps 3              repeats per case (fastest is reported)\n"
+  "  --sort 2              opts.spread_sort\n"
+  "  --upsampfac 2.0       opts.upsampfac\n"
+  "  --hugepages 0|1       opts.hugepages (transparent huge page hint)\n"
+  "  --nfprime 7           opts.nf_maxprime (largest prime in fine grid sizes)\n"
+  "  --nftimed 0|1         opts.nf_timed (fine grid sizes by measured FFT time)\n"
+  "  --autotune 0|1        if 1, run finufft_autotune for each case first\n"
+  "  --format csv|json     output format (default csv)\n"
+  "  --out file            write results to file (default stdout)\n"
+  "  --compare base.csv    compare with baseline CSV; exit code 1 if regression\n"
+  "  --slack 0.2           allowed fractional slowdown before flagging\n"
+  "Example: finufft_benchmark --dims 2 --types 1,2 --tols 1e-6 --N 1e6 --out b.csv\n";
+
+// parse comma-separated list of numbers into v
+static void parselist(const char *s, std::vector<double> &v)
+{
+  v.clear();
+  char *buf = strdup(s);
+  for (char *tok=strtok(buf,","); tok; tok=strtok(NULL,","))
+    v.push_back(atof(tok));
+  free(buf);
+}
+
+static void parsestrlist(const char *s, std::vector<std::string> &v)
+{
+  v.clear();
+  char *buf = strdup(s);
+  for (char *tok=strtok(buf,","); tok; tok=strtok(NULL,","))
+    v.push_back(std::string(tok));
+  free(buf);
+}
+
+static FLT wrappi(FLT x)      // fold x into [-pi,pi)
+{
+  while (x>=M_PI) x -= 2*M_PI;
+  while (x<-M_PI) x += 2*M_PI;
+  return x;
+}
+
+static FLT randn(unsigned int *se)   // Box-Muller normal sample
+{
+  FLT u = rand01r(se), v = rand01r(se);
+  if (u<1e-300) u = 1e-300;
+  return sqrt(-2.0*log(u))*cos(2*M_PI*v);
+}
+
+static int validdist(const char *dist)
+{
+  return !strcmp(dist,"uniform") || !strcmp(dist,"clustered") ||
+    !strcmp(dist,"radial");
+}
+
+int makepts(const char *dist, int dim, BIGINT M, FLT **xyz)
+/* Fill the first dim arrays of xyz with M NU pts in [-pi,pi)^dim drawn from
+   distribution dist:
+     uniform   - iid uniform
+     clustered - mixture of 8 Gaussian blobs of std 0.1, periodically wrapped
+     radial    - sqrt(M) spokes through the origin in random directions, with
+                 equispaced points along each (as in radial MRI)
+   Returns 0 on success, 1 for unknown dist.
+*/
+{
+  if (!strcmp(dist,"uniform")) {
+#pragma omp parallel
+    {
+      unsigned int se=MY_OMP_GET_THREAD_NUM();
+#pragma omp for schedule(static)
+      for (BIGINT j=0; j<M; ++j)
+        for (int d=0; d<dim; ++d)
+          xyz[d][j] = M_PI*randm11r(&se);
+    }
+  } else if (!strcmp(dist,"clustered")) {
+    const int nc = 8;
+    FLT cen[nc][3];
+    unsigned int se0 = 12345;
+    for (int k=0; k<nc; ++k)
+      for (int d=0; d<3; ++d)
+        cen[k][d] = M_PI*randm11r(&se0);
+#pragma omp parallel
+    {
+      unsigned int se=MY_OMP_GET_THREAD_NUM();
+#pragma omp for schedule(static)
+      for (BIGINT j=0; j<M; ++j) {
+        int k = j % nc;
+        for (int d=0; d<dim; ++d)
+          xyz[d][j] = wrappi(cen[k][d] + 0.1*randn(&se));
+      }
+    }
+  } else if (!strcmp(dist,"radial")) {
+    BIGINT nspk = (BIGINT)sqrt((double)M);
+    if (nspk<1) nspk = 1;
+    BIGINT npspk = (M+nspk-1)/nspk;      // pts per spoke
+#pragma omp parallel
+    {
+      unsigned int se=MY_OMP_GET_THREAD_NUM();
+#pragma omp for schedule(static)
+      for (BIGINT s=0; s<nspk; ++s) {
+        FLT dir[3], nrm = 0.0;
+        for (int d=0; d<dim; ++d) {
+          dir[d] = randn(&se); nrm += dir[d]*dir[d];
+        }
+        nrm = sqrt(nrm);
+        for (BIGINT i=0; i<npspk; ++i) {
+          BIGINT j = s*npspk + i;
+          if (j>=M) break;
+          FLT r = M_PI*(-1.0 + 2.0*i/(FLT)npspk);
+          for (int d=0; d<dim; ++d)
+            xyz[d][j] = r*dir[d]/nrm;
+        }
+      }
+    }
+  } else
+    return 1;
+  return 0;
+}
+
+struct caseresult {
+  int dim, type, nthreads;
+  double tol;
+  BIGINT M, N;
+  std::string dist;
+  nufft_stats st;
+  double relerr;
+  int ier;
+};
+
+static std::string casekey(int dim, int type, double tol, BIGINT M, BIGINT N,
+			   int nth, const char *dist)
+{
+  char buf[256];
+  snprintf(buf,256,"%d,%d,%.3g,%lld,%lld,%d,%s",dim,type,tol,(long long)M,
+	   (long long)N,nth,dist);
+  return std::string(buf);
+}
+
+static const char *csvheader = "dim,type,tol,M,N,nthreads,dist,ier,nf,ns,did_sort,nsubprobs,t_total,t_fftwplan,t_kerfser,t_sort,t_spread,t_fft,t_deconv,t_prephase,t_kerFT,Mbytes,pts_per_sec,spread_pts_per_sec,fft_pts_per_sec,relerr,t_direct";
+
+static void writerow(FILE *fp, const caseresult &r, int json, int last)
+{
+  const nufft_stats &s = r.st;
+  BIGINT nf = s.nf1*s.nf2*s.nf3;
+  BIGINT Mspread = (r.type==3) ? r.M+r.N : r.M;   // NU pts spread/interp'ed
+  double spreadrate = (s.t_spread>0.0) ? Mspread/s.t_spread : 0.0;
+  double fftrate = (s.t_fft>0.0) ? nf/s.t_fft : 0.0;
+  std::string key = casekey(r.dim,r.type,r.tol,r.M,r.N,r.nthreads,r.dist.c_str());
+  if (json)
+    fprintf(fp,"  {\"dim\":%d, \"type\":%d, \"tol\":%.3g, \"M\":%lld, \"N\":%lld, \"nthreads\":%d, \"dist\":\"%s\", \"ier\":%d, \"nf\":%lld, \"ns\":%d, \"did_sort\":%d, \"nsubprobs\":%lld, \"t_total\":%.6g, \"t_fftwplan\":%.6g, \"t_kerfser\":%.6g, \"t_sort\":%.6g, \"t_spread\":%.6g, \"t_fft\":%.6g, \"t_deconv\":%.6g, \"t_prephase\":%.6g, \"t_kerFT\":%.6g, \"Mbytes\":%.6g, \"pts_per_sec\":%.6g, \"spread_pts_per_sec\":%.6g, \"fft_pts_per_sec\":%.6g, \"relerr\":%.3g, \"t_direct\":%.6g}%s\n",
+	    r.dim,r.type,r.tol,(long long)r.M,(long long)r.N,r.nthreads,
+	    r.dist.c_str(),r.ier,(long long)nf,s.nspread,s.did_sort,
+	    (long long)s.nsubprobs,s.t_total,s.t_fftwplan,s.t_kerfser,s.t_sort,
+	    s.t_spread,s.t_fft,s.t_deconv,s.t_prephase,s.t_kerFT,
+	    s.bytes_alloc/1e6,s.pts_per_sec,spreadrate,fftrate,r.relerr,
+	    s.t_direct,last ? "" : ",");
+  else
+    fprintf(fp,"%s,%d,%lld,%d,%d,%lld,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.3g,%.6g\n",
+	    key.c_str(),r.ier,(long long)nf,s.nspread,s.did_sort,
+	    (long long)s.nsubprobs,s.t_total,s.t_fftwplan,s.t_kerfser,s.t_sort,
+	    s.t_spread,s.t_fft,s.t_deconv,s.t_prephase,s.t_kerFT,
+	    s.bytes_alloc/1e6,s.pts_per_sec,spreadrate,fftrate,r.relerr,
+	    s.t_direct);
+  fflush(fp);
+}
+
+int runcase(caseresult &r, int reps, nufft_opts opts)
+/* Run one benchmark case r (whose inputs dim,type,tol,M,N,dist,nthreads are
+   set), reps times, keeping stats from the fastest run, and estimating the
+   relative error at one output from a direct sum. Returns ier.
+*/
+{
+  int dim = r.dim;
+  BIGINT M = r.M, N = r.N;
+  BIGINT Nd[3] = {1,1,1};                      // modes per dim
+  for (int d=0; d<dim; ++d)
+    Nd[d] = (BIGINT)(0.5 + pow((double)N,1.0/dim));
+  if (r.type!=3) N = Nd[0]*Nd[1]*Nd[2];
+  r.N = N;
+  FLT *xyz[3] = {NULL,NULL,NULL}, *stu[3] = {NULL,NULL,NULL};
+  for (int d=0; d<dim; ++d)
+    xyz[d] = (FLT*)malloc(sizeof(FLT)*M);
+  makepts(r.dist.c_str(),dim,M,xyz);
+  CPX *c = (CPX*)malloc(sizeof(CPX)*M);
+  CPX *F = (CPX*)malloc(sizeof(CPX)*N);
+  unsigned int se = 1;
+  if (r.type==2)
+    for (BIGINT k=0; k<N; ++k) F[k] = crandm11r(&se);
+  else
+    for (BIGINT j=0; j<M; ++j) c[j] = crandm11r(&se);
+  if (r.type==3)                               // freq targs, as in type 1
+    for (int d=0; d<dim; ++d) {
+      stu[d] = (FLT*)malloc(sizeof(FLT)*N);
+      for (BIGINT k=0; k<N; ++k)
+	stu[d][k] = (Nd[d]/2)*randm11r(&se);
+    }
+  int isign = +1;
+  nufft_stats st;
+  opts.stats = &st;
+  r.ier = 0;
+  for (int rep=0; rep<reps; ++rep) {
+    int ier = 0;
+    if (dim==1) {
+      if (r.type==1) ier = finufft1d1(M,xyz[0],c,isign,r.tol,Nd[0],F,opts);
+      else if (r.type==2) ier = finufft1d2(M,xyz[0],c,isign,r.tol,Nd[0],F,opts);
+      else ier = finufft1d3(M,xyz[0],c,isign,r.tol,N,stu[0],F,opts);
+    } else if (dim==2) {
+      if (r.type==1) ier = finufft2d1(M,xyz[0],xyz[1],c,isign,r.tol,Nd[0],Nd[1],F,opts);
+      else if (r.type==2) ier = finufft2d2(M,xyz[0],xyz[1],c,isign,r.tol,Nd[0],Nd[1],F,opts);
+      else ier = finufft2d3(M,xyz[0],xyz[1],c,isign,r.tol,N,stu[0],stu[1],F,opts);
+    } else {
+      if (r.type==1) ier = finufft3d1(M,xyz[0],xyz[1],xyz[2],c,isign,r.tol,Nd[0],Nd[1],Nd[2],F,opts);
+      else if (r.type==2) ier = finufft3d2(M,xyz[0],xyz[1],xyz[2],c,isign,r.tol,Nd[0],Nd[1],Nd[2],F,opts);
+      else ier = finufft3d3(M,xyz[0],xyz[1],xyz[2],c,isign,r.tol,N,stu[0],stu[1],stu[2],F,opts);
+    }
+    if (ier) { r.ier = ier; break; }
+    if (rep==0 || st.t_total<r.st.t_total)
+      r.st = st;
+  }
+  if (r.ier) memset(&r.st,0,sizeof(nufft_stats));
+
+  // crude direct check of one output (as in finufft?d_test)...
+  r.relerr = NAN;
+  if (!r.ier) {
+    CPX J = IMA*(FLT)isign, ex = CPX(0,0);
+    if (r.type==1) {                // one mode
+      BIGINT kt[3] = {0,0,0}, it = 0, stride = 1;
+      for (int d=0; d<dim; ++d) {
+	kt[d] = (BIGINT)(0.37*Nd[d]) - Nd[d]/2;
+	it += stride*(Nd[d]/2 + kt[d]);
+	stride *= Nd[d];
+      }
+      for (BIGINT j=0; j<M; ++j) {
+	FLT ph = 0.0;
+	for (int d=0; d<dim; ++d) ph += kt[d]*xyz[d][j];
+	ex += c[j]*exp(J*ph);
+      }
+      r.relerr = abs(ex-F[it])/infnorm(N,F);
+    } else if (r.type==2) {         // one target
+      BIGINT jt = M/2, m = 0;
+      for (BIGINT m3=-(Nd[2]/2); m3<=(Nd[2]-1)/2; ++m3)
+	for (BIGINT m2=-(Nd[1]/2); m2<=(Nd[1]-1)/2; ++m2)
+	  for (BIGINT m1=-(Nd[0]/2); m1<=(Nd[0]-1)/2; ++m1) {
+	    FLT ph = m1*xyz[0][jt];
+	    if (dim>1) ph += m2*xyz[1][jt];
+	    if (dim>2) ph += m3*xyz[2][jt];
+	    ex += F[m++]*exp(J*ph);
+	  }
+      r.relerr = abs(ex-c[jt])/infnorm(M,c);
+    } else {                        // one target freq
+      BIGINT kt = N/2;
+      for (BIGINT j=0; j<M; ++j) {
+	FLT ph = 0.0;
+	for (int d=0; d<dim; ++d) ph += stu[d][kt]*xyz[d][j];
+	ex += c[j]*exp(J*ph);
+      }
+      r.relerr = abs(ex-F[kt])/infnorm(N,F);
+    }
+  }
+  for (int d=0; d<dim; ++d) {
+    free(xyz[d]);
+    if (stu[d]) free(stu[d]);
+  }
+  free(c); free(F);
+  return r.ier;
+}
+
+int compare(const char *basefile, std::vector<caseresult> &res, double slack)
+/* Compare results res against baseline CSV file basefile (as written by this
+   program). A case regresses if its total time exceeds the baseline by more
+   than the fraction slack (and by more than 1 ms, below which timings are
+   noise), or if its error grew tenfold beyond max(baseline,tol). Cases absent
+   from the baseline are reported as new. Returns the number of regressions,
+   or -1 if the file could not be read.
+*/
+{
+  FILE *fp = fopen(basefile,"r");
+  if (!fp) {
+    fprintf(stderr,"cannot open baseline file %s\n",basefile);
+    return -1;
+  }
+  std::map<std::string,std::pair<double,double> > base;  // key -> (t,err)
+  char line[4096];
+  while (fgets(line,4096,fp)) {
+    if (!strncmp(line,"dim,",4)) continue;          // header
+    std::vector<std::string> f;
+    parsestrlist(line,f);
+    if (f.size()<26) continue;
+    std::string key = f[0];
+    for (int i=1; i<7; ++i) key += "," + f[i];
+    base[key] = std::make_pair(atof(f[12].c_str()),atof(f[25].c_str()));
+  }
+  fclose(fp);
+  int nreg = 0;
+  for (size_t i=0; i<res.size(); ++i) {
+    caseresult &r = res[i];
+    std::string key = casekey(r.dim,r.type,r.tol,r.M,r.N,r.nthreads,r.dist.c_str());
+    if (!base.count(key)) {
+      fprintf(stderr,"new case (no baseline): %s\n",key.c_str());
+      continue;
+    }
+    double tb = base[key].first, eb = base[key].second;
+    double t = r.st.t_total;
+    if (r.ier) {
+      fprintf(stderr,"REGRESSION %s: error code %d\n",key.c_str(),r.ier);
+      ++nreg;
+    } else if (t>(1.0+slack)*tb && t-tb>1e-3) {
+      fprintf(stderr,"REGRESSION %s: time %.3g s vs baseline %.3g s (%+.0f%%)\n",
+	      key.c_str(),t,tb,100.0*(t/tb-1.0));
+      ++nreg;
+    } else if (r.relerr>10.0*fmax(eb,r.tol)) {
+      fprintf(stderr,"REGRESSION %s: relerr %.3g vs baseline %.3g\n",
+	      key.c_str(),r.relerr,eb);
+      ++nreg;
+    } else
+      fprintf(stderr,"ok %s: time %.3g s vs baseline %.3g s\n",key.c_str(),t,tb);
+  }
+  fprintf(stderr,"%d regressions in %d cases (slack %.2g)\n",nreg,(int)res.size(),slack);
+  return nreg;
+}
+
+int main(int argc, char* argv[])
+/* Benchmark driver for FINUFFT. See usage string above for options.
+   Output CSV has one header line then one row per case; JSON is an array of
+   objects with the same fields. Progress goes to stderr.
+*/
+{
+  std::vector<double> dims(1,1.0), types, tols, ratios(1,1.0), threads(1,0.0);
+  types.push_back(1); types.push_back(2); types.push_back(3);
+  dims.push_back(2); dims.push_back(3);
+  tols.push_back(1e-6);
+  std::vector<std::string> dists(1,"uniform");
+  double N = 1e5, upsampfac = 2.0, slack = 0.2;
+  int reps = 3, sort = 2, json = 0, autotune = 0, hugepages = 0;
+  int nfprime = 7, nftimed = 0;
+  const char *outfile = NULL, *basefile = NULL;
+  for (int i=1; i<argc; ++i) {
+    if (!strcmp(argv[i],"-h") || !strcmp(argv[i],"--help")) {
+      printf("%s",usage); return 0;
+    }
+    if (i+1>=argc || strncmp(argv[i],"--",2)) {
+      fprintf(stderr,"bad argument %s\n%s",argv[i],usage); return 1;
+    }
+    const char *opt = argv[i]+2, *val = argv[++i];
+    if (!strcmp(opt,"dims")) parselist(val,dims);
+    else if (!strcmp(opt,"types")) parselist(val,types);
+    else if (!strcmp(opt,"tols")) parselist(val,tols);
+    else if (!strcmp(opt,"N")) N = atof(val);
+    else if (!strcmp(opt,"ratios")) parselist(val,ratios);
+    else if (!strcmp(opt,"threads")) parselist(val,threads);
+    else if (!strcmp(opt,"dists")) parsestrlist(val,dists);
+    else if (!strcmp(opt,"reps")) reps = atoi(val);
+    else if (!strcmp(opt,"sort")) sort = atoi(val);
+    else if (!strcmp(opt,"upsampfac")) upsampfac = atof(val);
+    else if (!strcmp(opt,"autotune")) autotune = atoi(val);
+    else if (!strcmp(opt,"hugepages")) hugepages = atoi(val);
+    else if (!strcmp(opt,"nfprime")) nfprime = atoi(val);
+    else if (!strcmp(opt,"nftimed")) nftimed = atoi(val);
+    else if (!strcmp(opt,"format")) json = !strcmp(val,"json");
+    else if (!strcmp(opt,"out")) outfile = val;
+    else if (!strcmp(opt,"compare")) basefile = val;
+    else if (!strcmp(opt,"slack")) slack = atof(val);
+    else {
+      fprintf(stderr,"unknown option --%s\n%s",opt,usage); return 1;
+    }
+  }
+  if (reps<1) reps = 1;
+  nufft_opts opts; finufft_default_opts(&opts);
+  opts.spread_sort = sort;
+  opts.upsampfac = (FLT)upsampfac;
+  opts.hugepages = hugepages;
+  opts.nf_maxprime = nfprime;
+  opts.nf_timed = nftimed;
+  int maxth = MY_OMP_GET_MAX_THREADS();
+
+  FILE *fp = stdout;
+  if (outfile && !(fp = fopen(outfile,"w"))) {
+    fprintf(stderr,"cannot open output file %s\n",outfile); return 1;
+  }
+  int ncases = dims.size()*types.size()*tols.size()*ratios.size()*
+    threads.size()*dists.size();
+  if (json) fprintf(fp,"[\n"); else fprintf(fp,"%s\n",csvheader);
+  std::vector<caseresult> res;
+  for (size_t id=0; id<dims.size(); ++id)
+    for (size_t it=0; it<types.size(); ++it)
+      for (size_t itol=0; itol<tols.size(); ++itol)
+	for (size_t ir=0; ir<ratios.size(); ++ir)
+	  for (size_t ith=0; ith<threads.size(); ++ith)
+	    for (size_t idi=0; idi<dists.size(); ++idi) {
+	      caseresult r;
+	      r.dim = (int)dims[id]; r.type = (int)types[it]; r.tol = tols[itol];
+	      r.N = (BIGINT)N; r.M = (BIGINT)(ratios[ir]*N);
+	      r.nthreads = (threads[ith]>0) ? (int)threads[ith] : maxth;
+	      r.dist = dists[idi];
+	      if (r.dim<1 || r.dim>3 || r.type<1 || r.type>3 ||
+		  !validdist(r.dist.c_str())) {
+		fprintf(stderr,"skipping invalid case %s\n",casekey(r.dim,r.type,r.tol,r.M,r.N,r.nthreads,r.dist.c_str()).c_str());
+		--ncases; continue;
+	      }
+	      opts.nthreads = r.nthreads;
+	      if (autotune && r.type!=3) {       // (type 3 fine grid depends on pts)
+		int ier = finufft_autotune(r.dim,r.N,r.M,(FLT)r.tol,opts);
+		if (ier) fprintf(stderr,"finufft_autotune failed (ier=%d)\n",ier);
+	      }
+	      runcase(r,reps,opts);
+	      fprintf(stderr,"%s: ier=%d %.3g s, %.3g NU pts/s, relerr %.3g\n",
+		      casekey(r.dim,r.type,r.tol,r.M,r.N,r.nthreads,r.dist.c_str()).c_str(),
+		      r.ier,r.st.t_total,r.st.pts_per_sec,r.relerr);
+	      res.push_back(r);
+	      writerow(fp,r,json,(int)res.size()==ncases);
+	    }
+  if (json) fprintf(fp,"]\n");
+  if (outfile) fclose(fp);
+
+  if (basefile) {
+    int nreg = compare(basefile,res,slack);
+    return (nreg!=0);
+  }
+  return 0;
+}
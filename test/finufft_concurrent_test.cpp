@@ -0,0 +1,92 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Stress test of thread-safety of FINUFFT: runs many small independent 2D
+// type-1 and type-2 transforms concurrently from OpenMP threads (as a user's
+// thread pool would), each with opts.nthreads=1, and checks that the results
+// match those computed serially. Reports the throughput and speedup over the
+// serial run. Exit code 0 if all match, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_concurrent_test [nprob [M [N [tol]]]]
+   nprob = # independent problems, M = # NU pts in each, N = # modes in each
+   dim, tol = requested accuracy.
+   Example: finufft_concurrent_test 1000 1000 32 1e-6
+*/
+{
+  int nprob = 500;
+  BIGINT M = 1000, N = 32;
+  double w, tol = 1e-6;
+  if (argc>1) sscanf(argv[1],"%d",&nprob);
+  if (argc>2) { sscanf(argv[2],"%lf",&w); M = (BIGINT)w; }
+  if (argc>3) { sscanf(argv[3],"%lf",&w); N = (BIGINT)w; }
+  if (argc>4) sscanf(argv[4],"%lf",&tol);
+  if (argc>5 || nprob<1 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_concurrent_test [nprob [M [N [tol]]]]\n");
+    return 1;
+  }
+  nufft_opts opts; finufft_default_opts(&opts);
+  opts.nthreads = 1;                     // each problem single-threaded
+
+  std::vector<FLT> x(M*nprob), y(M*nprob);
+  std::vector<CPX> c(M*nprob), F(N*N*nprob);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M*nprob; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se);
+    c[j] = crandm11r(&se);
+  }
+  for (BIGINT k=0; k<N*N*nprob; ++k) F[k] = crandm11r(&se);
+  std::vector<CPX> Fser(N*N*nprob), Fpar(N*N*nprob), cser(M*nprob),
+    cpar(M*nprob);
+
+  // odd problems do type 1, even ones type 2...
+  CNTime timer; timer.start();
+  int ierser = 0;
+  for (int p=0; p<nprob; ++p) {
+    int ier;
+    if (p%2)
+      ier = finufft2d1(M,&x[p*M],&y[p*M],&c[p*M],+1,tol,N,N,&Fser[p*N*N],opts);
+    else
+      ier = finufft2d2(M,&x[p*M],&y[p*M],&cser[p*M],+1,tol,N,N,&F[p*N*N],opts);
+    if (ier) ierser = ier;
+  }
+  double tser = timer.elapsedsec();
+
+  timer.restart();
+  int ierpar = 0;
+#pragma omp parallel for schedule(dynamic,1)
+  for (int p=0; p<nprob; ++p) {
+    int ier;
+    if (p%2)
+      ier = finufft2d1(M,&x[p*M],&y[p*M],&c[p*M],+1,tol,N,N,&Fpar[p*N*N],opts);
+    else
+      ier = finufft2d2(M,&x[p*M],&y[p*M],&cpar[p*M],+1,tol,N,N,&F[p*N*N],opts);
+    if (ier) {
+#pragma omp critical
+      ierpar = ier;
+    }
+  }
+  double tpar = timer.elapsedsec();
+  if (ierser || ierpar) {
+    printf("concurrent test: error ier=%d (serial), %d (concurrent)\n",ierser,ierpar);
+    return 1;
+  }
+
+  // concurrent results should match serial ones to rounding error...
+  FLT err = 0.0;
+  for (int p=0; p<nprob; ++p) {
+    FLT e = (p%2) ? relerrtwonorm(N*N,&Fser[p*N*N],&Fpar[p*N*N]) :
+      relerrtwonorm(M,&cser[p*M],&cpar[p*M]);
+    if (!(e<=err)) err = e;                     // (also catches nan)
+  }
+  int nth = MY_OMP_GET_MAX_THREADS();
+  printf("%d 2D problems (M=%lld, N=%lld^2): serial %.3g s, %d threads %.3g s (speedup %.3g)\n",nprob,(long long)M,(long long)N,tser,nth,tpar,tser/tpar);
+  printf("\t%.3g problems/s concurrent; max rel diff vs serial %.3g\n",nprob/tpar,err);
+  if (nth>1 && tser/tpar<0.5*nth)
+    printf("\twarning: speedup well below # threads (busy or few-core machine?)\n");
+  return (err>100*EPSILON);
+}
@@ -0,0 +1,98 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of the type-2 transforms with gradient (finufft?d2grad): in each dim
+// and for both mode orderings, checks the values and each gradient component
+// against finufft?d2 applied to the modes weighted by i k_d, and reports the
+// time of the single gradient call and of the dim+1 plain calls.
+// Exit code 0 if all agree to the requested tolerance, 1 otherwise.
+
+static BIGINT modenum(BIGINT i, BIGINT m, int modeord)
+// mode number stored at index i in a size-m array
+{
+  return (modeord==1) ? ((i<(m+1)/2) ? i : i-m) : i - m/2;
+}
+
+int main(int argc, char* argv[])
+/* Usage: finufft_grad_test [M [N [tol]]]
+   M = # NU pts, N = total # modes (split equally between dims), tol =
+   requested accuracy.
+   Example: finufft_grad_test 1e6 1e6 1e-6
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%lf",&tol);
+  if (argc>4 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_grad_test [M [N [tol]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+  }
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT mm[3] = {m, (dim>1) ? m : 1, (dim>2) ? m : 1};
+    BIGINT Nt = mm[0]*mm[1]*mm[2];
+    for (int modeord=0; modeord<=1; ++modeord) {
+      nufft_opts opts; finufft_default_opts(&opts);
+      opts.modeord = modeord;
+      std::vector<CPX> f(Nt), fw(Nt), c(M*(dim+1)), ref(M*(dim+1));
+      for (BIGINT k=0; k<Nt; ++k) f[k] = crandm11r(&se);
+
+      // gradient call...
+      CNTime timer; timer.start();
+      int ier;
+      if (dim==1)
+	ier = finufft1d2grad(M,&x[0],&c[0],&c[M],+1,tol,mm[0],&f[0],opts);
+      else if (dim==2)
+	ier = finufft2d2grad(M,&x[0],&y[0],&c[0],&c[M],&c[2*M],+1,tol,mm[0],
+			     mm[1],&f[0],opts);
+      else
+	ier = finufft3d2grad(M,&x[0],&y[0],&z[0],&c[0],&c[M],&c[2*M],&c[3*M],
+			     +1,tol,mm[0],mm[1],mm[2],&f[0],opts);
+      double tgrad = timer.elapsedsec();
+      if (ier) {
+	printf("grad test: finufft%dd2grad error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+
+      // plain type 2 calls on ik-weighted modes as the reference...
+      timer.restart();
+      for (int d=0; d<=dim && !ier; ++d) {
+	if (d==0) fw = f;
+	else {
+	  BIGINT stride = (d==1) ? 1 : (d==2) ? mm[0] : mm[0]*mm[1];
+	  for (BIGINT k=0; k<Nt; ++k)
+	    fw[k] = f[k] * CPX(0.0,(FLT)modenum((k/stride)%mm[d-1],mm[d-1],modeord));
+	}
+	CPX *o = &ref[d*M];
+	if (dim==1) ier = finufft1d2(M,&x[0],o,+1,tol,mm[0],&fw[0],opts);
+	else if (dim==2) ier = finufft2d2(M,&x[0],&y[0],o,+1,tol,mm[0],mm[1],&fw[0],opts);
+	else ier = finufft3d2(M,&x[0],&y[0],&z[0],o,+1,tol,mm[0],mm[1],mm[2],&fw[0],opts);
+      }
+      double tplain = timer.elapsedsec();
+      if (ier) {
+	printf("grad test: finufft%dd2 error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+      printf("%dd2grad (modeord=%d): M=%lld, N=%lld:\n",dim,modeord,(long long)M,(long long)Nt);
+      printf("\t%d type 2 calls:\t %.3g s\n\tgrad call:\t %.3g s\n",dim+1,tplain,tgrad);
+      for (int d=0; d<=dim; ++d) {
+	FLT err = relerrtwonorm(M,&ref[d*M],&c[d*M]);
+	if (!(err<=10*tol)) fail = 1;           // (also catches nan)
+	printf("\t%s rel diff %.3g\n",(d==0) ? "value:" : (d==1) ? "d/dx: " : (d==2) ? "d/dy: " : "d/dz: ",err);
+      }
+    }
+  }
+  return fail;
+}
@@ -0,0 +1,157 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of restricted mode sets (opts.modeset) for types 1 and 2 in 2D and 3D:
+// for the inscribed disk/ball (modeset=1) and random per-line extents
+// (modeset=2), in both mode orderings, checks type 1 against the full
+// transform with its unused modes zeroed, and type 2 against the full
+// transform of the coefficients with their unused modes zeroed. Both differ
+// only in the FFT (which skips lines), so should match to rounding error.
+// Also checks a bad modeset gives ERR_MODESET_NOTVALID, and that type 3 and
+// the Toeplitz operator, which ignore modeset, are unchanged by it. Reports
+// the times.
+// Exit code 0 if all pass, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_modeset_test [M [N [tol]]]
+   M = # NU pts, N = total # modes (split equally between dims),
+   tol = requested accuracy.
+   Example: finufft_modeset_test 1e6 1e6 1e-6
+*/
+{
+  BIGINT M = 1e4, N = 2e4;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%lf",&tol);
+  if (argc>4 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_modeset_test [M [N [tol]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M);
+  std::vector<CPX> c(M), d(M), dref(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+    c[j] = crandm11r(&se);
+  }
+  int fail = 0;
+  for (int dim=2; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT ms = m+1, mt = m, mu = (dim>2) ? m-3 : 1;  // (odd and even)
+    BIGINT Nt = ms*mt*mu, nl = mt*mu;
+    std::vector<CPX> ref(Nt), f(Nt), fm(Nt);
+    std::vector<BIGINT> lines(2*nl);
+    for (BIGINT l=0; l<nl; ++l) {          // random extents, some lines empty
+      BIGINT a = -ms/2 + (BIGINT)(ms*rand01r(&se));
+      BIGINT b = -ms/2 + (BIGINT)(ms*rand01r(&se));
+      lines[2*l] = std::min(a,b); lines[2*l+1] = std::max(a,b);
+      if (rand01r(&se)<0.1) lines[2*l] = lines[2*l+1]+1;
+    }
+    for (int modeset=1; modeset<=2; ++modeset)
+      for (int modeord=0; modeord<=1; ++modeord) {
+	nufft_opts opts; finufft_default_opts(&opts);
+	opts.modeord = modeord;
+	std::vector<char> in(Nt);        // is each mode (in fk order) used?
+	for (BIGINT k3=-mu/2; k3<=(mu-1)/2; ++k3)
+	  for (BIGINT k2=-mt/2; k2<=(mt-1)/2; ++k2) {
+	    BIGINT l = (k2+mt/2) + mt*(k3+mu/2), lo, hi;
+	    if (modeset==1) {
+	      double q = 1.0 - pow(k2/(0.5*mt),2) - pow(k3/(0.5*mu),2);
+	      hi = (q<0.0) ? -1 : (BIGINT)(0.5*ms*sqrt(q));
+	      lo = (q<0.0) ? 1 : -hi;
+	    } else {
+	      lo = lines[2*l]; hi = lines[2*l+1];
+	    }
+	    for (BIGINT k1=-ms/2; k1<=(ms-1)/2; ++k1) {
+	      BIGINT i1 = k1+ms/2, i2 = k2+mt/2, i3 = k3+mu/2;
+	      if (modeord==1) {
+		i1 = (k1>=0) ? k1 : ms+k1; i2 = (k2>=0) ? k2 : mt+k2;
+		i3 = (k3>=0) ? k3 : mu+k3;
+	      }
+	      in[i1+ms*(i2+mt*i3)] = (k1>=lo && k1<=hi);
+	    }
+	  }
+	int ier;                                // type 1...
+	CNTime timer; timer.start();
+	if (dim==2) ier = finufft2d1(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&ref[0],opts);
+	else ier = finufft3d1(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&ref[0],opts);
+	double tfull = timer.elapsedsec();
+	opts.modeset = modeset; opts.modelines = &lines[0];
+	timer.restart();
+	if (!ier && dim==2) ier = finufft2d1(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&f[0],opts);
+	else if (!ier) ier = finufft3d1(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&f[0],opts);
+	double tset = timer.elapsedsec();
+	if (ier) {
+	  printf("modeset test: %dd1 error (ier=%d)\n",dim,ier);
+	  return 1;
+	}
+	BIGINT nin = 0;
+	for (BIGINT k=0; k<Nt; ++k) {
+	  if (!in[k]) ref[k] = 0.0;
+	  nin += in[k];
+	}
+	FLT err1 = relerrtwonorm(Nt,&ref[0],&f[0]);
+	for (BIGINT k=0; k<Nt; ++k)             // type 2...
+	  fm[k] = in[k] ? f[k] : CPX(0.0,0.0);
+	opts.modeset = 0;
+	timer.restart();
+	if (dim==2) ier = finufft2d2(M,&x[0],&y[0],&dref[0],+1,tol,ms,mt,&fm[0],opts);
+	else ier = finufft3d2(M,&x[0],&y[0],&z[0],&dref[0],+1,tol,ms,mt,mu,&fm[0],opts);
+	double tfull2 = timer.elapsedsec();
+	opts.modeset = modeset;
+	timer.restart();
+	if (!ier && dim==2) ier = finufft2d2(M,&x[0],&y[0],&d[0],+1,tol,ms,mt,&f[0],opts);
+	else if (!ier) ier = finufft3d2(M,&x[0],&y[0],&z[0],&d[0],+1,tol,ms,mt,mu,&f[0],opts);
+	double tset2 = timer.elapsedsec();
+	if (ier) {
+	  printf("modeset test: %dd2 error (ier=%d)\n",dim,ier);
+	  return 1;
+	}
+	FLT err2 = relerrtwonorm(M,&dref[0],&d[0]);
+	if (!(err1<=1e3*EPSILON && err2<=1e3*EPSILON)) fail = 1;  // (also nan)
+	printf("%dd modeset=%d modeord=%d (%lld of %lld modes):\n",dim,modeset,modeord,(long long)nin,(long long)Nt);
+	printf("\ttype 1: full %.3g s, modeset %.3g s, rel diff %.3g\n",tfull,tset,err1);
+	printf("\ttype 2: full %.3g s, modeset %.3g s, rel diff %.3g\n",tfull2,tset2,err2);
+      }
+    nufft_opts opts; finufft_default_opts(&opts);
+    opts.modeset = 3;                       // bad input
+    int ier = (dim==2) ? finufft2d1(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&f[0],opts) :
+      finufft3d1(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&f[0],opts);
+    if (ier!=ERR_MODESET_NOTVALID) {
+      printf("modeset test: %dd bad modeset gave ier=%d\n",dim,ier);
+      fail = 1;
+    }
+
+    // type 3 and Toeplitz ignore modeset (their internal transforms use all
+    // modes), so should match their calls without it to rounding error...
+    BIGINT nk = 1000;
+    std::vector<FLT> s(nk), t(nk), u(nk);
+    for (BIGINT k=0; k<nk; ++k) {
+      s[k] = 0.5*m*randm11r(&se); t[k] = 0.5*m*randm11r(&se);
+      u[k] = 0.5*m*randm11r(&se);
+    }
+    std::vector<CPX> g(nk), gm(nk), fo(Nt), fom(Nt);
+    nufft_opts mopts = opts;
+    mopts.modeset = 1;
+    int ier3 = (dim==2) ? finufft2d3(M,&x[0],&y[0],&c[0],+1,tol,nk,&s[0],&t[0],&g[0],opts) :
+      finufft3d3(M,&x[0],&y[0],&z[0],&c[0],+1,tol,nk,&s[0],&t[0],&u[0],&g[0],opts);
+    if (!ier3) ier3 = (dim==2) ? finufft2d3(M,&x[0],&y[0],&c[0],+1,tol,nk,&s[0],&t[0],&gm[0],mopts) :
+      finufft3d3(M,&x[0],&y[0],&z[0],&c[0],+1,tol,nk,&s[0],&t[0],&u[0],&gm[0],mopts);
+    FLT err3 = ier3 ? 1.0 : relerrtwonorm(nk,&g[0],&gm[0]);
+    finufft_toeplitz T, Tm;
+    int iert = finufft_toeplitz_make(dim,M,&x[0],&y[0],&z[0],NULL,+1,tol,ms,mt,mu,&T,opts);
+    if (!iert) iert = finufft_toeplitz_make(dim,M,&x[0],&y[0],&z[0],NULL,+1,tol,ms,mt,mu,&Tm,mopts);
+    if (!iert) iert = finufft_toeplitz_apply(T,&fm[0],&fo[0]);
+    if (!iert) iert = finufft_toeplitz_apply(Tm,&fm[0],&fom[0]);
+    FLT errt = iert ? 1.0 : relerrtwonorm(Nt,&fo[0],&fom[0]);
+    if (!iert) { finufft_toeplitz_destroy(T); finufft_toeplitz_destroy(Tm); }
+    printf("%dd type 3 and Toeplitz with modeset=1: rel diff %.3g, %.3g\n",dim,err3,errt);
+    if (!(err3<=1e3*EPSILON && errt<=1e3*EPSILON)) fail = 1;   // (also nan)
+  }
+  return fail;
+}
@@ -0,0 +1,148 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of the plan interface (finufft_makeplan, setpts, execute, destroy): in
+// each dim and for types 1 and 2, does nexec executes with fresh strengths
+// (or coefficients) at fixed NU pts, with and without stored kernel values
+// (opts.spread_kerprecomp), and checks each against the plain finufft?d1 or
+// finufft?d2 call. Reports the time per execute of each, the plain calls,
+// and the RAM used by the kernel values. Then moves the NU pts a little
+// before each execute, setting them by finufft_updatepts on one plan and by
+// finufft_setpts on another, and compares the two. Exit code 0 if all match
+// (to a rounding error which grows like EPSILON times the # modes per dim,
+// since the rescaled NU coords may round differently), 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_plan_test [M [N [nexec [tol]]]]
+   M = # NU pts, N = total # modes (split equally between dims), nexec = #
+   executes per plan, tol = requested accuracy.
+   Example: finufft_plan_test 1e5 1e4 10 1e-6
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  int nexec = 5;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%d",&nexec);
+  if (argc>4) sscanf(argv[4],"%lf",&tol);
+  if (argc>5 || M<1 || N<1 || nexec<1) {
+    fprintf(stderr,"Usage: finufft_plan_test [M [N [nexec [tol]]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+  }
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT ms = m, mt = (dim>1) ? m : 1, mu = (dim>2) ? m : 1;
+    BIGINT Nt = ms*mt*mu;
+    for (int type=1; type<=2; ++type) {
+      std::vector<CPX> c(M*nexec), F(Nt*nexec), out(nexec*((type==1) ? Nt : M)),
+	ref(out.size());
+      for (BIGINT j=0; j<M*nexec; ++j) c[j] = crandm11r(&se);
+      for (BIGINT k=0; k<Nt*nexec; ++k) F[k] = crandm11r(&se);
+      nufft_opts opts; finufft_default_opts(&opts);
+
+      // plain calls as the reference...
+      CNTime timer; timer.start();
+      int ier = 0;
+      for (int r=0; r<nexec && !ier; ++r) {
+	if (type==1) {
+	  CPX *cr = &c[r*M], *o = &ref[r*Nt];
+	  if (dim==1) ier = finufft1d1(M,&x[0],cr,+1,tol,ms,o,opts);
+	  else if (dim==2) ier = finufft2d1(M,&x[0],&y[0],cr,+1,tol,ms,mt,o,opts);
+	  else ier = finufft3d1(M,&x[0],&y[0],&z[0],cr,+1,tol,ms,mt,mu,o,opts);
+	} else {
+	  CPX *Fr = &F[r*Nt], *o = &ref[r*M];
+	  if (dim==1) ier = finufft1d2(M,&x[0],o,+1,tol,ms,Fr,opts);
+	  else if (dim==2) ier = finufft2d2(M,&x[0],&y[0],o,+1,tol,ms,mt,Fr,opts);
+	  else ier = finufft3d2(M,&x[0],&y[0],&z[0],o,+1,tol,ms,mt,mu,Fr,opts);
+	}
+      }
+      double tplain = timer.elapsedsec()/nexec;
+      if (ier) {
+	printf("plan test: finufft%dd%d error (ier=%d)\n",dim,type,ier);
+	return 1;
+      }
+      printf("%dd%d: M=%lld, N=%lld, %d executes:\n",dim,type,(long long)M,(long long)Nt,nexec);
+      printf("\tplain calls:\t\t\t\t %.3g s/exec\n",tplain);
+
+      for (int kerprecomp=0; kerprecomp<=1; ++kerprecomp) {
+	nufft_stats st;
+	opts.spread_kerprecomp = kerprecomp;
+	opts.stats = &st;
+	finufft_plan plan;
+	timer.restart();
+	ier = finufft_makeplan(type,dim,ms,mt,mu,+1,tol,&plan,opts);
+	if (!ier) ier = finufft_setpts(plan,M,&x[0],&y[0],&z[0]);
+	double tsetup = timer.elapsedsec();
+	double bytes = st.bytes_kerprecomp;
+	timer.restart();
+	for (int r=0; r<nexec && !ier; ++r) {
+	  if (type==1) ier = finufft_execute(plan,&c[r*M],&out[r*Nt]);
+	  else ier = finufft_execute(plan,&out[r*M],&F[r*Nt]);
+	}
+	double texec = timer.elapsedsec()/nexec;
+	finufft_destroy(plan);
+	if (ier) {
+	  printf("plan test: plan %dd%d error (ier=%d)\n",dim,type,ier);
+	  return 1;
+	}
+	FLT err = relerrtwonorm(out.size(),&ref[0],&out[0]);
+	if (!(err<=100*EPSILON*ms)) fail = 1;   // (also catches nan)
+	printf("\tplan (kerprecomp=%d, %.3g MB):\t setup %.3g s, %.3g s/exec, rel diff %.3g\n",kerprecomp,bytes/1e6,tsetup,texec,err);
+      }
+
+      // moving pts: updatepts vs setpts at each step...
+      for (int kerprecomp=0; kerprecomp<=1; ++kerprecomp) {
+	opts.spread_kerprecomp = kerprecomp;
+	opts.stats = NULL;
+	std::vector<FLT> xm(x), ym(y), zm(z);
+	std::vector<CPX> o2(out.size());
+	finufft_plan plan, plan2;
+	ier = finufft_makeplan(type,dim,ms,mt,mu,+1,tol,&plan,opts);
+	if (!ier) ier = finufft_makeplan(type,dim,ms,mt,mu,+1,tol,&plan2,opts);
+	if (!ier) ier = finufft_setpts(plan,M,&x[0],&y[0],&z[0]);
+	double tupd = 0.0, tset = 0.0;
+	for (int r=0; r<nexec && !ier; ++r) {
+	  for (BIGINT j=0; j<M; ++j) {     // small moves, few change bin
+	    xm[j] += 1e-5*randm11r(&se); ym[j] += 1e-5*randm11r(&se);
+	    zm[j] += 1e-5*randm11r(&se);
+	  }
+	  timer.restart();
+	  ier = finufft_updatepts(plan,&xm[0],&ym[0],&zm[0]);
+	  tupd += timer.elapsedsec();
+	  timer.restart();
+	  if (!ier) ier = finufft_setpts(plan2,M,&xm[0],&ym[0],&zm[0]);
+	  tset += timer.elapsedsec();
+	  if (ier) break;
+	  if (type==1) {
+	    ier = finufft_execute(plan,&c[r*M],&out[r*Nt]);
+	    if (!ier) ier = finufft_execute(plan2,&c[r*M],&o2[r*Nt]);
+	  } else {
+	    ier = finufft_execute(plan,&out[r*M],&F[r*Nt]);
+	    if (!ier) ier = finufft_execute(plan2,&o2[r*M],&F[r*Nt]);
+	  }
+	}
+	finufft_destroy(plan);
+	finufft_destroy(plan2);
+	if (ier) {
+	  printf("plan test: moving pts %dd%d error (ier=%d)\n",dim,type,ier);
+	  return 1;
+	}
+	FLT err = relerrtwonorm(out.size(),&o2[0],&out[0]);
+	if (!(err<=100*EPSILON*ms)) fail = 1;
+	printf("\tmoving pts (kerprecomp=%d):\t updatepts %.3g s, setpts %.3g s per step, rel diff %.3g\n",kerprecomp,tupd/nexec,tset/nexec,err);
+      }
+    }
+  }
+  return fail;
+}
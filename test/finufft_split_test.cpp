@@ -0,0 +1,103 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of the split (planar) complex interfaces finufft?d?split for types 1
+// and 2 in each dim, both signs: checks each result against the usual
+// interleaved call, which differs only in rounding error since the split
+// version does the same arithmetic in another order. Also checks a strided
+// split call (real and imag parts in adjacent columns of one real array).
+// Reports the times.
+// Exit code 0 if all pass, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_split_test [M [N [tol]]]
+   M = # NU pts, N = total # modes (split equally between dims),
+   tol = requested accuracy.
+   Example: finufft_split_test 1e7 1e6 1e-6
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%lf",&tol);
+  if (argc>4 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_split_test [M [N [tol]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M), cr(M), ci(M), dr(M), di(M);
+  std::vector<CPX> c(M), d(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+    c[j] = crandm11r(&se);
+    cr[j] = real(c[j]); ci[j] = imag(c[j]);
+  }
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim)
+    for (int iflag=-1; iflag<=1; iflag+=2) {
+      BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+      BIGINT ms = m, mt = (dim>1) ? m+1 : 1, mu = (dim>2) ? m-1 : 1;
+      BIGINT Nt = ms*mt*mu;
+      std::vector<CPX> ref(Nt), f(Nt);
+      std::vector<FLT> fr(Nt), fi(Nt), f2(2*Nt);
+      nufft_opts opts; finufft_default_opts(&opts);
+      opts.direct = -1;         // (split calls never use the direct sum)
+
+      int ier;                                  // type 1...
+      CNTime timer; timer.start();
+      if (dim==1) ier = finufft1d1(M,&x[0],&c[0],iflag,tol,ms,&ref[0],opts);
+      else if (dim==2) ier = finufft2d1(M,&x[0],&y[0],&c[0],iflag,tol,ms,mt,&ref[0],opts);
+      else ier = finufft3d1(M,&x[0],&y[0],&z[0],&c[0],iflag,tol,ms,mt,mu,&ref[0],opts);
+      double tc = timer.elapsedsec();
+      timer.restart();
+      if (!ier && dim==1) ier = finufft1d1split(M,&x[0],&cr[0],&ci[0],iflag,tol,ms,&fr[0],&fi[0],opts);
+      else if (!ier && dim==2) ier = finufft2d1split(M,&x[0],&y[0],&cr[0],&ci[0],iflag,tol,ms,mt,&fr[0],&fi[0],opts);
+      else if (!ier) ier = finufft3d1split(M,&x[0],&y[0],&z[0],&cr[0],&ci[0],iflag,tol,ms,mt,mu,&fr[0],&fi[0],opts);
+      double ts = timer.elapsedsec();
+      if (ier) {
+	printf("split test: %dd1 error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+      for (BIGINT k=0; k<Nt; ++k) f[k] = CPX(fr[k],fi[k]);
+      FLT err1 = relerrtwonorm(Nt,&ref[0],&f[0]);
+      printf("%dd iflag=%d: M=%lld, N=%lld:\n",dim,iflag,(long long)M,(long long)Nt);
+      printf("\ttype 1: interleaved %.3g s, split %.3g s, rel diff %.3g\n",tc,ts,err1);
+
+      timer.restart();                          // type 2, same modes...
+      ier = (dim==1) ? finufft1d2(M,&x[0],&d[0],iflag,tol,ms,&f[0],opts) :
+	(dim==2) ? finufft2d2(M,&x[0],&y[0],&d[0],iflag,tol,ms,mt,&f[0],opts) :
+	finufft3d2(M,&x[0],&y[0],&z[0],&d[0],iflag,tol,ms,mt,mu,&f[0],opts);
+      tc = timer.elapsedsec();
+      timer.restart();
+      if (!ier && dim==1) ier = finufft1d2split(M,&x[0],&dr[0],&di[0],iflag,tol,ms,&fr[0],&fi[0],opts);
+      else if (!ier && dim==2) ier = finufft2d2split(M,&x[0],&y[0],&dr[0],&di[0],iflag,tol,ms,mt,&fr[0],&fi[0],opts);
+      else if (!ier) ier = finufft3d2split(M,&x[0],&y[0],&z[0],&dr[0],&di[0],iflag,tol,ms,mt,mu,&fr[0],&fi[0],opts);
+      ts = timer.elapsedsec();
+      if (ier) {
+	printf("split test: %dd2 error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+      std::vector<CPX> e(M);
+      for (BIGINT j=0; j<M; ++j) e[j] = CPX(dr[j],di[j]);
+      FLT err2 = relerrtwonorm(M,&d[0],&e[0]);
+      printf("\ttype 2: interleaved %.3g s, split %.3g s, rel diff %.3g\n",tc,ts,err2);
+
+      nufft_opts sopts = opts;                  // type 1, strided modes
+      sopts.fkstride = 2;
+      ier = (dim==1) ? finufft1d1split(M,&x[0],&cr[0],&ci[0],iflag,tol,ms,&f2[0],&f2[1],sopts) :
+	(dim==2) ? finufft2d1split(M,&x[0],&y[0],&cr[0],&ci[0],iflag,tol,ms,mt,&f2[0],&f2[1],sopts) :
+	finufft3d1split(M,&x[0],&y[0],&z[0],&cr[0],&ci[0],iflag,tol,ms,mt,mu,&f2[0],&f2[1],sopts);
+      std::vector<CPX> g(Nt);
+      for (BIGINT k=0; k<Nt; ++k) g[k] = CPX(f2[2*k],f2[2*k+1]);
+      FLT err3 = ier ? 1.0 : relerrtwonorm(Nt,&f[0],&g[0]);
+      printf("\ttype 1 strided split: rel diff %.3g (ier=%d)\n",err3,ier);
+      if (!(err1<=1e3*EPSILON && err2<=1e3*EPSILON && err3<=1e3*EPSILON))
+	fail = 1;                               // (also catches nan)
+    }
+  return fail;
+}
@@ -0,0 +1,138 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of strided data layouts (opts.xstride, cstride, fkstride) for types 1
+// and 2 in each dim: the NU pts are stored as packed xyz structs (xstride=3),
+// the strengths as the middle column of a 3-column interleaved array
+// (cstride=3), and the modes as every other entry (fkstride=2). Checks each
+// result against the same call on separate contiguous copies, which does the
+// same arithmetic so should agree to rounding error, that type 3 and the
+// Toeplitz operator, which ignore the strides, are unchanged by them, and
+// that a zero stride gives ERR_STRIDE_NOTVALID. Reports the times.
+// Exit code 0 if all pass, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_stride_test [M [N [tol]]]
+   M = # NU pts, N = total # modes (split equally between dims),
+   tol = requested accuracy.
+   Example: finufft_stride_test 1e7 1e6 1e-6
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  double w, tol = 1e-6;
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%lf",&tol);
+  if (argc>4 || M<1 || N<1) {
+    fprintf(stderr,"Usage: finufft_stride_test [M [N [tol]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M), xyz(3*M);   // contiguous, and packed
+  std::vector<CPX> c(M), c3(3*M), d(M);        // contiguous, and 3 columns
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+    xyz[3*j] = x[j]; xyz[3*j+1] = y[j]; xyz[3*j+2] = z[j];
+    c[j] = crandm11r(&se);
+    c3[3*j] = c3[3*j+2] = 0.0; c3[3*j+1] = c[j];
+  }
+  FLT *px = &xyz[0], *py = &xyz[1], *pz = &xyz[2];
+  CPX *pc = &c3[1];
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT ms = m, mt = (dim>1) ? m : 1, mu = (dim>2) ? m : 1;
+    BIGINT Nt = ms*mt*mu;
+    std::vector<CPX> ref(Nt), f2(2*Nt);
+    nufft_opts opts; finufft_default_opts(&opts);
+    opts.direct = -1;           // (strided calls never use the direct sum)
+    nufft_opts sopts = opts;
+    sopts.xstride = 3; sopts.cstride = 3; sopts.fkstride = 2;
+
+    int ier;                                  // type 1...
+    CNTime timer; timer.start();
+    if (dim==1) ier = finufft1d1(M,&x[0],&c[0],+1,tol,ms,&ref[0],opts);
+    else if (dim==2) ier = finufft2d1(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&ref[0],opts);
+    else ier = finufft3d1(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&ref[0],opts);
+    double tc = timer.elapsedsec();
+    timer.restart();
+    if (!ier && dim==1) ier = finufft1d1(M,px,pc,+1,tol,ms,&f2[0],sopts);
+    else if (!ier && dim==2) ier = finufft2d1(M,px,py,pc,+1,tol,ms,mt,&f2[0],sopts);
+    else if (!ier) ier = finufft3d1(M,px,py,pz,pc,+1,tol,ms,mt,mu,&f2[0],sopts);
+    double ts = timer.elapsedsec();
+    if (ier) {
+      printf("stride test: %dd1 error (ier=%d)\n",dim,ier);
+      return 1;
+    }
+    std::vector<CPX> f(Nt);
+    for (BIGINT k=0; k<Nt; ++k) f[k] = f2[2*k];
+    FLT err1 = relerrtwonorm(Nt,&ref[0],&f[0]);
+    printf("%dd: M=%lld, N=%lld:\n",dim,(long long)M,(long long)Nt);
+    printf("\ttype 1: contiguous %.3g s, strided %.3g s, rel diff %.3g\n",tc,ts,err1);
+
+    timer.restart();                          // type 2, same modes...
+    ier = (dim==1) ? finufft1d2(M,&x[0],&d[0],+1,tol,ms,&f[0],opts) :
+      (dim==2) ? finufft2d2(M,&x[0],&y[0],&d[0],+1,tol,ms,mt,&f[0],opts) :
+      finufft3d2(M,&x[0],&y[0],&z[0],&d[0],+1,tol,ms,mt,mu,&f[0],opts);
+    tc = timer.elapsedsec();
+    timer.restart();
+    if (!ier && dim==1) ier = finufft1d2(M,px,pc,+1,tol,ms,&f2[0],sopts);
+    else if (!ier && dim==2) ier = finufft2d2(M,px,py,pc,+1,tol,ms,mt,&f2[0],sopts);
+    else if (!ier) ier = finufft3d2(M,px,py,pz,pc,+1,tol,ms,mt,mu,&f2[0],sopts);
+    ts = timer.elapsedsec();
+    if (ier) {
+      printf("stride test: %dd2 error (ier=%d)\n",dim,ier);
+      return 1;
+    }
+    std::vector<CPX> e(M);
+    for (BIGINT j=0; j<M; ++j) e[j] = c3[3*j+1];
+    FLT err2 = relerrtwonorm(M,&d[0],&e[0]);
+    int others = 0;                           // other columns untouched?
+    for (BIGINT j=0; j<M; ++j)
+      others |= (c3[3*j]!=CPX(0.0,0.0) || c3[3*j+2]!=CPX(0.0,0.0));
+    printf("\ttype 2: contiguous %.3g s, strided %.3g s, rel diff %.3g\n",tc,ts,err2);
+    if (!(err1<=1e3*EPSILON && err2<=1e3*EPSILON) || others)  // (also nan)
+      fail = 1;
+    for (BIGINT j=0; j<M; ++j) c3[3*j+1] = c[j];   // restore strengths
+
+    // type 3 and Toeplitz ignore the strides (their arrays are contiguous),
+    // so should match their calls without them to rounding error...
+    BIGINT nk = 1000;
+    std::vector<FLT> s(nk), t(nk), u(nk);
+    for (BIGINT k=0; k<nk; ++k) {
+      s[k] = 0.5*m*randm11r(&se); t[k] = 0.5*m*randm11r(&se);
+      u[k] = 0.5*m*randm11r(&se);
+    }
+    std::vector<CPX> g(nk), gs(nk), fo(Nt), fos(Nt);
+    ier = (dim==1) ? finufft1d3(M,&x[0],&c[0],+1,tol,nk,&s[0],&g[0],opts) :
+      (dim==2) ? finufft2d3(M,&x[0],&y[0],&c[0],+1,tol,nk,&s[0],&t[0],&g[0],opts) :
+      finufft3d3(M,&x[0],&y[0],&z[0],&c[0],+1,tol,nk,&s[0],&t[0],&u[0],&g[0],opts);
+    if (!ier) ier = (dim==1) ? finufft1d3(M,&x[0],&c[0],+1,tol,nk,&s[0],&gs[0],sopts) :
+      (dim==2) ? finufft2d3(M,&x[0],&y[0],&c[0],+1,tol,nk,&s[0],&t[0],&gs[0],sopts) :
+      finufft3d3(M,&x[0],&y[0],&z[0],&c[0],+1,tol,nk,&s[0],&t[0],&u[0],&gs[0],sopts);
+    FLT err3 = ier ? 1.0 : relerrtwonorm(nk,&g[0],&gs[0]);
+    finufft_toeplitz T, Ts;
+    int iert = finufft_toeplitz_make(dim,M,&x[0],&y[0],&z[0],NULL,+1,tol,ms,mt,mu,&T,opts);
+    if (!iert) iert = finufft_toeplitz_make(dim,M,&x[0],&y[0],&z[0],NULL,+1,tol,ms,mt,mu,&Ts,sopts);
+    if (!iert) iert = finufft_toeplitz_apply(T,&f[0],&fo[0]);
+    if (!iert) iert = finufft_toeplitz_apply(Ts,&f[0],&fos[0]);
+    FLT errt = iert ? 1.0 : relerrtwonorm(Nt,&fo[0],&fos[0]);
+    if (!iert) { finufft_toeplitz_destroy(T); finufft_toeplitz_destroy(Ts); }
+    printf("	type 3 and Toeplitz with strides set: rel diff %.3g, %.3g\n",err3,errt);
+    if (!(err3<=1e3*EPSILON && errt<=1e3*EPSILON)) fail = 1;   // (also nan)
+
+    sopts.cstride = 0;                        // bad input
+    ier = (dim==1) ? finufft1d1(M,px,pc,+1,tol,ms,&f2[0],sopts) :
+      (dim==2) ? finufft2d1(M,px,py,pc,+1,tol,ms,mt,&f2[0],sopts) :
+      finufft3d1(M,px,py,pz,pc,+1,tol,ms,mt,mu,&f2[0],sopts);
+    if (ier!=ERR_STRIDE_NOTVALID) {
+      printf("stride test: %dd zero stride gave ier=%d\n",dim,ier);
+      fail = 1;
+    }
+  }
+  return fail;
+}
@@ -0,0 +1,104 @@
+#include "../src/finufft.h"
+#include "../src/utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// Test of the Toeplitz normal operator (finufft_toeplitz_make, apply,
+// destroy): in each dim, applies A^* W A (A the type-2 NUFFT, W random
+// positive weights) niter times via the Toeplitz handle, and via a type-2,
+// weighting, and type-1 call each time as in a plain CG iteration, for both
+// mode orderings. Checks they agree to the requested tolerance, and reports
+// the setup time and the time per application of each.
+// Exit code 0 if all agree, 1 otherwise.
+
+int main(int argc, char* argv[])
+/* Usage: finufft_toeplitz_test [M [N [niter [tol]]]]
+   M = # NU pts, N = total # modes (split equally between dims), niter = #
+   applications of the operator, tol = requested accuracy.
+   Example: finufft_toeplitz_test 1e6 1e5 10 1e-6
+   (default tol is 1e-6, or 1e-4 in single precision)
+*/
+{
+  BIGINT M = 1e5, N = 1e4;
+  int niter = 5;
+#ifdef SINGLE
+  double w, tol = 1e-4;      // (default tol reachable in single precision)
+#else
+  double w, tol = 1e-6;
+#endif
+  if (argc>1) { sscanf(argv[1],"%lf",&w); M = (BIGINT)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); N = (BIGINT)w; }
+  if (argc>3) sscanf(argv[3],"%d",&niter);
+  if (argc>4) sscanf(argv[4],"%lf",&tol);
+  if (argc>5 || M<1 || N<1 || niter<1) {
+    fprintf(stderr,"Usage: finufft_toeplitz_test [M [N [niter [tol]]]]\n");
+    return 1;
+  }
+  std::vector<FLT> x(M), y(M), z(M);
+  std::vector<CPX> wt(M), c(M);
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M; ++j) {
+    x[j] = PI*randm11r(&se); y[j] = PI*randm11r(&se); z[j] = PI*randm11r(&se);
+    wt[j] = 1.0 + 0.5*randm11r(&se);
+  }
+  int fail = 0;
+  for (int dim=1; dim<=3; ++dim) {
+    BIGINT m = (BIGINT)pow((double)N,1.0/dim);     // modes per dim
+    BIGINT ms = m, mt = (dim>1) ? m : 1, mu = (dim>2) ? m : 1;
+    BIGINT Nt = ms*mt*mu;
+    for (int modeord=0; modeord<=1; ++modeord) {
+      nufft_opts opts; finufft_default_opts(&opts);
+      opts.modeord = modeord;
+      std::vector<CPX> f(Nt), g(Nt), gref(Nt);
+      for (BIGINT k=0; k<Nt; ++k) f[k] = crandm11r(&se);
+
+      // plain type 2, weight, type 1, as in a CG iteration (iterated on f)...
+      CNTime timer; timer.start();
+      int ier = 0;
+      std::vector<CPX> fr(f);
+      for (int r=0; r<niter && !ier; ++r) {
+	if (dim==1) ier = finufft1d2(M,&x[0],&c[0],+1,tol,ms,&fr[0],opts);
+	else if (dim==2) ier = finufft2d2(M,&x[0],&y[0],&c[0],+1,tol,ms,mt,&fr[0],opts);
+	else ier = finufft3d2(M,&x[0],&y[0],&z[0],&c[0],+1,tol,ms,mt,mu,&fr[0],opts);
+	for (BIGINT j=0; j<M; ++j) c[j] *= wt[j];
+	if (dim==1) ier = ier || finufft1d1(M,&x[0],&c[0],-1,tol,ms,&gref[0],opts);
+	else if (dim==2) ier = ier || finufft2d1(M,&x[0],&y[0],&c[0],-1,tol,ms,mt,&gref[0],opts);
+	else ier = ier || finufft3d1(M,&x[0],&y[0],&z[0],&c[0],-1,tol,ms,mt,mu,&gref[0],opts);
+	FLT s = 1.0/(M*1.5);                    // (keep size O(1))
+	for (BIGINT k=0; k<Nt; ++k) fr[k] = gref[k]*s;
+      }
+      double tplain = timer.elapsedsec()/niter;
+      if (ier) {
+	printf("toeplitz test: plain %dd error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+
+      // the same via the Toeplitz handle...
+      finufft_toeplitz T;
+      timer.restart();
+      ier = finufft_toeplitz_make(dim,M,&x[0],&y[0],&z[0],&wt[0],+1,tol,ms,mt,mu,&T,opts);
+      double tsetup = timer.elapsedsec();
+      timer.restart();
+      std::vector<CPX> ft(f);
+      for (int r=0; r<niter && !ier; ++r) {
+	ier = finufft_toeplitz_apply(T,&ft[0],&g[0]);
+	FLT s = 1.0/(M*1.5);
+	for (BIGINT k=0; k<Nt; ++k) ft[k] = g[k]*s;
+      }
+      double tapply = timer.elapsedsec()/niter;
+      finufft_toeplitz_destroy(T);
+      if (ier) {
+	printf("toeplitz test: toeplitz %dd error (ier=%d)\n",dim,ier);
+	return 1;
+      }
+      FLT err = relerrtwonorm(Nt,&gref[0],&g[0]);
+      if (!(err<=10*tol*niter)) fail = 1;       // (also catches nan)
+      printf("%dd (modeord=%d): M=%lld, N=%lld, %d applications:\n",dim,modeord,(long long)M,(long long)Nt,niter);
+      printf("\ttype 2 + type 1:\t\t\t %.3g s/appl\n",tplain);
+      printf("\ttoeplitz:\tsetup %.3g s,\t %.3g s/appl, rel diff %.3g\n",tsetup,tapply,err);
+    }
+  }
+  return fail;
+}
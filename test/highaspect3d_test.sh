@@ -9,3 +9,11 @@ time ./finufft3d_test 400 10 400 1e6 1e-12 0
 
 # expect poor when split only along z:
 time ./finufft3d_test 400 400 10 1e6 1e-12 0
+
+# elongated grids, isotropic vs per-dim upsampfac (sigma 1.25 in the long dim
+# shrinks the fine grid, hence FFT, at the cost of a wider kernel there only).
+# Compare type 1,2 timings and errors of each pair:
+time ./finufft3d_test 20 20 4000 1e6 1e-9 0 2 2.0
+time ./finufft3d_test 20 20 4000 1e6 1e-9 0 2 2.0 2.0 2.0 1.25
+time ./finufft3d_test 4000 20 20 1e6 1e-9 0 2 2.0
+time ./finufft3d_test 4000 20 20 1e6 1e-9 0 2 2.0 1.25 2.0 2.0
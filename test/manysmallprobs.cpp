@@ -1,51 +1,103 @@
 #include "finufft.h"
+#include "../src/utils.h"
 #include <complex>
 #include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 using namespace std;
 
 int main(int argc, char* argv[])
-/* What is small-problem cost of FINUFFT library from C++, using plain
-   arrays of C++ complex numbers?  Barnett 10/31/17.
-   for Xi Chen question.
+/* Benchmark of many independent small 1D type-1 problems, each with its own
+   NU pts and strengths, and mode counts alternating N and N+1 (sharing a fine
+   grid size): repeated calls to finufft1d1 (one thread each, as was the
+   earlier version of this code), vs a single finufft_batch call, which shares
+   FFTW plans and kernel Fourier series between problems and does one problem
+   per thread, vs repeated calls forced to use direct summation. Reports
+   throughput of each and checks the first two agree.
+   Barnett 10/31/17, for Xi Chen question; batch comparison added for v1.2.
 
-   g++ -fopenmp manysmallprobs.cpp ../lib-static/libfinufft.a -o manysmallprobs  -lfftw3 -lfftw3_omp -lm
-   # multithreaded is much slower, due to overhead of starting threads...
-   export OMP_NUM_THREADS=1
-   time ./manysmallprobs
+   Usage: manysmallprobs [reps [M [N [acc]]]]
+   Defaults: 2e4 problems each of M=200 NU pts, N=200 modes, acc 1e-6.
+   Exit code 0 if batch matches repeated calls, 1 otherwise.
 
-   Takes about 1.2s on single core. Ie, throughput is 3.3e6 pts/sec.
+   Repeated calls took about 1.2s on a single core (3.3e6 pts/sec).
 */
-{  
-  int M = 2e2;            // number of nonuniform points
-  int N = 2e2;            // number of modes
-  int reps = 2e4;         // how many repetitions
-  double acc = 1e-6;      // desired accuracy
-  
+{
+  int reps = 2e4;         // how many problems
+  BIGINT M = 2e2;         // number of nonuniform points in each
+  BIGINT N = 2e2;         // number of modes in each (or N+1)
+  double w, acc = 1e-6;   // desired accuracy
+  if (argc>1) { sscanf(argv[1],"%lf",&w); reps = (int)w; }
+  if (argc>2) { sscanf(argv[2],"%lf",&w); M = (BIGINT)w; }
+  if (argc>3) { sscanf(argv[3],"%lf",&w); N = (BIGINT)w; }
+  if (argc>4) sscanf(argv[4],"%lf",&acc);
+  if (argc>5 || reps<1 || M<1 || N<1) {
+    fprintf(stderr,"Usage: manysmallprobs [reps [M [N [acc]]]]\n");
+    return 1;
+  }
   nufft_opts opts; finufft_default_opts(&opts);
-  complex<double> I = complex<double>(0.0,1.0);  // the imaginary unit
-  int ier;
-  
-  // generate some random nonuniform points (x) and complex strengths (c):
-  double *x = (double *)malloc(sizeof(double)*M);
-  complex<double>* c = (complex<double>*)malloc(sizeof(complex<double>)*M);
-  for (int j=0; j<M; ++j) {
-    x[j] = M_PI*(2*((double)rand()/RAND_MAX)-1);  // uniform random in [-pi,pi]
-    c[j] = 2*((double)rand()/RAND_MAX)-1 + I*(2*((double)rand()/RAND_MAX)-1);
+
+  // generate random nonuniform points (x) and complex strengths (c) for all:
+  vector<FLT> x(M*reps);
+  vector<CPX> c(M*reps), F(reps*(N+1)), Fb(reps*(N+1));
+  unsigned int se = 1;
+  for (BIGINT j=0; j<M*reps; ++j) {
+    x[j] = PI*randm11r(&se);                     // uniform random in [-pi,pi]
+    c[j] = crandm11r(&se);
+  }
+
+  // repeated plain calls, each single-threaded:
+  opts.nthreads = 1;
+  opts.direct = -1;                             // (never direct sum)
+  CNTime timer; timer.start();
+  int ier = 0;
+  for (int r=0; r<reps && !ier; ++r)            // call the NUFFT (iflag=+1):
+    ier = finufft1d1(M,&x[r*M],&c[r*M],+1,acc,N+r%2,&F[r*(N+1)],opts);
+  double tplain = timer.elapsedsec();
+  if (ier) {
+    printf("manysmallprobs: finufft1d1 error (ier=%d)\n",ier);
+    return ier;
+  }
+
+  // the same problems by repeated direct sums:
+  vector<CPX> Fd(reps*(N+1));
+  opts.direct = 1;
+  timer.restart();
+  for (int r=0; r<reps && !ier; ++r)
+    ier = finufft1d1(M,&x[r*M],&c[r*M],+1,acc,N+r%2,&Fd[r*(N+1)],opts);
+  double tdirect = timer.elapsedsec();
+  if (ier) {
+    printf("manysmallprobs: finufft1d1 direct error (ier=%d)\n",ier);
+    return ier;
+  }
+
+  // the same problems in one batch call, using all threads:
+  opts.nthreads = 0;
+  vector<nufft_batch_prob> probs(reps);
+  for (int r=0; r<reps; ++r) {
+    nufft_batch_prob &p = probs[r];
+    p.M = M; p.x = &x[r*M]; p.y = p.z = NULL; p.c = &c[r*M];
+    p.ms = N+r%2; p.mt = p.mu = 1; p.fk = &Fb[r*(N+1)];
   }
-  // allocate output array for the Fourier modes:
-  complex<double>* F = (complex<double>*)malloc(sizeof(complex<double>)*N);
-
-  
-  for (int r=0;r<reps;++r) {    // call the NUFFT (with iflag=+1):
-    //printf("rep %d\n",r);
-    x[0] = M_PI*(2*((double)rand()/RAND_MAX)-1);  // one source jiggles around
-    ier = finufft1d1(M,x,c,+1,acc,N,F,opts);
+  timer.restart();
+  ier = finufft_batch(1,1,reps,&probs[0],+1,acc,opts);
+  double tbatch = timer.elapsedsec();
+  if (ier) {
+    printf("manysmallprobs: finufft_batch error (ier=%d)\n",ier);
+    return ier;
+  }
+
+  FLT err = 0.0, errd = 0.0;
+  for (int r=0; r<reps; ++r) {
+    FLT e = relerrtwonorm(N+r%2,&F[r*(N+1)],&Fb[r*(N+1)]);
+    if (!(e<=err)) err = e;                     // (also catches nan)
+    e = relerrtwonorm(N+r%2,&Fd[r*(N+1)],&F[r*(N+1)]);
+    if (!(e<=errd)) errd = e;
   }
- 
-  complex<double> y=F[0];
-  printf("%d reps of 1d1 done (last ier=%d): F[0]=%.6g + %.6gi\n",reps,ier,real(y),imag(y));
-  
-  free(x); free(c); free(F);
-  return ier;
+  printf("%d 1d1 problems (M=%lld, N=%lld):\n",reps,(long long)M,(long long)N);
+  printf("\trepeated calls (1 thread):\t %.3g s\t %.3g pts/s\n",tplain,reps*M/tplain);
+  printf("\tdirect sums (1 thread):\t\t %.3g s\t %.3g pts/s\n",tdirect,reps*M/tdirect);
+  printf("\tfinufft_batch (%d threads):\t %.3g s\t %.3g pts/s\n",MY_OMP_GET_MAX_THREADS(),tbatch,reps*M/tbatch);
+  printf("\tmax rel diff batch vs repeated %.3g; max rel err of NUFFT vs direct %.3g\n",err,errd);
+  return (err>100*EPSILON);
 }
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Effect of NUMA page placement and transparent huge pages on large transforms,
+# for multi-socket machines. Runs finufft_benchmark with threads pinned across
+# all sockets, with the fine grid pages (i) all on socket 0 (numactl
+# --membind=0, as when a single thread first-touches the grid), (ii) placed by
+# the library's parallel first touch (the default), (iii) as (ii) plus
+# opts.hugepages=1. Compare the t_spread and t_fft columns of the results.
+# Needs numactl for (i); otherwise that case is skipped.
+# Usage (from test/): ./numabench.sh [N] [dims]
+
+N=${1:-1e7}
+DIMS=${2:-2,3}
+ARGS="--dims $DIMS --types 1,2 --tols 1e-6 --N $N --ratios 1 --reps 3"
+
+./mycpuinfo.sh
+if [ -r /sys/kernel/mm/transparent_hugepage/enabled ]; then
+    echo "THP setting: $(cat /sys/kernel/mm/transparent_hugepage/enabled)"
+fi
+export OMP_PROC_BIND=spread
+export OMP_PLACES=cores
+
+if hash numactl 2> /dev/null; then
+    numactl --hardware | head -1
+    echo "fine grid on socket 0 only..."
+    numactl --membind=0 ./finufft_benchmark $ARGS --out results/numa_node0.csv
+fi
+echo "parallel first touch..."
+./finufft_benchmark $ARGS --out results/numa_firsttouch.csv
+echo "parallel first touch + huge pages..."
+./finufft_benchmark $ARGS --hugepages 1 --out results/numa_hugepages.csv
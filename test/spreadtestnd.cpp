@@ -1,12 +1,36 @@
 #include "../src/spreadinterp.h"
 #include <vector>
+#include <algorithm>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 void usage()
 {
-  printf("usage: spreadtestnd [dims [M [N [tol [sort [flags [debug [kerpad [kerevalmeth]]]]]]]]]\n\twhere dims=1,2 or 3\n\tM=# nonuniform pts\n\tN=# uniform pts\n\ttol=requested accuracy\n\tsort=0 (don't sort NU pts), 1 (do), or 2 (maybe sort; default)\n\tflags : expert timing flags (see cnufftspread.h)\n\tdebug=0 (less text out), 1 (more), 2 (lots)\n\tkerpad=0 (no pad to mult of 4), 1 (do)\n\tkerevalmeth=0 (direct), 1 (Horner ppval)\n\nexample: ./spreadtestnd 1 1e6 1e6 1e-6 2 0 1\n");
+  printf("usage: spreadtestnd [dims [M [N [tol [sort [flags [debug [kerpad [kerevalmeth [dist]]]]]]]]]]\n\twhere dims=1,2 or 3\n\tM=# nonuniform pts\n\tN=# uniform pts\n\ttol=requested accuracy\n\tsort=0 (don't sort NU pts), 1 (do), or 2 (maybe sort; default)\n\tflags : expert timing flags (see cnufftspread.h)\n\tdebug=0 (less text out), 1 (more), 2 (lots)\n\tkerpad=0 (no pad to mult of 4), 1 (do)\n\tkerevalmeth=0 (direct), 1 (Horner ppval)\n\tdist=0 (uniform random NU pts; default), 1 (clustered in a few Gaussian blobs),\n\t     2 (sorted trajectory: uniform random with each coord sorted)\n\nexample: ./spreadtestnd 1 1e6 1e6 1e-6 2 0 1\n");
+}
+
+#define NBLOBS 8
+static FLT blobctr[NBLOBS][3];  // blob centres for dist=1, in [0,N)^3
+
+static FLT clusteredcoord(int b, int i, BIGINT N, unsigned int *se)
+/* Coordinate i of a random pt in Gaussian blob b, with std dev 0.1 in [0,2pi)
+   units, wrapped periodically into [0,N).
+*/
+{
+  FLT u = rand01r(se), v = rand01r(se);
+  FLT g = sqrt(-2.0*log(std::max(u,(FLT)1e-300)))*cos(2*PI*v);   // Box-Muller
+  FLT x = fmod(blobctr[b][i] + 0.1*N/(2*PI)*g, (FLT)N);
+  return (x<0.0) ? x+N : x;
+}
+
+static void sortcoords(int d, std::vector<FLT> &kx, std::vector<FLT> &ky,
+		       std::vector<FLT> &kz)
+// sorts each coord array in place, making a monotone trajectory for dist=2
+{
+  std::sort(kx.begin(),kx.end());
+  if (d>1) std::sort(ky.begin(),ky.end());
+  if (d>2) std::sort(kz.begin(),kz.end());
 }
 
 int main(int argc, char* argv[])
@@ -22,6 +46,8 @@ int main(int argc, char* argv[])
  * Magland; expanded by Barnett 1/14/17. Better cmd line args 3/13/17
  * indep setting N 3/27/17. parallel rand() & sort flag 3/28/17
  * timing_flags 6/14/17. debug control 2/8/18. sort=2 opt 3/5/18, pad 4/24/18
+ * clustered dist option, to benchmark subproblem load balance.
+ * sorted trajectory dist option, to benchmark presorted NU pt detection.
  */
 {
   int d = 3;            // Cmd line args & their defaults:  default #dims
@@ -33,6 +59,7 @@ int main(int argc, char* argv[])
   int debug = 0;        // default
   int kerpad = 0;       // default
   int kerevalmeth = 1;  // default: Horner
+  int dist = 0;         // default: uniform NU pts
   if (argc<=1) { usage(); return 0; }
   sscanf(argv[1],"%d",&d);
   if (d<1 || d>3) {
@@ -83,6 +110,12 @@ int main(int argc, char* argv[])
     }
   }
   if (argc>10) {
+    sscanf(argv[10],"%d",&dist);
+    if ((dist<0) || (dist>2)) {
+      printf("dist must be 0, 1 or 2!\n"); usage(); return 1;
+    }
+  }
+  if (argc>11) {
     usage(); return 1;
   }
 
@@ -128,22 +161,35 @@ int main(int argc, char* argv[])
 
   // now do the large-scale test w/ random sources..
   printf("making random data...\n");
+  unsigned int sb = 12345;               // fixed blob centres, for dist=1
+  for (int b=0; b<NBLOBS; ++b)
+    for (int i=0; i<3; ++i)
+      blobctr[b][i] = rand01r(&sb)*N;
   FLT strre = 0.0, strim = 0.0;          // also sum the strengths
 #pragma omp parallel
   {
     unsigned int se=MY_OMP_GET_THREAD_NUM();  // needed for parallel random #s
 #pragma omp for schedule(dynamic,1000000) reduction(+:strre,strim)
     for (BIGINT i=0; i<M; ++i) {
-      kx[i]=rand01r(&se)*N;
-      //kx[i]=2.0*kx[i] - 50.0;      //// to test folding within +-1 period
-      if (d>1) ky[i]=rand01r(&se)*N;      // only fill needed coords
-      if (d>2) kz[i]=rand01r(&se)*N;
+      if (dist==1) {
+        int b = (int)(rand01r(&se)*NBLOBS) % NBLOBS;
+        kx[i]=clusteredcoord(b,0,N,&se);
+        if (d>1) ky[i]=clusteredcoord(b,1,N,&se);
+        if (d>2) kz[i]=clusteredcoord(b,2,N,&se);
+      } else {
+        kx[i]=rand01r(&se)*N;
+        //kx[i]=2.0*kx[i] - 50.0;      //// to test folding within +-1 period
+        if (d>1) ky[i]=rand01r(&se)*N;      // only fill needed coords
+        if (d>2) kz[i]=rand01r(&se)*N;
+      }
       d_nonuniform[i*2]=randm11r(&se);
       d_nonuniform[i*2+1]=randm11r(&se);
       strre += d_nonuniform[2*i]; 
       strim += d_nonuniform[2*i+1];
     }
   }
+  if (dist==2)                           // monotone in all coords, hence bins
+    sortcoords(d,kx,ky,kz);
   CNTime timer;
   double t;
   if (dodir1) {   // test direction 1 (NU -> U spreading) ......................
@@ -184,12 +230,21 @@ int main(int argc, char* argv[])
 #pragma omp for schedule(dynamic,1000000)
       for (BIGINT i=0; i<M; ++i) {       // random target pts
         //kx[i]=10+.9*rand01r(&s)*N;   // or if want to keep ns away from edges
-	kx[i]=rand01r(&s)*N;
-	if (d>1) ky[i]=rand01r(&s)*N;
-	if (d>2) kz[i]=rand01r(&s)*N;
+	if (dist==1) {
+	  int b = (int)(rand01r(&s)*NBLOBS) % NBLOBS;
+	  kx[i]=clusteredcoord(b,0,N,&s);
+	  if (d>1) ky[i]=clusteredcoord(b,1,N,&s);
+	  if (d>2) kz[i]=clusteredcoord(b,2,N,&s);
+	} else {
+	  kx[i]=rand01r(&s)*N;
+	  if (d>1) ky[i]=rand01r(&s)*N;
+	  if (d>2) kz[i]=rand01r(&s)*N;
+	}
       }
   }
 
+  if (dist==2)
+    sortcoords(d,kx,ky,kz);
   opts.spread_direction=2;
   printf("spreadinterp %dD, %.3g U pts, dir=%d, tol=%.3g: nspread=%d\n",d,(double)Ng,opts.spread_direction,tol,opts.nspread);
   timer.restart();